@@ -0,0 +1,44 @@
+#include "Arena.h"
+
+#include <algorithm>
+#include <cstdint>
+
+#include "Macros.h"
+
+namespace minirisk {
+namespace {
+// blocks grow geometrically up to this size
+const size_t max_block_size = 1 << 20;
+}
+
+Arena::Arena(size_t first_block_size)
+  : m_next(nullptr)
+  , m_end(nullptr)
+  , m_block_size(first_block_size)
+  , m_used(0)
+  , m_reserved(0) {
+  MYASSERT(first_block_size > 0, "The block size must be positive");
+}
+
+void *Arena::allocate(size_t size, size_t alignment) {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  uintptr_t p = reinterpret_cast<uintptr_t>(m_next);
+  size_t pad = (alignment - p % alignment) % alignment;
+  if (!m_next || size + pad > static_cast<size_t>(m_end - m_next)) {
+    // the rest of the current block is wasted
+    size_t n = std::max(m_block_size, size + alignment);
+    m_blocks.emplace_back(new char[n]);
+    m_next = m_blocks.back().get();
+    m_end = m_next + n;
+    m_reserved += n;
+    m_block_size = std::min(m_block_size * 2, max_block_size);
+    p = reinterpret_cast<uintptr_t>(m_next);
+    pad = (alignment - p % alignment) % alignment;
+  }
+  void *res = m_next + pad;
+  m_next += pad + size;
+  m_used += size;
+  return res;
+}
+
+} // namespace minirisk
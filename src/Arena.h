@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace minirisk {
+
+// Bump allocator: memory is carved out of blocks of growing size and only
+// released, all at once, when the arena is destroyed. Deallocation is a
+// no-op. Thread safe.
+struct Arena {
+ public:
+  explicit Arena(size_t first_block_size = 4096);
+
+  Arena(const Arena&) = delete;
+  Arena& operator=(const Arena&) = delete;
+
+  void *allocate(size_t size, size_t alignment);
+
+  // bytes handed out, and bytes reserved in blocks
+  size_t bytes_used() const { return m_used; }
+  size_t bytes_reserved() const { return m_reserved; }
+  size_t n_blocks() const { return m_blocks.size(); }
+
+ private:
+  std::mutex m_mutex;
+  std::vector<std::unique_ptr<char[]>> m_blocks;
+  char *m_next;
+  char *m_end;
+  size_t m_block_size;
+  size_t m_used;
+  size_t m_reserved;
+};
+
+// Standard allocator over an arena. It shares the ownership of the arena,
+// so that objects created with std::allocate_shared keep it alive.
+template <typename T>
+struct ArenaAllocator {
+  typedef T value_type;
+
+  explicit ArenaAllocator(std::shared_ptr<Arena> arena)
+    : m_arena(std::move(arena)) {}
+
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& other) : m_arena(other.m_arena) {}
+
+  T *allocate(size_t n) {
+    return static_cast<T *>(m_arena->allocate(n * sizeof(T), alignof(T)));
+  }
+
+  void deallocate(T *, size_t) {}
+
+  std::shared_ptr<Arena> m_arena;
+};
+
+template <typename T, typename U>
+bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return a.m_arena == b.m_arena;
+}
+
+template <typename T, typename U>
+bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) {
+  return !(a == b);
+}
+
+// creates an object in the arena, or on the heap if there is none
+template <typename T, typename... Args>
+std::shared_ptr<T> make_in_arena(
+    const std::shared_ptr<Arena>& arena, Args&&... args) {
+  if (!arena)
+    return std::make_shared<T>(std::forward<Args>(args)...);
+  return std::allocate_shared<T>(
+      ArenaAllocator<T>(arena), std::forward<Args>(args)...);
+}
+
+// Member holding an arena, for objects copied to build scenarios: a copy
+// starts with a new empty arena, so that the objects built by each scenario
+// are released together with it.
+struct ScenarioArena {
+  ScenarioArena() : m_arena(std::make_shared<Arena>()) {}
+  ScenarioArena(const ScenarioArena&) : ScenarioArena() {}
+  ScenarioArena& operator=(const ScenarioArena&) {
+    renew();
+    return *this;
+  }
+
+  // drops this arena, it is released with the last object allocated in it
+  void renew() { m_arena = std::make_shared<Arena>(); }
+
+  const std::shared_ptr<Arena>& get() const { return m_arena; }
+
+ private:
+  std::shared_ptr<Arena> m_arena;
+};
+
+} // namespace minirisk
@@ -0,0 +1,37 @@
+#include "AsyncMarketData.h"
+
+#include "Macros.h"
+
+namespace minirisk {
+
+AsyncMarketData::AsyncMarketData(std::shared_ptr<const MarketDataServer> mds,
+    std::chrono::microseconds latency, size_t max_in_flight)
+  : m_mds(std::move(mds))
+  , m_latency(latency)
+  , m_n_requests(0)
+  , m_in_flight(0)
+  , m_max_concurrent(0)
+  , m_pool(max_in_flight) {
+  MYASSERT(m_mds, "No market data server");
+  MYASSERT(max_in_flight > 0, "At least one query must be in flight");
+}
+
+std::future<std::pair<double, bool>> AsyncMarketData::lookup(
+    const std::string& name) {
+  auto mds = m_mds;
+  return request([mds, name] { return mds->lookup(name); });
+}
+
+std::future<std::vector<std::string>> AsyncMarketData::match(
+    const std::string& expr) {
+  auto mds = m_mds;
+  return request([mds, expr] { return mds->match(expr); });
+}
+
+std::future<std::vector<std::pair<std::string, double>>> AsyncMarketData::fetch(
+    const std::vector<std::string>& exprs) {
+  auto mds = m_mds;
+  return request([mds, exprs] { return mds->fetch(exprs); });
+}
+
+} // namespace minirisk
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MarketDataServer.h"
+#include "ThreadPool.h"
+
+namespace minirisk {
+
+// Asynchronous access to a market data server, as to a remote service: the
+// queries return futures, and each one completes after a simulated round
+// trip latency. Up to max_in_flight queries proceed concurrently, the
+// others wait for a free slot, so that issuing many queries at once costs
+// about one latency instead of one per query.
+struct AsyncMarketData {
+ public:
+  AsyncMarketData(std::shared_ptr<const MarketDataServer> mds,
+      std::chrono::microseconds latency, size_t max_in_flight = 32);
+
+  // same as the MarketDataServer queries
+  std::future<std::pair<double, bool>> lookup(const std::string& name);
+  std::future<std::vector<std::string>> match(const std::string& expr);
+  std::future<std::vector<std::pair<std::string, double>>> fetch(
+      const std::vector<std::string>& exprs);
+
+  const std::shared_ptr<const MarketDataServer>& server() const {
+    return m_mds;
+  }
+
+  // number of queries issued so far
+  size_t n_requests() const { return m_n_requests; }
+
+  // most queries in flight at the same time so far
+  size_t max_concurrent() const { return m_max_concurrent; }
+
+ private:
+  template <typename F>
+  std::future<typename std::result_of<F()>::type> request(F f) {
+    ++m_n_requests;
+    return m_pool.async([this, f] {
+        in_flight guard(*this);
+        std::this_thread::sleep_for(m_latency);
+        return f(); });
+  }
+
+  // counts a query in flight for its lifetime
+  struct in_flight {
+    explicit in_flight(AsyncMarketData& a) : m_a(a) {
+      size_t n = ++m_a.m_in_flight;
+      size_t peak = m_a.m_max_concurrent;
+      while (n > peak && !m_a.m_max_concurrent.compare_exchange_weak(peak, n))
+        ;
+    }
+    ~in_flight() { --m_a.m_in_flight; }
+    AsyncMarketData& m_a;
+  };
+
+  std::shared_ptr<const MarketDataServer> m_mds;
+  std::chrono::microseconds m_latency;
+  std::atomic<size_t> m_n_requests;
+  std::atomic<size_t> m_in_flight;
+  std::atomic<size_t> m_max_concurrent;
+  ThreadPool m_pool;  // one thread per query in flight, destroyed first
+};
+
+} // namespace minirisk
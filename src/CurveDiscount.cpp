@@ -1,7 +1,11 @@
 #include "CurveDiscount.h"
+#include "IPricer.h"
 #include "Market.h"
 #include "Streamer.h"
+#include "Instrumentation.h"
+#include "MemoryReport.h"
 
+#include <algorithm>
 #include <cmath>
 
 namespace minirisk {
@@ -16,15 +20,28 @@ struct RatePairDoubleComparator {
 
 CurveDiscount::CurveDiscount(
     Market *mkt, const Date& today, const string& curve_name)
-    : m_today(today), m_name(curve_name) {
+    : m_today(today), m_name(curve_name), m_rate(nan<double>()) {
+  INSTR_COUNT(instr::curve_build_discount);
+  INSTR_SCOPE("CurveDiscount");
   init_log_discounting_factors(mkt); 
 }
 
 void CurveDiscount::init_log_discounting_factors(Market *mkt) {
   std::string ccy = m_name.substr(m_name.length() - 3);
-  std::string regex = ir_rate_prefix + "[0-9]+(D|W|M|Y)\\." + ccy;
+  std::string regex = ir_tenors_regex(ccy);
+  snapshot_curve_t prebuilt;
+  if (mkt->find_snapshot_curve(m_name, regex, prebuilt)) {
+    INSTR_COUNT(instr::curve_snapshot_view);
+    m_snapshot = mkt->snapshot();
+    m_log_dfs = prebuilt.log_dfs;
+    m_n_log_dfs = prebuilt.n_log_dfs;
+    m_rate = prebuilt.rate;
+    m_last_tenor_date = m_today + prebuilt.last_tenor;
+    return;
+  }
+
   const auto& matched = mkt->fetch_risk_factors(regex);
-  m_log_dfs.push_back(std::make_pair(0.0, 0.0));
+  m_own_log_dfs.push_back(std::make_pair(0.0, 0.0));
   std::vector<std::pair<int32_t, double>> tenor_rates;
   for (const auto& rate : matched) {
     std::string tenor = rate.first.substr(
@@ -37,8 +54,10 @@ void CurveDiscount::init_log_discounting_factors(Market *mkt) {
   for (const auto& rate : tenor_rates) {
     double tf = rate.first / 365.0;
     double df = -rate.second * tf;
-    m_log_dfs.push_back(std::make_pair(tf, df));
+    m_own_log_dfs.push_back(std::make_pair(tf, df));
   }
+  m_log_dfs = m_own_log_dfs.data();
+  m_n_log_dfs = m_own_log_dfs.size();
 
   // Init from yield.
   if (tenor_rates.empty()) {
@@ -70,35 +89,87 @@ int32_t CurveDiscount::convert_tenor_to_int(std::string& tenor) const {
   return numeric * base;
 }
 
-double CurveDiscount::df(const Date& t) const {
-  MYASSERT((!(t < m_today)), 
-      "Curve " << m_name << ", DF not available before anchor date " << m_today 
-      << ", requested " << t);
+Status CurveDiscount::try_df(const Date& t, double& df) const {
+  const string& name = m_name;
+  const Date& today = m_today;
+  if (t < m_today)
+    RETURN_ERROR(status_code_t::expired,
+        "Curve " << name << ", DF not available before anchor date " << today
+        << ", requested " << t);
   double dt = time_frac(m_today, t);
 
   // Use yield.
-  if (m_log_dfs.size() == 1) {
-    return std::exp(-m_rate * dt);
+  if (m_n_log_dfs == 1) {
+    df = std::exp(-m_rate * dt);
+    return Status();
   }
 
   // Use discounting factors with interpolation.
-  auto it = std::upper_bound(
-      m_log_dfs.begin(), m_log_dfs.end(), dt, RatePairDoubleComparator());
-  if (it == m_log_dfs.end()) {
-    if (dt == m_log_dfs.back().first) {
-      return std::exp(m_log_dfs.back().second);
+  const auto *end = m_log_dfs + m_n_log_dfs;
+  auto it = std::upper_bound(m_log_dfs, end, dt, RatePairDoubleComparator());
+  if (it == end) {
+    if (dt == end[-1].first) {
+      df = std::exp(end[-1].second);
+      return Status();
     }
-    MYASSERT(false, 
-        "Curve " << m_name << ", DF not available beyond last tenor date " 
-        << m_last_tenor_date << ", requested " << t);
+    const Date& last_tenor_date = m_last_tenor_date;
+    RETURN_ERROR(status_code_t::beyond_last_tenor,
+        "Curve " << name << ", DF not available beyond last tenor date " 
+        << last_tenor_date << ", requested " << t);
   } else {
     const auto& t2_log_df = *it;
     const auto& t1_log_df = *(--it);
-    return std::exp(
+    df = std::exp(
         ((t2_log_df.first - dt) * t1_log_df.second 
          + (dt - t1_log_df.first) * t2_log_df.second) 
         / (t2_log_df.first - t1_log_df.first));
+    return Status();
+  }
+}
+
+void try_df_batch(const ptr_disc_curve_t* curves, size_t n, const Date& t,
+    Status* status, double* df) {
+  MYASSERT(n <= max_price_lanes, "Too many lanes: " << n);
+  auto each = [&] {
+    for (size_t k = 0; k < n; ++k)
+      status[k] = curves[k]->try_df(t, df[k]);
+  };
+  const CurveDiscount *c[max_price_lanes];
+  for (size_t k = 0; k < n; ++k) {
+    c[k] = dynamic_cast<const CurveDiscount *>(curves[k].get());
+    if (!c[k] || c[k]->n_log_dfs() != c[0]->n_log_dfs()
+        || !(c[k]->today() == c[0]->today()))
+      return each();
+  }
+  // the yield, expired and extrapolated cases are left to try_df
+  if (n == 0 || c[0]->n_log_dfs() == 1 || t < c[0]->today())
+    return each();
+  const double dt = time_frac(c[0]->today(), t);
+  const auto *nodes = c[0]->log_dfs();
+  const auto *end = nodes + c[0]->n_log_dfs();
+  const size_t i =
+    std::upper_bound(nodes, end, dt, RatePairDoubleComparator()) - nodes;
+  if (nodes + i == end)
+    return each();
+  const double t1 = nodes[i - 1].first, t2 = nodes[i].first;
+  double l1[max_price_lanes], l2[max_price_lanes];
+  for (size_t k = 0; k < n; ++k) {
+    const auto *nk = c[k]->log_dfs();
+    if (nk[i - 1].first != t1 || nk[i].first != t2)
+      return each();
+    l1[k] = nk[i - 1].second;
+    l2[k] = nk[i].second;
   }
+  // as in try_df
+  const double w1 = t2 - dt, w2 = dt - t1, h = t2 - t1;
+  for (size_t k = 0; k < n; ++k)
+    df[k] = std::exp((w1 * l1[k] + w2 * l2[k]) / h);
+  for (size_t k = 0; k < n; ++k)
+    status[k] = Status();
+}
+
+size_t CurveDiscount::memory_size() const {
+  return sizeof(*this) + heap_size(m_name) + heap_size(m_own_log_dfs);
 }
 
 } // namespace minirisk
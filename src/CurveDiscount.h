@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <vector>
 
 #include "ICurve.h"
@@ -7,6 +8,7 @@
 namespace minirisk {
 
 struct Market;
+struct MarketSnapshot;
 
 struct CurveDiscount : ICurveDiscount
 {
@@ -17,18 +19,43 @@ struct CurveDiscount : ICurveDiscount
     void init_log_discounting_factors(Market *mkt);
 
     // compute the discount factor
-    double df(const Date& t) const;
+    Status try_df(const Date& t, double& df) const;
 
     virtual Date today() const { return m_today; }
 
+    // the nodes viewed in the market snapshot are not counted
+    virtual size_t memory_size() const;
+
+    // nodes (time, log df) and yield, used if there is only the first node
+    const std::pair<double, double> *log_dfs() const { return m_log_dfs; }
+    size_t n_log_dfs() const { return m_n_log_dfs; }
+    double rate() const { return m_rate; }
+
+    // days from today to the last tenor, 0 without tenors
+    long last_tenor() const
+    {
+        return m_n_log_dfs > 1 ? m_last_tenor_date - m_today : 0;
+    }
+
 private:
     int32_t convert_tenor_to_int(std::string& tenor) const;
 
     Date m_today;
     Date m_last_tenor_date;
     string m_name;
-    std::vector<std::pair<double, double>> m_log_dfs;
+    // the nodes are in m_own_log_dfs, or in the market snapshot
+    const std::pair<double, double> *m_log_dfs;
+    size_t m_n_log_dfs;
+    std::vector<std::pair<double, double>> m_own_log_dfs;
+    std::shared_ptr<const MarketSnapshot> m_snapshot;
     double m_rate;
 };
 
+// Discount factors at t on n <= max_price_lanes curves of a currency, e.g.
+// in the markets of a scenario batch: status[k] and df[k] are those of
+// curves[k]->try_df(t). When the curves have the same node times, the
+// nodes around t are located once and the lanes interpolated in one loop.
+void try_df_batch(const ptr_disc_curve_t* curves, size_t n, const Date& t,
+    Status* status, double* df);
+
 } // namespace minirisk
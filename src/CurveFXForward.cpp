@@ -1,20 +1,34 @@
 #include "CurveFXForward.h"
 #include "Global.h"
 #include "Market.h"
+#include "Instrumentation.h"
+#include "MemoryReport.h"
 
 namespace minirisk {
 
 CurveFXForward::CurveFXForward(
     Market *mkt, const Date& today, const std::string& name) 
     : m_today(today), m_name(name) {
+  INSTR_COUNT(instr::curve_build_fx_fwd);
+  INSTR_SCOPE("CurveFXForward");
   const auto& ccys = mkt->fx_fwd_name_to_ccy_pair(name);
   m_df1 = mkt->get_discount_curve(ir_curve_discount_name(ccys.first));
   m_df2 = mkt->get_discount_curve(ir_curve_discount_name(ccys.second));
   m_spot = mkt->get_fx_spot_curve(fx_spot_name(ccys.first, ccys.second));
 }
 
-double CurveFXForward::fwd(const Date& t) const {
-  return m_spot->spot() * m_df1->df(t) / m_df2->df(t);
+Status CurveFXForward::try_fwd(const Date& t, double& fwd) const {
+  double df1, df2;
+  Status status = m_df1->try_df(t, df1);
+  if (status.ok())
+    status = m_df2->try_df(t, df2);
+  if (status.ok())
+    fwd = m_spot->spot() * df1 / df2;
+  return status;
+}
+
+size_t CurveFXForward::memory_size() const {
+  return sizeof(*this) + heap_size(m_name);
 }
 
 } // namespace minirisk
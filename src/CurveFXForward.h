@@ -17,7 +17,10 @@ struct CurveFXForward : ICurveFXForward {
   CurveFXForward(
       Market *mkt, const Date& today, const std::string& name);
 
-  virtual double fwd(const Date& t) const;
+  virtual Status try_fwd(const Date& t, double& fwd) const;
+
+  // the curves it is built from are not counted
+  virtual size_t memory_size() const;
 
  private:
   Date m_today;
@@ -1,10 +1,18 @@
 #include "CurveFXSpot.h"
 #include "Market.h"
+#include "Instrumentation.h"
+#include "MemoryReport.h"
 
 namespace minirisk {
 
 CurveFXSpot::CurveFXSpot(
     Market *mkt, const Date& today, const std::string& name) 
-    : m_today(today), m_name(name), m_rate(mkt->get_fx_spot(name)) {}
+    : m_today(today), m_name(name), m_rate(mkt->get_fx_spot(name)) {
+  INSTR_COUNT(instr::curve_build_fx_spot);
+}
+
+size_t CurveFXSpot::memory_size() const {
+  return sizeof(*this) + heap_size(m_name);
+}
 
 } // namespace minirisk
@@ -19,6 +19,8 @@ struct CurveFXSpot : ICurveFXSpot {
 
   virtual double spot() const { return m_rate; }
 
+  virtual size_t memory_size() const;
+
  private:
   Date m_today;
   std::string m_name;
@@ -0,0 +1,68 @@
+#include <iostream>
+
+#include "PortfolioGenerator.h"
+
+using namespace::minirisk;
+
+void usage() {
+  std::cerr
+      << "Invalid command line arguments\n"
+      << "Example:\n"
+      << "DemoGeneratePortfolio -p portfolio.txt -f risk_factors.txt "
+      << "-x fixings.txt [-n trades] [-s seed] [-c currencies] [-t tenors] "
+      << "[-w fx_forward_fraction] [-e expired_fraction] "
+      << "[-m missing_data_fraction]\n";
+  std::exit(-1);
+}
+
+int main(int argc, const char **argv) {
+  // parse command line arguments
+  std::string portfolio, riskfactors, fixings;
+  generator_config_t cfg;
+  if (argc % 2 == 0)
+    usage();
+  try {
+    for (int i = 1; i < argc; i += 2) {
+      std::string key(argv[i]);
+      std::string value(argv[i+1]);
+      if (key == "-p")
+        portfolio = value;
+      else if (key == "-f")
+        riskfactors = value;
+      else if (key == "-x")
+        fixings = value;
+      else if (key == "-n")
+        cfg.n_trades = std::stoull(value);
+      else if (key == "-s")
+        cfg.seed = std::stoull(value);
+      else if (key == "-c")
+        cfg.n_ccys = std::stoul(value);
+      else if (key == "-t")
+        cfg.n_tenors = std::stoul(value);
+      else if (key == "-w")
+        cfg.fx_forward_fraction = std::stod(value);
+      else if (key == "-e")
+        cfg.expired_fraction = std::stod(value);
+      else if (key == "-m")
+        cfg.missing_data_fraction = std::stod(value);
+      else
+        usage();
+    }
+  }
+  catch (const std::logic_error&) {
+    usage();
+  }
+  if (portfolio == "" || riskfactors == "" || fixings == "")
+    usage();
+
+  try {
+    PortfolioGenerator gen(cfg);
+    gen.write_risk_factors(riskfactors);
+    gen.write_portfolio(portfolio, fixings);
+    return 0;  // report success to the caller
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1; // report an error to the caller
+  }
+}
@@ -0,0 +1,93 @@
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+#include "PnlExplain.h"
+#include "PortfolioUtils.h"
+#include "ResultWriter.h"
+#include "ThreadPool.h"
+
+using namespace::minirisk;
+
+void usage() {
+  std::cerr
+      << "Invalid command line arguments\n"
+      << "Example:\n"
+      << "DemoPnlExplain -p portfolio.txt -y risk_factors_yesterday.txt -f risk_factors.txt\n"
+      << "Optional: -x fixings.txt -b base_ccy -j threads\n"
+      << "          -d 20170805 (today) -e 20170804 (yesterday, default today - 1)\n"
+      << "          -o text|csv|binary (results format) -r results_file\n";
+  std::exit(-1);
+}
+
+int main(int argc, const char **argv) {
+  // parse command line arguments
+  string portfolio, riskfactors0, riskfactors1, fixingpath, base_ccy;
+  string result_file, result_format_name;
+  Date today(2017,8,5), yesterday;
+  size_t n_threads = std::thread::hardware_concurrency();
+  if (argc % 2 == 0)
+    usage();
+  try {
+    for (int i = 1; i < argc; i += 2) {
+      string key(argv[i]);
+      string value(argv[i+1]);
+      if (key == "-p")
+        portfolio = value;
+      else if (key == "-y")
+        riskfactors0 = value;
+      else if (key == "-f")
+        riskfactors1 = value;
+      else if (key == "-x")
+        fixingpath = value;
+      else if (key == "-b")
+        base_ccy = value;
+      else if (key == "-j")
+        n_threads = std::stoul(value);
+      else if (key == "-d" && value.size() == 8)
+        today = Date(value);
+      else if (key == "-e" && value.size() == 8)
+        yesterday = Date(value);
+      else if (key == "-o")
+        result_format_name = value;
+      else if (key == "-r")
+        result_file = value;
+      else
+        usage();
+    }
+  }
+  catch (const std::logic_error&) {
+    usage();
+  }
+  if (portfolio == "" || riskfactors0 == "" || riskfactors1 == "")
+    usage();
+  if (base_ccy == "")
+    base_ccy = "USD";
+  if (yesterday == Date())
+    yesterday = today - 1;
+
+  try {
+    result_format_t result_format = result_format_name.empty()
+      ? result_format_t::text : parse_result_format(result_format_name);
+    std::shared_ptr<const MarketDataServer> mds0(
+        new MarketDataServer(riskfactors0));
+    std::shared_ptr<const MarketDataServer> mds1(
+        new MarketDataServer(riskfactors1));
+    std::shared_ptr<const FixingDataServer> fds;
+    if (!fixingpath.empty())
+      fds.reset(new FixingDataServer(fixingpath));
+    auto pricers = get_pricers(load_portfolio(portfolio), base_ccy);
+    ThreadPool pool(std::max<size_t>(n_threads, 1));
+    RiskCube cube = explain_pnl(
+        pricers, mds0, yesterday, mds1, today, fds, pool);
+    ResultWriter out(result_file, result_format);
+    for (size_t s = 0; s < cube.n_scenarios(); ++s)
+      out.write(cube, s);
+    out.close();
+    return 0;  // report success to the caller
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1; // report an error to the caller
+  }
+}
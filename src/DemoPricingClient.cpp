@@ -0,0 +1,77 @@
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+
+#include "PricingProtocol.h"
+#include "ResultWriter.h"
+
+using namespace::minirisk;
+
+void usage() {
+  std::cerr
+      << "Invalid command line arguments\n"
+      << "Example:\n"
+      << "DemoPricingClient -s /tmp/minirisk.sock -m pv\n"
+      << "Measures: pv, pv01_bucketed, pv01_parallel, fx_delta, what_if, "
+      << "shutdown, reload\n"
+      << "Optional: -t 0,3,7 (trade indices, default all)\n"
+      << "          -w IR.1Y.EUR=0.05,FX.SPOT.GBP=1.6 (what-if overrides)\n"
+      << "          -o text|csv|binary (results format) -r results_file\n";
+  std::exit(-1);
+}
+
+int main(int argc, const char **argv) {
+  // parse command line arguments
+  string socket_path, measure, trades, overrides, result_file, result_format;
+  if (argc % 2 == 0)
+    usage();
+  for (int i = 1; i < argc; i += 2) {
+    string key(argv[i]);
+    string value(argv[i+1]);
+    if (key == "-s")
+      socket_path = value;
+    else if (key == "-m")
+      measure = value;
+    else if (key == "-t")
+      trades = value;
+    else if (key == "-w")
+      overrides = value;
+    else if (key == "-o")
+      result_format = value;
+    else if (key == "-r")
+      result_file = value;
+    else
+      usage();
+  }
+  if (socket_path == "" || measure == "")
+    usage();
+
+  try {
+    pricing_request_t req;
+    req.type = parse_request_type(measure);
+    std::istringstream ts(trades);
+    for (string t; std::getline(ts, t, ','); )
+      req.trades.push_back(std::stoul(t));
+    std::istringstream os(overrides);
+    for (string o; std::getline(os, o, ','); ) {
+      auto eq = o.find('=');
+      MYASSERT(eq != string::npos, "Invalid override " << o);
+      req.overrides.push_back(
+          std::make_pair(o.substr(0, eq), std::stod(o.substr(eq + 1))));
+    }
+
+    ResultWriter out(result_file, result_format.empty()
+        ? result_format_t::text : parse_result_format(result_format));
+    int fd = connect_to_server(socket_path);
+    auto results = send_request(fd, req);
+    ::close(fd);
+    for (const auto& r : results)
+      out.write(r.first, r.second);
+    out.close();
+    return 0;  // report success to the caller
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1; // report an error to the caller
+  }
+}
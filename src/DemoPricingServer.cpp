@@ -0,0 +1,57 @@
+#include <iostream>
+
+#include "PricingServer.h"
+
+using namespace::minirisk;
+
+void usage() {
+  std::cerr
+      << "Invalid command line arguments\n"
+      << "Example:\n"
+      << "DemoPricingServer -p portfolio.txt -f risk_factors.txt "
+      << "-s /tmp/minirisk.sock\n"
+      << "Optional: -x fixings.txt -b base_ccy\n";
+  std::exit(-1);
+}
+
+int main(int argc, const char **argv) {
+  // parse command line arguments
+  string portfolio, riskfactors, fixingpath, baseccy, socket_path;
+  if (argc % 2 == 0)
+    usage();
+  for (int i = 1; i < argc; i += 2) {
+    string key(argv[i]);
+    string value(argv[i+1]);
+    if (key == "-p")
+      portfolio = value;
+    else if (key == "-f")
+      riskfactors = value;
+    else if (key == "-x")
+      fixingpath = value;
+    else if (key == "-b")
+      baseccy = value;
+    else if (key == "-s")
+      socket_path = value;
+    else
+      usage();
+  }
+  if (portfolio == "" || riskfactors == "" || socket_path == "")
+    usage();
+  if (baseccy == "")
+    baseccy = "USD";
+
+  try {
+    // the files are read again on each reload request
+    std::shared_ptr<MarketDataSource> source(
+        new MarketDataSource(riskfactors, fixingpath));
+    PricingServer server(load_portfolio(portfolio), baseccy, source,
+        Date(2017,8,5));
+    std::cerr << "Listening on " << socket_path << "\n";
+    server.serve(socket_path);
+    return 0;  // report success to the caller
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1; // report an error to the caller
+  }
+}
@@ -0,0 +1,56 @@
+#include <iostream>
+
+#include "FixingDataServer.h"
+#include "MarketDataServer.h"
+#include "MarketSnapshot.h"
+
+using namespace::minirisk;
+
+void usage() {
+  std::cerr
+      << "Invalid command line arguments\n"
+      << "Example:\n"
+      << "DemoPublishSnapshot -f risk_factors.txt -s /dev/shm/market.snapshot\n"
+      << "Optional: -x fixings.txt\n"
+      << "Then: DemoRisk -p portfolio.txt -s /dev/shm/market.snapshot\n";
+  std::exit(-1);
+}
+
+int main(int argc, const char **argv) {
+  // parse command line arguments
+  string riskfactors, fixingpath, snapshot;
+  if (argc % 2 == 0)
+    usage();
+  for (int i = 1; i < argc; i += 2) {
+    string key(argv[i]);
+    string value(argv[i+1]);
+    if (key == "-f")
+      riskfactors = value;
+    else if (key == "-x")
+      fixingpath = value;
+    else if (key == "-s")
+      snapshot = value;
+    else
+      usage();
+  }
+  if (riskfactors == "" || snapshot == "")
+    usage();
+
+  try {
+    std::shared_ptr<const MarketDataServer> mds(
+        new MarketDataServer(riskfactors));
+    std::unique_ptr<const FixingDataServer> fds;
+    if (!fixingpath.empty())
+      fds.reset(new FixingDataServer(fixingpath));
+    publish_market_snapshot(snapshot, mds, fds.get());
+    MarketSnapshot snap(snapshot);
+    std::cout << "Published " << snap.n_risk_factors() << " risk factors and "
+      << snap.n_fx_ccys() << " fx currencies in " << snapshot << " ("
+      << snap.size() << " bytes)\n";
+    return 0;  // report success to the caller
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1; // report an error to the caller
+  }
+}
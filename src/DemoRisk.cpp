@@ -1,50 +1,93 @@
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <algorithm>
 
 #include "MarketDataServer.h"
 #include "FixingDataServer.h"
 #include "PortfolioUtils.h"
+#include "GreekEngine.h"
+#include "Instrumentation.h"
+#include "MemoryReport.h"
+#include "MultiDate.h"
+#include "ParametricVaR.h"
+#include "ResultWriter.h"
+#include "RiskCube.h"
+#include "Startup.h"
+#include "ThreadPool.h"
 
 using namespace::minirisk;
 
-void run(const string& portfolio_file, const string& risk_factors_file,
-    const string& fixing_path, const string& base_ccy) {
-  // load the portfolio from file
-  portfolio_t portfolio = load_portfolio(portfolio_file);
+// the command line options, see usage()
+struct risk_options_t {
+  string portfolio_file;
+  string risk_factors_file;  // or
+  string snapshot_file;
+  string fixing_path;        // optional
+  string base_ccy = "USD";
+  bool print_text = true;    // portfolio, risk factors and aggregates
+  string group_by;
+  size_t n_threads = 0;
+  double latency_ms = 0;
+  size_t curve_budget = 0;
+  string memory_file;
+  std::vector<Date> dates;
+  string var_history;
+  string greeks_file;
+  std::vector<measure_t> measures;  // all if empty
+};
+
+void run(const risk_options_t& opts, ResultWriter& out) {
+  // load the portfolio, the market data (from files or attaching to a market
+  // snapshot published by DemoPublishSnapshot) and the fixings concurrently,
+  // then fetch all the data needed by the pricers in one request and build
+  // the curves concurrently
+  startup_inputs_t inputs;
+  inputs.portfolio_file = opts.portfolio_file;
+  inputs.risk_factors_file = opts.risk_factors_file;
+  inputs.snapshot_file = opts.snapshot_file;
+  inputs.fixing_path = opts.fixing_path;
+  inputs.base_ccy = opts.base_ccy;
+  inputs.today = Date(2017,8,5);
   // save and reload portfolio to implicitly test round trip serialization
-  save_portfolio("portfolio.tmp", portfolio);
-  portfolio.clear();
-  portfolio = load_portfolio("portfolio.tmp");
+  inputs.round_trip_file = "portfolio.tmp";
+  inputs.mds_latency = std::chrono::microseconds(
+      static_cast<long>(opts.latency_ms * 1000));
+  ThreadPool pool(opts.n_threads);
+  startup_t startup = start_up(inputs, pool);
+  const portfolio_t& portfolio = startup.portfolio;
+  const std::vector<ppricer_t>& pricers = startup.pricers;
+  std::shared_ptr<const FixingDataServer> fds = startup.fds;
+  Market& mkt = *startup.mkt;
+  mkt.set_curve_budget(opts.curve_budget);
+  const Date& today = inputs.today;
 
   // display portfolio
-  print_portfolio(portfolio);
-
-  // get pricers
-  std::vector<ppricer_t> pricers(get_pricers(portfolio, base_ccy));
+  if (opts.print_text)
+    print_portfolio(portfolio);
 
-  // initialize market data server
-  std::shared_ptr<const MarketDataServer> mds(
-      new MarketDataServer(risk_factors_file));
-  std::shared_ptr<const FixingDataServer> fds;
-  if (!fixing_path.empty())
-    fds.reset(new FixingDataServer(fixing_path));
-
-  // Init market object
-  Date today(2017,8,5);
-  Market mkt(mds, today);
+  // report all the missing data at once
+  for (const auto& m : startup.missing)
+    std::cerr << "Missing market data: " << m << "\n";
 
   // Price all products. Market objects are automatically constructed on demand,
   // fetching data as needed from the market data server.
-  {
-      auto prices = compute_prices(pricers, mkt, fds);
-      print_price_vector("PV", prices);
-  }
+  // Prices are kept, so that the greeks can skip trades which failed to price,
+  // with the risk factors each trade depends on, so that the greeks only
+  // reprice the trades depending on the bumped ones.
+  RiskCube cube(pricers.size());
+  trade_dependencies_t deps;
+  auto prices = compute_prices(pricers, mkt, fds, nullptr, &deps);
+  cube.add_scenario(
+      scenario_info_t{"PV", measure_t::pv, {}, bump_type_t::none, 0.0}, prices);
+  out.write(cube, 0);
+  out.flush();
 
   // disconnect the market (no more fetching from the market data server allowed)
   mkt.disconnect();
 
   // display all relevant risk factors
-  {
+  if (opts.print_text) {
       std::cout << "Risk factors:\n";
       auto tmp = mkt.get_risk_factors(".+");
       for (const auto& iter : tmp)
@@ -52,30 +95,75 @@ void run(const string& portfolio_file, const string& risk_factors_file,
       std::cout << "\n";
   }
 
-  {   // Compute PV01 (i.e. sensitivity with respect to interest rate dV/dr)
-      std::vector<std::pair<string, portfolio_values_t>> pv01(
-          compute_pv01_bucketed(pricers, mkt, fds));  // PV01 per trade
+  // Compute PV01 (i.e. sensitivity with respect to interest rate dV/dr),
+  // bucketed and per currency, and fx delta, or the configured greeks,
+  // or only the selected ones, reusing the prices as base revaluation.
+  // The bumped markets are shared by all the greeks and revalued
+  // concurrently.
+  greek_config_t greeks = opts.greeks_file.empty()
+    ? default_greek_config() : load_greek_config(opts.greeks_file);
+  if (!opts.measures.empty())
+    greeks = select_measures(greeks, opts.measures);
+  compute_greeks(pricers, mkt, fds, greeks, cube, &prices, &pool, &deps);
+  for (size_t s = 1; s < cube.n_scenarios(); ++s)
+    out.write(cube, s);
 
-      // display PV01 per currency
-      for (const auto& g : pv01)
-          print_price_vector("PV01 " + g.first, g.second);
+  // parametric VaR from these sensitivities
+  if (!opts.var_history.empty()) {
+    FixingDataServer history(opts.var_history);
+    auto cov = estimate_covariance(history, sensitivity_risk_factors(cube));
+    auto var = compute_parametric_var(cube, cov);
+    RiskCube component(pricers.size());
+    component.add_scenario(scenario_info_t{"Component VaR", measure_t::var,
+        {}, bump_type_t::none, 0.0}, var.component);
+    out.write(component, 0);
+    if (opts.print_text) {
+      out.flush();
+      std::cout << "Parametric VaR (99%, 1 day, " << cov.n_changes
+        << " changes): " << var.var << "\n";
+      for (size_t c = 0; c < var.ccys.size(); ++c)
+        std::cout << "  " << var.ccys[c] << ": component "
+          << var.ccy_component[c] << ", standalone "
+          << var.ccy_standalone[c] << "\n";
+      std::cout << "\n";
+    }
   }
 
-  {   // Compute PV01 (i.e. sensitivity with respect to interest rate dV/dr)
-      std::vector<std::pair<string, portfolio_values_t>> pv01(
-          compute_pv01_parallel(pricers, mkt , fds));  // PV01 per trade
+  // PV and theta on other valuation dates
+  if (!opts.dates.empty()) {
+    RiskCube series =
+      compute_pv_dates(pricers, startup.mds, fds, opts.dates, pool);
+    for (size_t s = 0; s < series.n_scenarios(); ++s)
+      out.write(series, s);
+  }
 
-      // display PV01 per currency
-      for (const auto& g : pv01)
-          print_price_vector("PV01 " + g.first, g.second);
+  if (!opts.memory_file.empty()) {
+    memory_report_t report;
+    memory_report(portfolio, pricers, report);
+    mkt.memory_report(report);
+    std::ofstream os(opts.memory_file);
+    report.print(os);
   }
 
-  {
-    // Compute fx delta
-    std::vector<std::pair<string, portfolio_values_t>> fx_delta(
-        compute_fx_delta(pricers, mkt, fds));
-    for (const auto& g : fx_delta)
-      print_price_vector("FX delta " + g.first, g.second);
+  // display aggregated results
+  if (opts.print_text && !opts.group_by.empty()) {
+    trade_grouping_t grouping;
+    if (opts.group_by == "ccy")
+      grouping = group_by_ccy(portfolio);
+    else if (opts.group_by == "tenor")
+      grouping = group_by_tenor(portfolio, today);
+    else if (opts.group_by == "type")
+      grouping = group_by_type(portfolio);
+    else
+      THROW("Unknown grouping: " << opts.group_by);
+    out.flush();
+    for (size_t s = 0; s < cube.n_scenarios(); ++s) {
+      auto totals = cube.aggregate(s, grouping);
+      std::cout << cube.scenario(s).name << " by " << opts.group_by << ":\n";
+      for (size_t g = 0; g < totals.size(); ++g)
+        std::cout << "  " << grouping.labels[g] << ": " << totals[g] << "\n";
+    }
+    std::cout << "\n";
   }
 }
 
@@ -83,36 +171,102 @@ void usage() {
   std::cerr
       << "Invalid command line arguments\n"
       << "Example:\n"
-      << "DemoRisk -p portfolio.txt -f risk_factors.txt\n";
+      << "DemoRisk -p portfolio.txt -f risk_factors.txt\n"
+      << "     or: DemoRisk -p portfolio.txt -s market_snapshot\n"
+      << "Optional: -x fixings.txt -b base_ccy -i summary.json -t trace.json\n"
+      << "          -o text|csv|binary (results format) -r results_file\n"
+      << "          -g ccy|tenor|type (aggregate results)\n"
+      << "          -j threads (to load the inputs and build the curves, default\n"
+      << "             one per hardware thread)\n"
+      << "          -l latency_ms (simulate a remote market data server)\n"
+      << "          -c bytes (budget of the curve cache) -m memory_report.txt\n"
+      << "          -d 20170805,20170806 (PV and theta on these dates)\n"
+      << "          -v risk_factor_history.txt (parametric VaR)\n"
+      << "          -k greeks.txt (bumps and gammas, see parse_greek_config)\n"
+      << "          -q pv01_bucketed,pv01_parallel,fx_delta,gamma,cross_gamma\n"
+      << "             (only these greeks, the PV is always computed)\n";
   std::exit(-1);
 }
 
 int main(int argc, const char **argv) {
   // parse command line arguments
-  string portfolio, riskfactors, fixingpath, baseccy;
+  risk_options_t opts;
+  string instr_summary, instr_trace, result_file, result_format_name;
+  string measures_list;
   if (argc % 2 == 0)
     usage();
   for (int i = 1; i < argc; i += 2) {
     string key(argv[i]);
     string value(argv[i+1]);
     if (key == "-p")
-      portfolio = value;
+      opts.portfolio_file = value;
     else if (key == "-f")
-      riskfactors = value;
+      opts.risk_factors_file = value;
     else if (key == "-x")
-      fixingpath = value;
+      opts.fixing_path = value;
+    else if (key == "-s")
+      opts.snapshot_file = value;
     else if (key == "-b")
-      baseccy = value;
+      opts.base_ccy = value;
+    else if (key == "-i")
+      instr_summary = value;
+    else if (key == "-t")
+      instr_trace = value;
+    else if (key == "-o")
+      result_format_name = value;
+    else if (key == "-r")
+      result_file = value;
+    else if (key == "-g")
+      opts.group_by = value;
+    else if (key == "-j")
+      opts.n_threads = std::stoul(value);
+    else if (key == "-l")
+      opts.latency_ms = std::stod(value);
+    else if (key == "-c")
+      opts.curve_budget = std::stoul(value);
+    else if (key == "-m")
+      opts.memory_file = value;
+    else if (key == "-d") {
+      std::istringstream ds(value);
+      for (string d; std::getline(ds, d, ','); ) {
+        if (d.size() != 8)
+          usage();
+        opts.dates.push_back(Date(d));
+      }
+    }
+    else if (key == "-v")
+      opts.var_history = value;
+    else if (key == "-k")
+      opts.greeks_file = value;
+    else if (key == "-q")
+      measures_list = value;
     else
       usage();
   }
-  if (portfolio == "" || riskfactors == "")
+  if (opts.portfolio_file == ""
+      || (opts.risk_factors_file == "") == (opts.snapshot_file == ""))
     usage();
-  if (baseccy == "")
-    baseccy = "USD";
+  if (opts.base_ccy == "")
+    opts.base_ccy = "USD";
 
   try {
-    run(portfolio, riskfactors, fixingpath, baseccy);
+    // portfolio and risk factors are only displayed if they cannot get mixed
+    // with results in csv or binary format
+    result_format_t result_format = result_format_name.empty()
+      ? result_format_t::text : parse_result_format(result_format_name);
+    std::istringstream ms(measures_list);
+    for (string m; std::getline(ms, m, ','); )
+      opts.measures.push_back(parse_measure(m));
+    ResultWriter out(result_file, result_format);
+    opts.print_text =
+      !result_file.empty() || result_format == result_format_t::text;
+    run(opts, out);
+    out.close();
+    // dump the instrumentation (empty unless compiled with INSTRUMENT)
+    if (!instr_summary.empty())
+      instr::write_summary(instr_summary);
+    if (!instr_trace.empty())
+      instr::write_trace(instr_trace);
     return 0;  // report success to the caller
   }
   catch (const std::exception& e) {
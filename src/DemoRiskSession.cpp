@@ -0,0 +1,121 @@
+#include <chrono>
+#include <iostream>
+
+#include "PortfolioUtils.h"
+#include "RiskSession.h"
+
+using namespace::minirisk;
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+void print_totals(const RiskSession& session) {
+  for (size_t s = 0; s < session.n_scenarios(); ++s) {
+    const auto res = session.total(s);
+    std::cout << session.scenario(s).name << ": " << res.first
+      << " (errors: " << res.second << ")\n";
+  }
+  std::cout << "\n";
+}
+
+void refresh(RiskSession& session, const string& label) {
+  auto start = std::chrono::steady_clock::now();
+  size_t n_priced = session.refresh();
+  std::cout << label << ": " << session.n_trades() << " trades, "
+    << n_priced << " priced in " << elapsed_ms(start) << " ms\n";
+  print_totals(session);
+}
+
+// Books a portfolio in a risk session, then applies the trades of the update
+// file as intraday amendments: the i-th trade of the update replaces the
+// i-th booked trade, or is added if the update is longer than the portfolio.
+// The last n_cancel trades are cancelled.
+void run(const string& portfolio_file, const string& risk_factors_file,
+    const string& fixing_path, const string& base_ccy,
+    const string& update_file, size_t n_cancel) {
+  std::shared_ptr<const MarketDataServer> mds(
+      new MarketDataServer(risk_factors_file));
+  std::shared_ptr<const FixingDataServer> fds;
+  if (!fixing_path.empty())
+    fds.reset(new FixingDataServer(fixing_path));
+
+  RiskSession session(mds, fds, Date(2017,8,5), base_ccy);
+  portfolio_t portfolio = load_portfolio(portfolio_file);
+  for (size_t i = 0; i < portfolio.size(); ++i)
+    session.add_trade("T" + std::to_string(i), portfolio[i]);
+  refresh(session, "Start of day");
+
+  if (!update_file.empty()) {
+    portfolio_t update = load_portfolio(update_file);
+    for (size_t i = 0; i < update.size(); ++i) {
+      if (i < portfolio.size())
+        session.amend_trade("T" + std::to_string(i), update[i]);
+      else
+        session.add_trade("T" + std::to_string(i), update[i]);
+    }
+    portfolio.resize(std::max(portfolio.size(), update.size()));
+  }
+  for (size_t i = 0; i < n_cancel && i < portfolio.size(); ++i)
+    session.remove_trade("T" + std::to_string(portfolio.size() - 1 - i));
+  refresh(session, "Intraday");
+
+  session.recompute_totals();
+  std::cout << "Recomputed totals:\n";
+  print_totals(session);
+}
+
+void usage() {
+  std::cerr
+      << "Invalid command line arguments\n"
+      << "Example:\n"
+      << "DemoRiskSession -p portfolio.txt -f risk_factors.txt\n"
+      << "Optional: -x fixings.txt -b base_ccy -u update_portfolio.txt "
+      << "-c number_of_cancellations\n";
+  std::exit(-1);
+}
+
+int main(int argc, const char **argv) {
+  // parse command line arguments
+  string portfolio, riskfactors, fixingpath, baseccy, update;
+  size_t n_cancel = 0;
+  if (argc % 2 == 0)
+    usage();
+  try {
+    for (int i = 1; i < argc; i += 2) {
+      string key(argv[i]);
+      string value(argv[i+1]);
+      if (key == "-p")
+        portfolio = value;
+      else if (key == "-f")
+        riskfactors = value;
+      else if (key == "-x")
+        fixingpath = value;
+      else if (key == "-b")
+        baseccy = value;
+      else if (key == "-u")
+        update = value;
+      else if (key == "-c")
+        n_cancel = std::stoul(value);
+      else
+        usage();
+    }
+  }
+  catch (const std::logic_error&) {
+    usage();
+  }
+  if (portfolio == "" || riskfactors == "")
+    usage();
+  if (baseccy == "")
+    baseccy = "USD";
+
+  try {
+    run(portfolio, riskfactors, fixingpath, baseccy, update, n_cancel);
+    return 0;  // report success to the caller
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1; // report an error to the caller
+  }
+}
@@ -0,0 +1,71 @@
+#include <iostream>
+
+#include "ResultWriter.h"
+#include "Sharding.h"
+
+using namespace::minirisk;
+
+void usage() {
+  std::cerr
+      << "Invalid command line arguments\n"
+      << "Example:\n"
+      << "DemoShardedRisk -p portfolio.txt -f risk_factors.txt -n shards\n"
+      << "Optional: -x fixings.txt -b base_ccy\n"
+      << "          -o text|csv|binary (results format) -r results_file\n";
+  std::exit(-1);
+}
+
+int main(int argc, const char **argv) {
+  // parse command line arguments
+  shard_inputs_t inputs;
+  inputs.today = Date(2017,8,5);
+  string result_file, result_format_name;
+  size_t n_shards = 0;
+  if (argc % 2 == 0)
+    usage();
+  try {
+    for (int i = 1; i < argc; i += 2) {
+      string key(argv[i]);
+      string value(argv[i+1]);
+      if (key == "-p")
+        inputs.portfolio_file = value;
+      else if (key == "-f")
+        inputs.risk_factors_file = value;
+      else if (key == "-x")
+        inputs.fixing_path = value;
+      else if (key == "-b")
+        inputs.base_ccy = value;
+      else if (key == "-n")
+        n_shards = std::stoul(value);
+      else if (key == "-o")
+        result_format_name = value;
+      else if (key == "-r")
+        result_file = value;
+      else
+        usage();
+    }
+  }
+  catch (const std::logic_error&) {
+    usage();
+  }
+  if (inputs.portfolio_file == "" || inputs.risk_factors_file == ""
+      || n_shards == 0)
+    usage();
+  if (inputs.base_ccy == "")
+    inputs.base_ccy = "USD";
+
+  try {
+    result_format_t result_format = result_format_name.empty()
+      ? result_format_t::text : parse_result_format(result_format_name);
+    RiskCube cube = run_sharded(inputs, n_shards);
+    ResultWriter out(result_file, result_format);
+    for (size_t s = 0; s < cube.n_scenarios(); ++s)
+      out.write(cube, s);
+    out.close();
+    return 0;  // report success to the caller
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1; // report an error to the caller
+  }
+}
@@ -0,0 +1,120 @@
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+#include "PortfolioUtils.h"
+#include "TickIngestion.h"
+
+using namespace::minirisk;
+
+void run(const string& portfolio_file, const string& risk_factors_file,
+    const string& fixing_path, const string& base_ccy,
+    const string& ticks_file, double window_ms, bool verbose) {
+  portfolio_t portfolio = load_portfolio(portfolio_file);
+  std::vector<ppricer_t> pricers(get_pricers(portfolio, base_ccy));
+
+  std::shared_ptr<const MarketDataServer> mds(
+      new MarketDataServer(risk_factors_file));
+  std::shared_ptr<const FixingDataServer> fds;
+  if (!fixing_path.empty())
+    fds.reset(new FixingDataServer(fixing_path));
+
+  TickRevaluation reval(pricers, mds, fds, Date(2017,8,5));
+  std::cout << "Initial PV: " << portfolio_total(reval.prices()).first << "\n";
+
+  // the feed is read by a separate thread, so that updates keep being
+  // received and coalesced while a batch is being revalued
+  std::ifstream file;
+  if (ticks_file != "-") {
+    file.open(ticks_file);
+    MYASSERT(!file.fail(), "Could not open file " << ticks_file);
+  }
+  std::istream& is = ticks_file == "-" ? std::cin : file;
+  TickQueue queue;
+  std::thread reader([&]() {
+    try {
+      read_ticks(is, queue);
+    } catch (const std::exception& e) {
+      std::cerr << e.what() << "\n";
+      queue.close();
+    }
+  });
+
+  size_t n_batches = 0;
+  revalue_ticks(queue, reval,
+      std::chrono::duration_cast<TickQueue::clock_t::duration>(
+        std::chrono::duration<double, std::milli>(window_ms)),
+      [&](const std::vector<size_t>& repriced, const tick_batch_stats_t& stats) {
+        const auto& prices = reval.prices();
+        std::cout << "Batch " << ++n_batches << ": "
+          << stats.n_updates << " risk factors updated ("
+          << stats.n_received << " updates received so far), "
+          << stats.n_repriced << " trades repriced, latency "
+          << stats.latency_ms << " ms, PV " << portfolio_total(prices).first
+          << "\n";
+        if (verbose)
+          for (size_t t : repriced)
+            std::cout << "  " << t << ": " << (std::isnan(prices[t].first)
+                ? prices[t].second : std::to_string(prices[t].first)) << "\n";
+      });
+  reader.join();
+}
+
+void usage() {
+  std::cerr
+      << "Invalid command line arguments\n"
+      << "Example:\n"
+      << "DemoTicks -p portfolio.txt -f risk_factors.txt -k ticks.txt\n"
+      << "Optional: -x fixings.txt -b base_ccy -w coalescing_window_ms "
+      << "-v 1 (print repriced trades)\n"
+      << "Use -k - to read the updates from the standard input\n";
+  std::exit(-1);
+}
+
+int main(int argc, const char **argv) {
+  // parse command line arguments
+  string portfolio, riskfactors, fixingpath, baseccy, ticks;
+  double window_ms = 10;
+  bool verbose = false;
+  if (argc % 2 == 0)
+    usage();
+  try {
+    for (int i = 1; i < argc; i += 2) {
+      string key(argv[i]);
+      string value(argv[i+1]);
+      if (key == "-p")
+        portfolio = value;
+      else if (key == "-f")
+        riskfactors = value;
+      else if (key == "-x")
+        fixingpath = value;
+      else if (key == "-b")
+        baseccy = value;
+      else if (key == "-k")
+        ticks = value;
+      else if (key == "-w")
+        window_ms = std::stod(value);
+      else if (key == "-v")
+        verbose = value != "0";
+      else
+        usage();
+    }
+  }
+  catch (const std::logic_error&) {
+    usage();
+  }
+  if (portfolio == "" || riskfactors == "" || ticks == "")
+    usage();
+  if (baseccy == "")
+    baseccy = "USD";
+
+  try {
+    run(portfolio, riskfactors, fixingpath, baseccy, ticks, window_ms, verbose);
+    return 0;  // report success to the caller
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1; // report an error to the caller
+  }
+}
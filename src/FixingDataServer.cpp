@@ -4,10 +4,12 @@
 
 #include "Macros.h"
 #include "Global.h"
+#include "MarketSnapshot.h"
 
 namespace minirisk {
 
 FixingDataServer::FixingDataServer(const std::string& filename) {
+  INSTR_SCOPE("FixingDataServer");
   std::ifstream is(filename);
   MYASSERT(!is.fail(), "Could not open file " << filename);
   std::string name;
@@ -20,18 +22,40 @@ FixingDataServer::FixingDataServer(const std::string& filename) {
   }
 }
 
+FixingDataServer::FixingDataServer(
+    std::shared_ptr<const MarketSnapshot> snapshot)
+  : m_snapshot(snapshot) {
+  MYASSERT(m_snapshot, "No market snapshot");
+}
+
+FixingDataServer::FixingDataServer(
+    const FixingDataServer& fds, const Date& until) {
+  fds.for_each([&](const std::string& name, const Date& t, double value) {
+      if (t <= until)
+        m_data[name].emplace(t, value);
+    });
+}
+
 double FixingDataServer::get(const std::string& name, const Date& t) const {
-  auto iter = m_data.find(name);
-  MYASSERT(iter != m_data.end(), "Fixing not found: " << name << "," 
-      << t.to_string());
-  auto date_iter = iter->second.find(t);
-  MYASSERT(date_iter != iter->second.end(), "Fixing not found: " 
-      << name << "," << t.to_string());
-  return date_iter->second;
+  double value = nan<double>();
+  try_get(name, t, value).check();
+  return value;
+}
+
+Status FixingDataServer::try_get(
+    const std::string& name, const Date& t, double& value) const {
+  const auto& res = lookup(name, t);
+  if (!res.second)
+    RETURN_ERROR(status_code_t::missing_fixing,
+        "Fixing not found: " << name << "," << t.to_string());
+  value = res.first;
+  return Status();
 }
 
 std::pair<double, bool> FixingDataServer::lookup(
     const std::string& name, const Date& t) const {
+  if (m_snapshot)
+    return m_snapshot->lookup_fixing(name, t);
   auto iter = m_data.find(name);
   if (iter != m_data.end()) {
     auto date_iter = iter->second.find(t);
@@ -40,5 +64,17 @@ std::pair<double, bool> FixingDataServer::lookup(
   }
   return std::make_pair(nan<double>(), false);
 }
+
+void FixingDataServer::for_each(
+    const std::function<void(const std::string&, const Date&, double)>& f)
+  const {
+  if (m_snapshot) {
+    m_snapshot->for_each_fixing(f);
+    return;
+  }
+  for (const auto& d : m_data)
+    for (const auto& v : d.second)
+      f(d.first, v.first, v.second);
+}
   
 } // namespace minirisk
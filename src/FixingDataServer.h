@@ -1,20 +1,36 @@
 #pragma once
 
-#include <string>
+#include <functional>
 #include <map>
+#include <memory>
+#include <string>
 
 #include "Date.h"
+#include "Status.h"
 
 namespace minirisk {
 
+struct MarketSnapshot;
+
 struct FixingDataServer {
  public:
   explicit FixingDataServer(const std::string& filename);
+  // serves the fixings of a market snapshot, without copying them
+  explicit FixingDataServer(std::shared_ptr<const MarketSnapshot> snapshot);
+  // the fixings of fds up to a date, i.e. the ones known on that date
+  FixingDataServer(const FixingDataServer& fds, const Date& until);
   double get(const std::string& name, const Date& t) const;
+  Status try_get(const std::string& name, const Date& t, double& value) const;
   std::pair<double, bool> lookup(const std::string& name, const Date& t) const;
 
+  // visits all fixings, sorted by name and date
+  void for_each(
+      const std::function<void(const std::string&, const Date&, double)>& f)
+    const;
+
  private:
   std::map<std::string, std::map<Date, double>> m_data;
+  std::shared_ptr<const MarketSnapshot> m_snapshot;
 };
 
 } // namespace minirisk
@@ -18,6 +18,11 @@ inline string ir_curve_discount_name(const string& ccy) {
   return ir_curve_discount_prefix + ccy;
 }
 
+// the tenors of the discount curve of ccy, e.g. IR.1Y.EUR
+inline string ir_tenors_regex(const string& ccy) {
+  return ir_rate_prefix + "[0-9]+(D|W|M|Y)\\." + ccy;
+}
+
 inline string fx_spot_name(const string& ccy1, const string& ccy2) {
   return fx_spot_prefix + ccy1 + "." + ccy2;
 }
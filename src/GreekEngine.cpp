@@ -0,0 +1,336 @@
+#include "GreekEngine.h"
+
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include "Global.h"
+#include "Instrumentation.h"
+#include "Macros.h"
+#include "Market.h"
+
+namespace minirisk {
+namespace {
+// risk factors bumped together, and their absolute shifts
+struct bump_item_t {
+  std::string key;
+  Market::vec_risk_factor_t base;
+  std::vector<double> shift;
+  double h;                       // shift of the first risk factor
+};
+
+// distinct currencies (last 3 letters) of the risk factors, in order
+std::vector<std::string> risk_ccys(const Market::vec_risk_factor_t& risk_factors) {
+  std::set<std::string> seen;
+  std::vector<std::string> ccys;
+  for (const auto& rf : risk_factors) {
+    std::string ccy = rf.first.substr(rf.first.length() - 3);
+    if (seen.insert(ccy).second)
+      ccys.push_back(ccy);
+  }
+  return ccys;
+}
+
+bump_item_t make_item(const std::string& key,
+    const Market::vec_risk_factor_t& base, const bump_config_t& c) {
+  MYASSERT(c.bump_type != bump_type_t::relative || base.size() == 1,
+      "Relative bumps of several risk factors: " << key);
+  MYASSERT(c.bump_type != bump_type_t::none && c.bump_size > 0.0,
+      "Invalid bump of " << key);
+  bump_item_t item{key, base, {}, 0.0};
+  for (const auto& rf : base)
+    item.shift.push_back(c.bump_type == bump_type_t::relative
+        ? rf.second * c.bump_size : c.bump_size);
+  item.h = item.shift.empty() ? c.bump_size : item.shift[0];
+  return item;
+}
+
+std::vector<bump_item_t> bump_items(const Market& mkt, const bump_config_t& c) {
+  std::vector<bump_item_t> items;
+  switch (c.risk_class) {
+    case risk_class_t::ir_tenor:
+      for (const auto& rf : mkt.get_risk_factors(
+            ir_rate_prefix + "[0-9]+(D|W|M|Y)\\.[A-Z]{3}"))
+        items.push_back(make_item(rf.first, {rf}, c));
+      break;
+    case risk_class_t::ir_parallel:
+      for (const auto& ccy : risk_ccys(mkt.get_risk_factors(
+            ir_rate_prefix + "([0-9]+(D|W|M|Y)\\.)?[A-Z]{3}")))
+        items.push_back(make_item(ir_rate_prefix + ccy, mkt.get_risk_factors(
+            ir_rate_prefix + "([0-9]+(D|W|M|Y)\\.)?" + ccy), c));
+      break;
+    case risk_class_t::fx_spot:
+      for (const auto& ccy : risk_ccys(
+            mkt.get_risk_factors(fx_spot_prefix + "[A-Z]{3}"))) {
+        auto base = mkt.get_risk_factors(fx_spot_prefix + ccy);
+        MYASSERT(base.size() == 1,
+            "Duplicate fx spot rate." << fx_spot_prefix + ccy);
+        items.push_back(make_item(fx_spot_prefix + ccy, base, c));
+      }
+      break;
+  }
+  return items;
+}
+
+std::string delta_prefix(risk_class_t c) {
+  switch (c) {
+    case risk_class_t::ir_tenor: return "PV01 bucketed ";
+    case risk_class_t::ir_parallel: return "PV01 parallel ";
+    case risk_class_t::fx_spot: return "FX delta ";
+  }
+  return "";
+}
+
+measure_t delta_measure(risk_class_t c) {
+  switch (c) {
+    case risk_class_t::ir_tenor: return measure_t::pv01_bucketed;
+    case risk_class_t::ir_parallel: return measure_t::pv01_parallel;
+    case risk_class_t::fx_spot: return measure_t::fx_delta;
+  }
+  return measure_t::pv;
+}
+
+std::vector<std::string> names(const Market::vec_risk_factor_t& risk_factors) {
+  std::vector<std::string> res;
+  for (const auto& rf : risk_factors)
+    res.push_back(rf.first);
+  return res;
+}
+
+// base value -> bumped value of each risk factor, for the given moves
+void add_bumps(const bump_item_t& item, double sign,
+    std::map<std::string, std::pair<double, double>>& bumps) {
+  for (size_t i = 0; i < item.base.size(); ++i) {
+    auto ins = bumps.emplace(item.base[i].first,
+        std::make_pair(item.base[i].second, item.base[i].second));
+    ins.first->second.second += sign * item.shift[i];
+  }
+}
+
+// scenario of the item moved by sign times its shifts
+size_t moved(risk_plan_t& plan, const bump_item_t& item, double sign) {
+  std::map<std::string, std::pair<double, double>> bumps;
+  add_bumps(item, sign, bumps);
+  return plan.add_scenario(bumps);
+}
+
+// terms of the delta of an item, and their denominator
+std::vector<std::pair<size_t, double>> delta_terms(risk_plan_t& plan,
+    const bump_item_t& item, bump_scheme_t scheme, double& denom) {
+  switch (scheme) {
+    case bump_scheme_t::forward:
+      denom = item.h;
+      return {{moved(plan, item, 1.0), 1.0}, {0, -1.0}};
+    case bump_scheme_t::backward:
+      denom = item.h;
+      return {{0, 1.0}, {moved(plan, item, -1.0), -1.0}};
+    case bump_scheme_t::central:
+      denom = 2.0 * item.h;
+      return {{moved(plan, item, 1.0), 1.0}, {moved(plan, item, -1.0), -1.0}};
+  }
+  return {};
+}
+
+bump_type_t parse_bump_type(const std::string& s) {
+  if (s == "absolute")
+    return bump_type_t::absolute;
+  if (s == "relative")
+    return bump_type_t::relative;
+  THROW("Unknown bump type: " << s);
+}
+} // namespace
+
+greek_config_t default_greek_config() {
+  greek_config_t res;
+  res.classes.push_back(bump_config_t{risk_class_t::ir_tenor,
+      bump_type_t::absolute, 0.01 / 100, bump_scheme_t::central, false});
+  res.classes.push_back(bump_config_t{risk_class_t::ir_parallel,
+      bump_type_t::absolute, 0.01 / 100, bump_scheme_t::central, false});
+  res.classes.push_back(bump_config_t{risk_class_t::fx_spot,
+      bump_type_t::relative, 0.1 / 100, bump_scheme_t::central, false});
+  return res;
+}
+
+greek_config_t parse_greek_config(std::istream& is) {
+  greek_config_t res;
+  string line;
+  while (std::getline(is, line)) {
+    std::istringstream ls(line);
+    string first;
+    if (!(ls >> first) || first[0] == '#')
+      continue;
+    if (first == "parallel_from_buckets") {
+      res.parallel_from_buckets = true;
+      continue;
+    }
+    if (first == "cross") {
+      string a, b;
+      MYASSERT(ls >> a >> b, "Invalid cross gamma: " << line);
+      res.cross_gammas.push_back(std::make_pair(a, b));
+      continue;
+    }
+    bump_config_t c;
+    if (first == "ir_tenor")
+      c.risk_class = risk_class_t::ir_tenor;
+    else if (first == "ir_parallel")
+      c.risk_class = risk_class_t::ir_parallel;
+    else if (first == "fx_spot")
+      c.risk_class = risk_class_t::fx_spot;
+    else
+      THROW("Unknown risk class: " << first);
+    string type, scheme, gamma;
+    MYASSERT(ls >> type >> c.bump_size >> scheme, "Invalid bump: " << line);
+    c.bump_type = parse_bump_type(type);
+    if (scheme == "forward")
+      c.scheme = bump_scheme_t::forward;
+    else if (scheme == "backward")
+      c.scheme = bump_scheme_t::backward;
+    else if (scheme == "central")
+      c.scheme = bump_scheme_t::central;
+    else
+      THROW("Unknown bump scheme: " << scheme);
+    c.gamma = false;
+    if (ls >> gamma) {
+      MYASSERT(gamma == "gamma", "Invalid bump: " << line);
+      c.gamma = true;
+    }
+    res.classes.push_back(c);
+  }
+  return res;
+}
+
+greek_config_t load_greek_config(const std::string& filename) {
+  std::ifstream is(filename);
+  MYASSERT(!is.fail(), "Could not open file " << filename);
+  return parse_greek_config(is);
+}
+
+measure_t parse_measure(const std::string& s) {
+  if (s == "pv")
+    return measure_t::pv;
+  if (s == "pv01_bucketed")
+    return measure_t::pv01_bucketed;
+  if (s == "pv01_parallel")
+    return measure_t::pv01_parallel;
+  if (s == "fx_delta")
+    return measure_t::fx_delta;
+  if (s == "gamma")
+    return measure_t::gamma;
+  if (s == "cross_gamma")
+    return measure_t::cross_gamma;
+  THROW("Unknown measure: " << s);
+}
+
+greek_config_t select_measures(const greek_config_t& config,
+    const std::vector<measure_t>& measures) {
+  auto selected = [&](measure_t m) {
+    return std::find(measures.begin(), measures.end(), m) != measures.end();
+  };
+  greek_config_t res;
+  res.parallel_from_buckets = config.parallel_from_buckets;
+  for (const auto& c : config.classes) {
+    if (!selected(delta_measure(c.risk_class)))
+      continue;
+    res.classes.push_back(c);
+    res.classes.back().gamma = c.gamma && selected(measure_t::gamma);
+  }
+  if (selected(measure_t::cross_gamma))
+    res.cross_gammas = config.cross_gammas;
+  return res;
+}
+
+risk_plan_t plan_greeks(const Market& mkt, const greek_config_t& config) {
+  risk_plan_t plan;
+  std::set<std::string> cross_items;
+  for (const auto& c : config.cross_gammas) {
+    cross_items.insert(c.first);
+    cross_items.insert(c.second);
+  }
+  const bump_config_t *tenor = nullptr;
+  for (const auto& c : config.classes)
+    if (c.risk_class == risk_class_t::ir_tenor && !tenor)
+      tenor = &c;
+
+  std::map<std::string, bump_item_t> items_by_key;
+  for (const auto& c : config.classes) {
+    auto items = bump_items(mkt, c);
+    // a parallel shift is the sum of the tenor shifts by the same amount
+    const bool from_buckets = config.parallel_from_buckets && tenor
+      && c.risk_class == risk_class_t::ir_parallel && !c.gamma
+      && c.bump_type == bump_type_t::absolute
+      && tenor->bump_type == bump_type_t::absolute
+      && c.bump_size == tenor->bump_size && c.scheme == tenor->scheme;
+    for (const auto& item : items) {
+      plan_row_t row{scenario_info_t{delta_prefix(c.risk_class) + item.key,
+          delta_measure(c.risk_class), names(item.base), c.bump_type,
+          c.bump_size}, {}, 0.0};
+      const bool buckets = from_buckets && !cross_items.count(item.key)
+        && std::all_of(item.base.begin(), item.base.end(),
+            [](const Market::vec_risk_factor_t::value_type& rf) {
+              return std::count(rf.first.begin(), rf.first.end(), '.') == 2; });
+      if (buckets) {
+        for (const auto& rf : item.base) {
+          auto terms = delta_terms(plan, make_item(rf.first, {rf}, *tenor),
+              c.scheme, row.denom);
+          row.terms.insert(row.terms.end(), terms.begin(), terms.end());
+        }
+      } else {
+        row.terms = delta_terms(plan, item, c.scheme, row.denom);
+      }
+      plan.rows.push_back(std::move(row));
+      items_by_key.emplace(item.key, item);
+    }
+    if (c.gamma) {
+      for (const auto& item : items) {
+        plan.rows.push_back(plan_row_t{scenario_info_t{"Gamma " + item.key,
+            measure_t::gamma, names(item.base), c.bump_type, c.bump_size},
+            {{moved(plan, item, 1.0), 1.0}, {0, -2.0},
+              {moved(plan, item, -1.0), 1.0}}, item.h * item.h});
+      }
+    }
+  }
+
+  for (const auto& c : config.cross_gammas) {
+    auto a = items_by_key.find(c.first), b = items_by_key.find(c.second);
+    MYASSERT(a != items_by_key.end(),
+        "Cross gamma of an unknown item: " << c.first);
+    MYASSERT(b != items_by_key.end(),
+        "Cross gamma of an unknown item: " << c.second);
+    const bump_item_t& ia = a->second;
+    const bump_item_t& ib = b->second;
+    std::map<std::string, std::pair<double, double>> bumps;
+    add_bumps(ia, 1.0, bumps);
+    add_bumps(ib, 1.0, bumps);
+    auto risk_factors = names(ia.base);
+    for (const auto& rf : ib.base)
+      risk_factors.push_back(rf.first);
+    plan.rows.push_back(plan_row_t{scenario_info_t{
+        "Cross gamma " + ia.key + " " + ib.key, measure_t::cross_gamma,
+        risk_factors, bump_type_t::absolute, 0.0},
+        {{plan.add_scenario(bumps), 1.0}, {moved(plan, ia, 1.0), -1.0},
+          {moved(plan, ib, 1.0), -1.0}, {0, 1.0}}, ia.h * ib.h});
+  }
+  return plan;
+}
+
+void compute_greeks(const std::vector<ppricer_t>& pricers, const Market& mkt,
+    std::shared_ptr<const FixingDataServer> fds, const greek_config_t& config,
+    RiskCube& cube, const portfolio_values_t* base_pv, ThreadPool* pool,
+    const trade_dependencies_t* base_deps) {
+  INSTR_SCOPE("compute_greeks");
+  if (base_pv) {
+    run_risk_plan(pricers, mkt, fds, plan_greeks(mkt, config), cube, base_pv,
+        pool, base_deps);
+    return;
+  }
+  // the base revaluation fetches the risk factors to bump
+  Market base_mkt(mkt);
+  trade_dependencies_t deps;
+  auto base = compute_prices(pricers, base_mkt, fds, nullptr, &deps);
+  run_risk_plan(pricers, base_mkt, fds, plan_greeks(base_mkt, config), cube,
+      &base, pool, &deps);
+}
+
+} // namespace minirisk
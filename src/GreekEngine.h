@@ -0,0 +1,96 @@
+#pragma once
+
+#include <iosfwd>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "FixingDataServer.h"
+#include "IPricer.h"
+#include "PortfolioUtils.h"
+#include "RiskCube.h"
+#include "RiskPlan.h"
+
+namespace minirisk {
+
+struct Market;
+
+// Risk factors bumped together for one greek
+enum class risk_class_t {
+  ir_tenor,     // each IR.<tenor>.<ccy>, rows "PV01 bucketed <risk factor>"
+  ir_parallel,  // all the IR risk factors of a ccy, rows "PV01 parallel IR.<ccy>"
+  fx_spot       // each FX.SPOT.<ccy>, rows "FX delta <risk factor>"
+};
+
+// Finite differences: forward (up - base) / h, backward (base - down) / h,
+// central (up - down) / 2h
+enum class bump_scheme_t { forward, backward, central };
+
+struct bump_config_t {
+  risk_class_t risk_class;
+  bump_type_t bump_type;  // relative bumps only apply to single risk factors
+  double bump_size;
+  bump_scheme_t scheme;
+  bool gamma;             // also (up - 2 base + down) / h^2
+};
+
+struct greek_config_t {
+  std::vector<bump_config_t> classes;
+  // pairs of bumped items (a risk factor, or IR.<ccy> for ir_parallel), of
+  // classes in the configuration
+  std::vector<std::pair<std::string, std::string>> cross_gammas;
+  // parallel PV01 as the sum of the bucketed ones, when ir_tenor has the
+  // same absolute bump and scheme. Saves the parallel revaluations; exact
+  // for a book linear in the rates, else differs by the curvature terms.
+  bool parallel_from_buckets = false;
+};
+
+// the greeks of DemoRisk: central differences of PV01 bucketed and
+// parallel by 1bp, and of fx delta by 0.1%
+greek_config_t default_greek_config();
+
+// Reads a configuration, one line per risk class or cross gamma:
+//   ir_tenor|ir_parallel|fx_spot absolute|relative size
+//       forward|backward|central [gamma]
+//   cross item1 item2
+//   parallel_from_buckets
+// Empty lines and lines starting with # are skipped.
+greek_config_t parse_greek_config(std::istream& is);
+greek_config_t load_greek_config(const std::string& filename);
+
+// parse "pv", "pv01_bucketed", "pv01_parallel", "fx_delta", "gamma" or
+// "cross_gamma"
+measure_t parse_measure(const std::string& s);
+
+// The risk classes of the configuration whose delta measure is selected,
+// with their gammas only if gamma is selected, and the cross gammas only if
+// cross_gamma is selected.
+greek_config_t select_measures(const greek_config_t& config,
+    const std::vector<measure_t>& measures);
+
+// The unique bumped scenarios of the greeks of a configuration, and the
+// rows of compute_greeks derived from them. A scenario needed by several
+// greeks, e.g. an up bump used by a delta, a gamma and a cross gamma, or a
+// single tenor curve shifted in parallel, appears once.
+risk_plan_t plan_greeks(const Market& mkt, const greek_config_t& config);
+
+// Appends to the cube, for each risk class in turn, one delta row per
+// bumped item (see risk_class_t) in units of PV per unit move of its risk
+// factors, then one gamma row "Gamma <item>" per item if requested. Then
+// the rows "Cross gamma <item1> <item2>", estimated as
+// (V(up1, up2) - V(up1) - V(up2) + V) / (h1 h2).
+//
+// The risk factors bumped are the ones the market has fetched, e.g. to
+// compute the base prices. These are revalued first if not given, and
+// each scenario of plan_greeks is revalued once (see run_risk_plan),
+// concurrently on the pool if given. A scenario only reprices the trades
+// depending on its bumped risk factors, as recorded with the base prices
+// if given (see compute_prices), else by a base revaluation.
+void compute_greeks(const std::vector<ppricer_t>& pricers, const Market& mkt,
+    std::shared_ptr<const FixingDataServer> fds, const greek_config_t& config,
+    RiskCube& cube, const portfolio_values_t* base_pv = nullptr,
+    ThreadPool* pool = nullptr,
+    const trade_dependencies_t* base_deps = nullptr);
+
+} // namespace minirisk
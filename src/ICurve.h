@@ -5,6 +5,7 @@
 
 #include "IObject.h"
 #include "Date.h"
+#include "Status.h"
 
 using std::string;
 
@@ -18,6 +19,9 @@ struct ICurve : IObject
 {
     virtual string name() const = 0;
     virtual Date today() const = 0;
+
+    // bytes used by the curve and owned by it (see MemoryReport.h)
+    virtual size_t memory_size() const = 0;
 };
 
 // forward declaration
@@ -32,14 +36,31 @@ typedef std::shared_ptr<const ICurveFXForward> ptr_fx_fwd_curve_t;
 
 struct ICurveDiscount : ICurve
 {
+    // compute the discount factor for date t, without throwing on failure
+    virtual Status try_df(const Date& t, double& df) const = 0;
+
     // compute the discount factor for date t
-    virtual double df(const Date& t) const = 0;
+    double df(const Date& t) const
+    {
+        double res;
+        try_df(t, res).check();
+        return res;
+    }
 };
 
 struct ICurveFXForward : ICurve
 {
+    // compute the FX forward price of currency ccy1 deniminated in ccy2 for delivery at time t,
+    // without throwing on failure
+    virtual Status try_fwd(const Date& t, double& fwd) const = 0;
+
     // compute the FX forward price of currency ccy1 deniminated in ccy2 for delivery at time t
-    virtual double fwd(const Date& t) const = 0;
+    double fwd(const Date& t) const
+    {
+        double res;
+        try_fwd(t, res).check();
+        return res;
+    }
 };
 
 struct ICurveFXSpot : ICurve
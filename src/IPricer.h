@@ -5,13 +5,50 @@
 #include "IObject.h"
 #include "Market.h"
 #include "FixingDataServer.h"
+#include "MarketRequirements.h"
+#include "Status.h"
 
 namespace minirisk {
 
+// most markets priced at once by IPricer::try_price_batch
+const size_t max_price_lanes = 8;
+
 struct IPricer : IObject
 {
-    virtual double price(Market& m) const { return price(m, nullptr); }
-    virtual double price(Market& m, const FixingDataServer* fds) const = 0;
+    double price(Market& m) const { return price(m, nullptr); }
+
+    double price(Market& m, const FixingDataServer* fds) const
+    {
+        double res;
+        try_price(m, fds, res).check();
+        return res;
+    }
+
+    // Expected failures (expired trades, missing fixings or FX rates) are
+    // reported via the returned status instead of throwing. Exceptions are
+    // still possible for unexpected conditions, e.g. missing market data.
+    virtual Status try_price(Market& m, const FixingDataServer* fds, double& price) const = 0;
+
+    // Prices on n <= max_price_lanes markets at once, e.g. the scenarios of
+    // a batch: status[k] and price[k] are those of try_price on mkts[k].
+    // Pricers may read the trade once and evaluate the markets as lanes of
+    // one loop, with the same arithmetic as try_price.
+    virtual void try_price_batch(Market* const* mkts, size_t n,
+        const FixingDataServer* fds, Status* status, double* price) const
+    {
+        for (size_t k = 0; k < n; ++k)
+            status[k] = try_price(*mkts[k], fds, price[k]);
+    }
+
+    // Declares the market data try_price will read when pricing on today
+    // with the fixings of fds: exactly the curves it would build, so that
+    // fetching them beforehand does not change the risk factors of the
+    // market.
+    virtual void add_requirements(const Date& today,
+        const FixingDataServer* fds, market_requirements_t& req) const = 0;
+
+    // bytes used by the pricer (see MemoryReport.h)
+    virtual size_t memory_size() const = 0;
 };
 
 typedef std::shared_ptr<const IPricer> ppricer_t;
@@ -3,6 +3,7 @@
 #include <vector>
 #include <memory>
 
+#include "Arena.h"
 #include "IObject.h"
 #include "IPricer.h"
 #include "Streamer.h"
@@ -27,11 +28,21 @@ struct ITrade : IObject
     // return option type in human readable format
     virtual const std::string& idname() const = 0;
 
+    // currency in which the trade settles
+    virtual const std::string& ccy() const = 0;
+
+    // date of the last cash flow
+    virtual const Date& maturity() const = 0;
+
     // print trade attributes
     virtual void print(std::ostream& os) const = 0;
 
-    // Get pricer
-    virtual ppricer_t pricer(const std::string& base_ccy) const = 0;
+    // bytes used by the trade (see MemoryReport.h)
+    virtual size_t memory_size() const = 0;
+
+    // Get pricer, allocated in the arena if any
+    virtual ppricer_t pricer(const std::string& base_ccy,
+        const std::shared_ptr<Arena>& arena = nullptr) const = 0;
 };
 
 typedef std::shared_ptr<ITrade> ptrade_t;
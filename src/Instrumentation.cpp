@@ -0,0 +1,179 @@
+#include "Instrumentation.h"
+
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "Macros.h"
+
+namespace minirisk {
+namespace instr {
+namespace {
+
+const char *counter_names[n_counters] = {
+  "curve_build_discount",
+  "curve_build_fx_spot",
+  "curve_build_fx_fwd",
+  "mds_fetch",
+  "curve_cache_hit",
+  "curve_cache_miss",
+  "set_risk_factors",
+  "fx_matrix_rebuild",
+  "curve_snapshot_view",
+  "curve_evicted",
+  "pricer_call",
+  "exception_thrown"
+};
+
+// upper bound on the timeline events kept per thread, totals are unaffected
+const size_t max_events_per_thread = 1 << 20;
+
+struct timer_stat_t {
+  uint64_t count = 0;
+  uint64_t total_ns = 0;
+};
+
+struct event_t {
+  unsigned site;
+  uint64_t begin_ns;
+  uint64_t end_ns;
+};
+
+struct thread_data_t {
+  unsigned tid;
+  uint64_t counters[n_counters] = {};
+  std::vector<timer_stat_t> timers;  // indexed by site
+  std::vector<event_t> events;
+  uint64_t dropped_events = 0;
+};
+
+// Owns the data of all threads, so that it survives thread termination.
+// The lock is only taken when a thread or a call site is first seen and
+// when a report is written.
+struct registry_t {
+  std::mutex mutex;
+  std::vector<std::unique_ptr<thread_data_t>> threads;
+  std::vector<std::string> sites;
+  uint64_t start_ns = now_ns();
+};
+
+registry_t& registry() {
+  static registry_t r;
+  return r;
+}
+
+thread_local thread_data_t *t_data = nullptr;
+
+thread_data_t& this_thread() {
+  if (!t_data) {
+    registry_t& r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    r.threads.emplace_back(new thread_data_t);
+    t_data = r.threads.back().get();
+    t_data->tid = r.threads.size();
+  }
+  return *t_data;
+}
+
+std::ofstream open_report(const std::string& filename) {
+  std::ofstream os(filename);
+  MYASSERT(!os.fail(), "Could not open file " << filename);
+  return os;
+}
+
+} // namespace
+
+bool enabled() {
+#ifdef INSTRUMENT
+  return true;
+#else
+  return false;
+#endif
+}
+
+void count(counter_t c) {
+  ++this_thread().counters[c];
+}
+
+unsigned register_site(const char *name) {
+  registry_t& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.sites.push_back(name);
+  return r.sites.size() - 1;
+}
+
+uint64_t now_ns() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void record(unsigned site, uint64_t begin_ns, uint64_t end_ns) {
+  thread_data_t& d = this_thread();
+  if (d.timers.size() <= site)
+    d.timers.resize(site + 1);
+  ++d.timers[site].count;
+  d.timers[site].total_ns += end_ns - begin_ns;
+  if (d.events.size() < max_events_per_thread)
+    d.events.push_back(event_t{site, begin_ns, end_ns});
+  else
+    ++d.dropped_events;
+}
+
+void write_summary(const std::string& filename) {
+  std::ofstream os = open_report(filename);
+  registry_t& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+
+  uint64_t counters[n_counters] = {};
+  std::vector<timer_stat_t> timers(r.sites.size());
+  uint64_t dropped_events = 0;
+  for (const auto& d : r.threads) {
+    for (unsigned c = 0; c < n_counters; ++c)
+      counters[c] += d->counters[c];
+    for (size_t s = 0; s < d->timers.size(); ++s) {
+      timers[s].count += d->timers[s].count;
+      timers[s].total_ns += d->timers[s].total_ns;
+    }
+    dropped_events += d->dropped_events;
+  }
+
+  os << std::fixed << std::setprecision(3)
+     << "{\n  \"enabled\": " << (enabled() ? "true" : "false")
+     << ",\n  \"threads\": " << r.threads.size()
+     << ",\n  \"dropped_events\": " << dropped_events
+     << ",\n  \"counters\": {";
+  for (unsigned c = 0; c < n_counters; ++c)
+    os << (c ? "," : "") << "\n    \"" << counter_names[c] << "\": "
+       << counters[c];
+  os << "\n  },\n  \"timers\": {";
+  for (size_t s = 0; s < timers.size(); ++s)
+    os << (s ? "," : "") << "\n    \"" << r.sites[s] << "\": { \"count\": "
+       << timers[s].count << ", \"total_ms\": "
+       << timers[s].total_ns * 1e-6 << " }";
+  os << "\n  }\n}\n";
+}
+
+void write_trace(const std::string& filename) {
+  std::ofstream os = open_report(filename);
+  registry_t& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+
+  // timestamps in microseconds since the registry was created
+  os << std::fixed << std::setprecision(3) << "{\"traceEvents\":[";
+  const char *sep = "\n";
+  for (const auto& d : r.threads) {
+    for (const auto& e : d->events) {
+      os << sep << "{\"name\":\"" << r.sites[e.site]
+         << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << d->tid
+         << ",\"ts\":" << (e.begin_ns - r.start_ns) * 1e-3
+         << ",\"dur\":" << (e.end_ns - e.begin_ns) * 1e-3 << "}";
+      sep = ",\n";
+    }
+  }
+  os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+} // namespace instr
+} // namespace minirisk
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// Low overhead instrumentation of the hot paths. Counters and timers are
+// accumulated per thread, without any synchronization, and are merged only
+// when a report is written. Everything compiles to nothing unless INSTRUMENT
+// is defined (make INSTRUMENT=1).
+//
+//   INSTR_COUNT(instr::pricer_call);   // bump a counter
+//   INSTR_SCOPE("compute_prices");     // time the enclosing scope
+
+namespace minirisk {
+namespace instr {
+
+enum counter_t {
+  curve_build_discount,
+  curve_build_fx_spot,
+  curve_build_fx_fwd,
+  mds_fetch,
+  curve_cache_hit,
+  curve_cache_miss,
+  set_risk_factors,
+  fx_matrix_rebuild,
+  curve_snapshot_view,
+  curve_evicted,
+  pricer_call,
+  exception_thrown,
+  n_counters
+};
+
+// true if the library was compiled with INSTRUMENT
+bool enabled();
+
+void count(counter_t c);
+
+// returns the identifier of a timed scope, called once per call site
+unsigned register_site(const char *name);
+
+uint64_t now_ns();
+
+void record(unsigned site, uint64_t begin_ns, uint64_t end_ns);
+
+// counters and timers totals, merged across all threads, in JSON format
+void write_summary(const std::string& filename);
+
+// timeline of all timed scopes in Chrome trace format (chrome://tracing)
+void write_trace(const std::string& filename);
+
+struct ScopedTimer {
+  explicit ScopedTimer(unsigned site) : m_site(site), m_begin(now_ns()) {}
+  ~ScopedTimer() { record(m_site, m_begin, now_ns()); }
+ private:
+  unsigned m_site;
+  uint64_t m_begin;
+};
+
+} // namespace instr
+} // namespace minirisk
+
+#define INSTR_CAT2(a, b) a##b
+#define INSTR_CAT(a, b) INSTR_CAT2(a, b)
+
+#ifdef INSTRUMENT
+#    define INSTR_COUNT(c) ::minirisk::instr::count(c)
+#    define INSTR_SCOPE(name) \
+        static const unsigned INSTR_CAT(instr_site_, __LINE__) = \
+            ::minirisk::instr::register_site(name); \
+        ::minirisk::instr::ScopedTimer INSTR_CAT(instr_timer_, __LINE__)( \
+            INSTR_CAT(instr_site_, __LINE__))
+#else
+#    define INSTR_COUNT(c)
+#    define INSTR_SCOPE(name)
+#endif
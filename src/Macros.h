@@ -4,6 +4,8 @@
 #include <iostream>
 #include <sstream>
 
+#include "Instrumentation.h"
+
     // store the message in str
 #ifdef VERBOSE
 #    define BUILDMSG(msg) \
@@ -30,6 +32,7 @@
         if (!(cond)) \
         { \
             BUILDMSG(msg); \
+            INSTR_COUNT(::minirisk::instr::exception_thrown); \
             throw std::invalid_argument(str); \
         } \
     }
@@ -37,6 +40,7 @@
 #define THROW(msg) \
     { \
         BUILDMSG(msg); \
+        INSTR_COUNT(::minirisk::instr::exception_thrown); \
         throw std::logic_error(str); \
     }
 
@@ -1,20 +1,96 @@
 #include "Market.h"
+#include "AsyncMarketData.h"
 #include "CurveDiscount.h"
 #include "CurveFXSpot.h"
 #include "CurveFXForward.h"
+#include "FixingDataServer.h"
+#include "Instrumentation.h"
+#include "MemoryReport.h"
+#include "ThreadPool.h"
 
 #include <cmath>
 #include <vector>
 
 namespace minirisk {
+namespace {
+const string fx_spot_regex = "FX\\.SPOT\\.[A-Z]{3}(\\.[A-Z]{3})?";
+
+// dependency recordings in progress on this thread, innermost last
+thread_local std::vector<std::pair<const Market *, std::set<string>>>
+  t_recordings;
+
+// moves an array in a shared pointer to its first element
+template <typename T>
+std::shared_ptr<const T> share_array(std::vector<T>&& v) {
+  auto p = std::make_shared<std::vector<T>>(std::move(v));
+  return std::shared_ptr<const T>(p, p->data());
+}
+} // namespace
+
+Market::Market(const std::shared_ptr<const MarketDataServer>& mds, const Date& today)
+    : m_today(today)
+    , m_mds(mds)
+    , m_snapshot(mds ? mds->snapshot() : nullptr)
+    , m_snapshot_modified(false)
+    , m_curves_updated(false)
+    , m_curve_bytes(0)
+    , m_curve_budget(0)
+    , m_curve_tick(0) {
+  if (m_snapshot)
+    attach_fx_spot_rate_matrix();
+  else
+    construct_fx_spot_rate_matrix();
+}
 
 template <typename I, typename T>
 std::shared_ptr<const I> Market::get_curve(const string& name) {
-  ptr_curve_t& curve_ptr = m_curves[name];
-  if (!curve_ptr.get())
-      curve_ptr.reset(new T(this, m_today, name));
+  // the curve is built without holding the lock, as it gets other curves
+  ptr_curve_t curve;
+  std::set<string> deps;
+  {
+      std::lock_guard<std::recursive_mutex> lock(m_mutex);
+      auto iter = m_curves.find(name);
+      if (iter != m_curves.end() && iter->second.curve) {
+          curve = iter->second.curve;
+          iter->second.last_used = ++m_curve_tick;
+          if (current_recording())
+              deps = m_curve_deps[name];
+      }
+  }
+  if (!curve) {
+      INSTR_COUNT(instr::curve_cache_miss);
+      begin_recording();
+      ptr_curve_t built;
+      try {
+          // with a budget, or once curves are rebuilt after updates, curves
+          // are on the heap, so that evicting or dropping them frees their
+          // memory
+          built = make_in_arena<T>(
+              m_curve_budget || m_curves_updated ? nullptr : m_arena.get(),
+              this, m_today, name);
+      } catch (...) {
+          end_recording();
+          throw;
+      }
+      deps = end_recording();
+      std::lock_guard<std::recursive_mutex> lock(m_mutex);
+      curve_entry_t& entry = m_curves[name];
+      if (!entry.curve) {
+          entry.curve = built;
+          entry.bytes = built->memory_size();
+          m_curve_bytes += entry.bytes;
+          m_curve_deps[name] = deps;
+      }
+      entry.last_used = ++m_curve_tick;
+      curve = entry.curve;
+      evict_curves();
+  } else {
+      INSTR_COUNT(instr::curve_cache_hit);
+  }
+  if (auto *r = current_recording())
+      r->insert(deps.begin(), deps.end());
   std::shared_ptr<const I> res = 
-    std::dynamic_pointer_cast<const I>(curve_ptr);
+    std::dynamic_pointer_cast<const I>(curve);
   MYASSERT(res, "Cannot cast object with name " << name << " to type " 
       << typeid(I).name());
   return res;
@@ -33,14 +109,23 @@ const ptr_fx_fwd_curve_t Market::get_fx_fwd_curve(const string& name) {
 }
 
 double Market::from_mds(const string& objtype, const string& name) {
+  record(name);
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
   auto ins = m_risk_factors.emplace(name, nan<double>());
   if (ins.second) { // just inserted, need to be populated
-      MYASSERT(m_mds, "Cannot fetch " << objtype << " " << name 
-          << " because the market data server has been disconnnected");
-      if (objtype == "fx spot" && !m_mds->lookup(name).second) {
-        ins.first->second = m_mds->get(mds_spot_name(name));
-      } else {
-        ins.first->second = m_mds->get(name);
+      INSTR_COUNT(instr::mds_fetch);
+      try {
+          MYASSERT(m_mds, "Cannot fetch " << objtype << " " << name
+              << " because the market data server has been disconnnected");
+          if (objtype == "fx spot" && !m_mds->lookup(name).second) {
+            ins.first->second = m_mds->get(mds_spot_name(name));
+          } else {
+            ins.first->second = m_mds->get(name);
+          }
+      } catch (...) {
+          // not cached, so that whoever asks next gets the error too
+          m_risk_factors.erase(ins.first);
+          throw;
       }
   }
   return ins.first->second;
@@ -53,8 +138,13 @@ double Market::get_yield(const string& ccyname)
 };
 
 Market::vec_risk_factor_t Market::fetch_risk_factors(const string& regex) {
-  if (m_fetched_regex.find(regex) != m_fetched_regex.end())
-    return get_risk_factors(regex);
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
+  if (m_fetched_regex.find(regex) != m_fetched_regex.end()) {
+    auto rates = get_risk_factors(regex);
+    for (const auto& rate : rates)
+      record(rate.first);
+    return rates;
+  }
   auto rate_names = m_mds->match(regex);
   std::vector<std::pair<std::string, double>> rates;
   for (const auto& name : rate_names) {
@@ -64,22 +154,195 @@ Market::vec_risk_factor_t Market::fetch_risk_factors(const string& regex) {
   return rates;
 }
 
+std::vector<string> Market::prefetch(const market_requirements_t& req,
+    const FixingDataServer *fds, AsyncMarketData *async) {
+  INSTR_SCOPE("Market::prefetch");
+  std::set<string> ccys;
+  for (const auto& c : req.discount_curves)
+    ccys.insert(c.substr(c.length() - 3));
+  for (const auto& c : req.fx_fwd_curves) {
+    const auto ccy_pair = fx_fwd_name_to_ccy_pair(c);
+    ccys.insert(ccy_pair.first);
+    ccys.insert(ccy_pair.second);
+  }
+
+  // the tenors of each curve not fetched yet, then the yield of the ones
+  // without tenors, as CurveDiscount reads them
+  std::vector<string> tenor_ccys;
+  for (const auto& ccy : ccys) {
+    if (m_fetched_regex.find(ir_tenors_regex(ccy)) == m_fetched_regex.end())
+      tenor_ccys.push_back(ccy);
+  }
+  if (!tenor_ccys.empty()) {
+    MYASSERT(m_mds, "Cannot prefetch market data because the market data "
+        "server has been disconnnected");
+    auto insert = [this](const vec_risk_factor_t& rfs) {
+      for (const auto& rf : rfs) {
+        INSTR_COUNT(instr::mds_fetch);
+        m_risk_factors.emplace(rf);
+      }
+    };
+    // one query per expression, all in flight at once, each inserted as it
+    // arrives, or one request for all of them
+    auto fetch = [&](const std::vector<string>& exprs) {
+      if (async) {
+        std::vector<std::future<vec_risk_factor_t>> queries;
+        for (const auto& e : exprs)
+          queries.push_back(async->fetch({e}));
+        for (auto& q : queries)
+          insert(q.get());
+      } else if (!exprs.empty()) {
+        insert(m_mds->fetch(exprs));
+      }
+    };
+    std::vector<string> exprs;
+    for (const auto& ccy : tenor_ccys)
+      exprs.push_back(ir_tenors_regex(ccy));
+    fetch(exprs);
+    exprs.clear();
+    for (const auto& ccy : tenor_ccys)
+      if (get_risk_factors(ir_tenors_regex(ccy)).empty())
+        exprs.push_back("IR\\." + ccy);
+    fetch(exprs);
+  }
+
+  std::vector<string> missing;
+  for (const auto& ccy : ccys) {
+    const string regex = ir_tenors_regex(ccy);
+    if (m_fetched_regex.insert(regex).second && get_risk_factors(regex).empty()
+        && !has_risk_factor(ir_rate_prefix + ccy))
+      missing.push_back("curve " + ir_curve_discount_name(ccy));
+  }
+  for (const auto& name : req.fx_spots) {
+    double rate;
+    if (!try_get_fx_spot(name, rate).ok())
+      missing.push_back("fx rate " + name);
+  }
+  for (const auto& f : req.fixings)
+    if (!fds || !fds->lookup(f.first, f.second).second)
+      missing.push_back("fixing " + f.first + " " + f.second.to_string());
+  return missing;
+}
+
 double Market::get_fx_spot(const string& name) {
-  const auto ccy_pair = fx_spot_name_to_ccy_pair(name);
-  return get_fx_spot(ccy_pair.first, ccy_pair.second);
+  double rate;
+  try_get_fx_spot(name, rate).check();
+  return rate;
 }
 
 double Market::get_fx_spot(const std::string& base, const std::string& quote) {
-  if (m_fx_ccy_idx.find(base) == m_fx_ccy_idx.end() ||
-      m_fx_ccy_idx.find(quote) == m_fx_ccy_idx.end())
-    MYASSERT(false, "Rate not available for " << base << quote);
-  const auto rate = m_fx_spot_rate[m_fx_ccy_idx[base]][m_fx_ccy_idx[quote]];
-  MYASSERT(rate > 0, "Rate not available for " << base << quote);
+  double rate;
+  try_get_fx_spot(base, quote, rate).check();
   return rate;
 }
 
+Status Market::try_get_fx_spot(const string& name, double& rate) {
+  const auto ccy_pair = fx_spot_name_to_ccy_pair(name);
+  return try_get_fx_spot(ccy_pair.first, ccy_pair.second, rate);
+}
+
+Status Market::try_get_fx_spot(
+    const std::string& base, const std::string& quote, double& rate) {
+  auto i_base = m_fx_ccy_idx.find(base);
+  auto i_quote = m_fx_ccy_idx.find(quote);
+  rate = (i_base == m_fx_ccy_idx.end() || i_quote == m_fx_ccy_idx.end())
+    ? 0.0 : m_fx_spot_rate.get()[
+      i_base->second * m_fx_ccy_idx.size() + i_quote->second];
+  if (!(rate > 0))
+    RETURN_ERROR(status_code_t::missing_fx_rate,
+        "Rate not available for " << base << quote);
+  if (current_recording())
+    record_fx_path(i_base->second, i_quote->second);
+  return Status();
+}
+
+void Market::record_fx_path(int i, int j) {
+  const size_t n = m_fx_ccy_idx.size();
+  int k = m_fx_via.get()[i * n + j];
+  if (k >= 0) {
+    record_fx_path(i, k);
+    record_fx_path(k, j);
+  } else if (m_fx_edge.get()[i * n + j] >= 0) {
+    record(m_fx_rf_names[m_fx_edge.get()[i * n + j]]);
+  }
+}
+
+bool Market::find_snapshot_curve(const string& name, const string& regex,
+    snapshot_curve_t& curve) {
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
+  if (!m_snapshot || m_snapshot_modified || !m_snapshot->find_curve(name, curve))
+    return false;
+  for (const auto& rf : curve.risk_factors)
+    from_mds("curve rate", rf);
+  m_fetched_regex.insert(regex);
+  return true;
+}
+
+void Market::begin_recording() {
+  t_recordings.emplace_back(this, std::set<string>());
+}
+
+std::set<string> *Market::current_recording() const {
+  for (auto r = t_recordings.rbegin(); r != t_recordings.rend(); ++r)
+    if (r->first == this)
+      return &r->second;
+  return nullptr;
+}
+
+std::set<string> Market::end_recording() {
+  auto r = t_recordings.rbegin();
+  while (r != t_recordings.rend() && r->first != this)
+    ++r;
+  MYASSERT(r != t_recordings.rend(), "No dependency recording in progress");
+  std::set<string> res;
+  res.swap(r->second);
+  t_recordings.erase(std::next(r).base());
+  return res;
+}
+
+size_t Market::build_curves(const market_requirements_t& req, ThreadPool& pool) {
+  INSTR_SCOPE("Market::build_curves");
+  // nodes: discount and fx spot curves, without dependencies, then fx
+  // forward curves
+  std::vector<string> names;
+  std::map<string, size_t> index;
+  auto add_leaf = [&](const string& name) {
+    auto ins = index.emplace(name, names.size());
+    if (ins.second)
+      names.push_back(name);
+    return ins.first->second;
+  };
+  for (const auto& c : req.discount_curves)
+    add_leaf(c);
+  std::vector<std::vector<size_t>> fwd_deps;
+  for (const auto& c : req.fx_fwd_curves) {
+    const auto ccy_pair = fx_fwd_name_to_ccy_pair(c);
+    fwd_deps.push_back({add_leaf(ir_curve_discount_name(ccy_pair.first)),
+        add_leaf(ir_curve_discount_name(ccy_pair.second)),
+        add_leaf(fx_spot_name(ccy_pair.first, ccy_pair.second))});
+  }
+  const size_t n_leaves = names.size();
+  std::vector<std::vector<size_t>> deps(n_leaves);
+  names.insert(names.end(), req.fx_fwd_curves.begin(), req.fx_fwd_curves.end());
+  deps.insert(deps.end(), fwd_deps.begin(), fwd_deps.end());
+
+  return run_dag(pool, deps, [&](size_t i) {
+      const string& name = names[i];
+      if (i >= n_leaves)
+        get_fx_fwd_curve(name);
+      else if (name.compare(0, fx_spot_prefix.length(), fx_spot_prefix) == 0)
+        get_fx_spot_curve(name);
+      else
+        get_discount_curve(name);
+      return true;
+    });
+}
+
 void Market::set_risk_factors(const vec_risk_factor_t& risk_factors) {
+  INSTR_COUNT(instr::set_risk_factors);
+  INSTR_SCOPE("Market::set_risk_factors");
   clear();
+  m_snapshot_modified = true;
   for (const auto& d : risk_factors) {
       auto i = m_risk_factors.find(d.first);
       MYASSERT((i != m_risk_factors.end()), "Risk factor not found " 
@@ -89,8 +352,104 @@ void Market::set_risk_factors(const vec_risk_factor_t& risk_factors) {
   construct_fx_spot_rate_matrix();
 }
 
+void Market::update_risk_factors(const vec_risk_factor_t& risk_factors) {
+  INSTR_SCOPE("Market::update_risk_factors");
+  bool fx_spot_changed = false;
+  m_snapshot_modified = true;
+  for (const auto& d : risk_factors) {
+      auto i = m_risk_factors.find(d.first);
+      MYASSERT((i != m_risk_factors.end()), "Risk factor not found "
+          << d.first);
+      i->second = d.second;
+      fx_spot_changed |=
+        d.first.compare(0, fx_spot_prefix.length(), fx_spot_prefix) == 0;
+  }
+  for (auto& c : m_curves) {
+      if (!c.second.curve)
+          continue;
+      const auto& deps = m_curve_deps[c.first];
+      for (const auto& d : risk_factors) {
+          if (deps.find(d.first) != deps.end()) {
+              drop_curve(c.second);
+              m_curves_updated = true;
+              break;
+          }
+      }
+  }
+  if (fx_spot_changed)
+      construct_fx_spot_rate_matrix();
+}
+
+void Market::clear() {
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
+  for (auto& c : m_curves)
+      drop_curve(c.second);
+  m_arena.renew();
+  m_curves_updated = false;
+}
+
+void Market::set_curve_budget(size_t bytes) {
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
+  m_curve_budget = bytes;
+  evict_curves();
+}
+
+void Market::drop_curve(curve_entry_t& entry) {
+  m_curve_bytes -= entry.bytes;
+  entry.bytes = 0;
+  entry.curve.reset();
+}
+
+void Market::evict_curves() {
+  if (!m_curve_budget)
+      return;
+  // the most recently used curve is kept, even if it does not fit
+  while (m_curve_bytes > m_curve_budget) {
+      auto lru = m_curves.end();
+      size_t n_cached = 0;
+      for (auto i = m_curves.begin(); i != m_curves.end(); ++i) {
+          if (!i->second.curve)
+              continue;
+          ++n_cached;
+          if (lru == m_curves.end() || i->second.last_used < lru->second.last_used)
+              lru = i;
+      }
+      if (n_cached <= 1)
+          break;
+      INSTR_COUNT(instr::curve_evicted);
+      drop_curve(lru->second);
+      m_curve_deps.erase(lru->first);
+  }
+}
+
+void Market::memory_report(memory_report_t& report) const {
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
+  report.add("curves", m_curve_bytes);
+  size_t bytes = 0;
+  for (const auto& c : m_curves)
+      bytes += map_node_overhead + sizeof(c) + heap_size(c.first);
+  for (const auto& c : m_curve_deps) {
+      bytes += map_node_overhead + sizeof(c) + heap_size(c.first);
+      for (const auto& d : c.second)
+          bytes += map_node_overhead + sizeof(d) + heap_size(d);
+  }
+  report.add("curve cache", bytes);
+  bytes = 0;
+  for (const auto& rf : m_risk_factors)
+      bytes += map_node_overhead + sizeof(rf) + heap_size(rf.first);
+  report.add("risk factors", bytes);
+  // the arrays may be viewed in the snapshot
+  const size_t n = m_fx_ccy_idx.size();
+  bytes = m_fx_ccy_idx.size() * (map_node_overhead + sizeof(string) + 8)
+    + heap_size(m_fx_rf_names);
+  if (!(m_snapshot && m_fx_spot_rate.get() == m_snapshot->fx_rates()))
+      bytes += n * n * (sizeof(double) + 2 * sizeof(int32_t));
+  report.add("fx matrix", bytes);
+}
+
 Market::vec_risk_factor_t Market::get_risk_factors(
     const std::string& expr) const {
+  std::lock_guard<std::recursive_mutex> lock(m_mutex);
   vec_risk_factor_t result;
   std::regex r(expr);
   for (const auto& d : m_risk_factors)
@@ -100,10 +459,19 @@ Market::vec_risk_factor_t Market::get_risk_factors(
 }
 
 void Market::construct_fx_spot_rate_matrix() {
+  INSTR_COUNT(instr::fx_matrix_rebuild);
+  INSTR_SCOPE("Market::construct_fx_spot_rate_matrix");
   m_fx_ccy_idx.clear();
-  std::memset(m_fx_spot_rate, 0, sizeof m_fx_spot_rate);
-  const auto& fx_rates = fetch_risk_factors(
-      "FX\\.SPOT\\.[A-Z]{3}(\\.[A-Z]{3})?");
+  // the rates are read only to build the matrix, not by whoever is recording
+  begin_recording();
+  vec_risk_factor_t fx_rates;
+  try {
+    fx_rates = fetch_risk_factors(fx_spot_regex);
+  } catch (...) {
+    end_recording();
+    throw;
+  }
+  end_recording();
   u_int32_t idx = 0;
   for (const auto& fx_rate : fx_rates) {
     const auto ccy_pair = fx_spot_name_to_ccy_pair(fx_rate.first);
@@ -113,21 +481,54 @@ void Market::construct_fx_spot_rate_matrix() {
         ++idx;
       }
     }
-    m_fx_spot_rate[m_fx_ccy_idx[ccy_pair.first]][m_fx_ccy_idx[ccy_pair.second]] 
-      = fx_rate.second;
-    m_fx_spot_rate[m_fx_ccy_idx[ccy_pair.second]][m_fx_ccy_idx[ccy_pair.first]] 
-      = 1.0 / fx_rate.second;
+  }
+  size_t size = m_fx_ccy_idx.size();
+  std::vector<double> rate(size * size, 0.0);
+  std::vector<int32_t> via(size * size, -1);
+  std::vector<int32_t> edge(size * size, -1);
+  m_fx_rf_names.clear();
+  for (const auto& fx_rate : fx_rates) {
+    const auto ccy_pair = fx_spot_name_to_ccy_pair(fx_rate.first);
+    u_int32_t i = m_fx_ccy_idx[ccy_pair.first];
+    u_int32_t j = m_fx_ccy_idx[ccy_pair.second];
+    rate[i * size + j] = fx_rate.second;
+    rate[j * size + i] = 1.0 / fx_rate.second;
+    edge[i * size + j] = edge[j * size + i] = m_fx_rf_names.size();
+    m_fx_rf_names.push_back(fx_rate.first);
   }
   
   // Run Floyd-Warshall algorithm to get all pairs' value.
-  size_t size = m_fx_ccy_idx.size();
-  for (int k = 0; k < size; ++k) {
-    m_fx_spot_rate[k][k] = 1.0;
-    for (int i = 0; i < size; ++i)
-      for (int j = 0; j < size; ++j)
-        if (m_fx_spot_rate[i][j] == 0)
-          m_fx_spot_rate[i][j] = m_fx_spot_rate[i][k] * m_fx_spot_rate[k][j];
+  for (size_t k = 0; k < size; ++k) {
+    rate[k * size + k] = 1.0;
+    via[k * size + k] = -1;
+    for (size_t i = 0; i < size; ++i)
+      for (size_t j = 0; j < size; ++j)
+        if (rate[i * size + j] == 0) {
+          rate[i * size + j] = rate[i * size + k] * rate[k * size + j];
+          if (rate[i * size + j] != 0)
+            via[i * size + j] = k;
+        }
   }
+  m_fx_spot_rate = share_array(std::move(rate));
+  m_fx_via = share_array(std::move(via));
+  m_fx_edge = share_array(std::move(edge));
+}
+
+void Market::attach_fx_spot_rate_matrix() {
+  // the quoted rates are still fetched, so that they can be bumped
+  m_fx_rf_names.clear();
+  for (size_t i = 0; i < m_snapshot->n_fx_risk_factors(); ++i) {
+    m_fx_rf_names.push_back(m_snapshot->fx_risk_factor(i));
+    from_mds("curve rate", m_fx_rf_names.back());
+  }
+  m_fetched_regex.insert(fx_spot_regex);
+  m_fx_ccy_idx.clear();
+  for (size_t i = 0; i < m_snapshot->n_fx_ccys(); ++i)
+    m_fx_ccy_idx.emplace(m_snapshot->fx_ccy(i), i);
+  m_fx_spot_rate = std::shared_ptr<const double>(
+      m_snapshot, m_snapshot->fx_rates());
+  m_fx_via = std::shared_ptr<const int32_t>(m_snapshot, m_snapshot->fx_via());
+  m_fx_edge = std::shared_ptr<const int32_t>(m_snapshot, m_snapshot->fx_edge());
 }
 
 std::pair<std::string, std::string> Market::fx_spot_name_to_ccy_pair(
@@ -1,19 +1,31 @@
 #pragma once
 
+#include "Arena.h"
 #include "Global.h"
 #include "IObject.h"
 #include "ICurve.h"
 #include "MarketDataServer.h"
+#include "MarketRequirements.h"
+#include "MarketSnapshot.h"
+#include <cstdint>
+#include <memory>
 #include <vector>
 #include <set>
+#include <mutex>
 #include <regex>
 
 namespace minirisk {
 
+struct FixingDataServer;
+struct ThreadPool;
+struct AsyncMarketData;
+struct memory_report_t;
+
 struct Market : IObject
 {
 private:
-    // NOTE: this function is not thread safe
+    // Curves can be built concurrently, but if two threads build the same
+    // curve at the same time, one of the two curves is discarded.
     template <typename I, typename T>
     std::shared_ptr<const I> get_curve(const string& name);
 
@@ -24,11 +36,10 @@ public:
     typedef std::pair<string, double> risk_factor_t;
     typedef std::vector<std::pair<string, double>> vec_risk_factor_t;
 
-    Market(const std::shared_ptr<const MarketDataServer>& mds, const Date& today)
-        : m_today(today)
-        , m_mds(mds) {
-      construct_fx_spot_rate_matrix();
-    }
+    // If the market data server reads from a market snapshot, the fx matrix
+    // and the discount curves are not built but viewed in the snapshot,
+    // until the risk factors are modified.
+    Market(const std::shared_ptr<const MarketDataServer>& mds, const Date& today);
 
     virtual Date today() const { return m_today; }
 
@@ -44,11 +55,26 @@ public:
 
     vec_risk_factor_t fetch_risk_factors(const string& regex);
 
+    // Fetches the risk factors of all the required curves with one bulk
+    // request to the market data server, so that building them does not
+    // query the server any more. Returns a description of all the required
+    // data which is not available (risk factors, fx rates and fixings).
+    // With an asynchronous access to the server, the data of each curve is
+    // queried separately, all the queries being in flight at once.
+    std::vector<string> prefetch(const market_requirements_t& req,
+        const FixingDataServer *fds, AsyncMarketData *async = nullptr);
+
     // fx exchange rate to convert 1 unit of ccy1 into USD
     double get_fx_spot(const string& name);
 
     double get_fx_spot(const std::string& base, const std::string& quote);
 
+    // same as above, without throwing if the rate is not available
+    Status try_get_fx_spot(const string& name, double& rate);
+
+    Status try_get_fx_spot(
+        const std::string& base, const std::string& quote, double& rate);
+
     // after the market has been disconnected, it is no more possible to fetch
     // new data points from the market data server
     void disconnect()
@@ -59,37 +85,150 @@ public:
     // returns risk factors matching a regular expression
     vec_risk_factor_t get_risk_factors(const std::string& expr) const;
 
-    // clear all market curves execpt for the data points
-    void clear()
+    // true if the risk factor has been fetched from the market data server
+    bool has_risk_factor(const string& name) const
     {
-        std::for_each(m_curves.begin(), m_curves.end(), [](auto& p) { p.second.reset(); });
+        return m_risk_factors.find(name) != m_risk_factors.end();
     }
 
+    // clear all market curves execpt for the data points
+    void clear();
+
+    // Bounds the memory used by the cached curves (see ICurve::memory_size),
+    // 0 meaning no bound. Beyond it, the least recently used curves are
+    // evicted, and built again if needed.
+    void set_curve_budget(size_t bytes);
+    size_t curve_budget() const { return m_curve_budget; }
+
+    // bytes used by the cached curves
+    size_t curve_bytes() const { return m_curve_bytes; }
+
+    // bytes reserved by the arena of the curves
+    size_t arena_bytes() const { return m_arena.get()->bytes_reserved(); }
+
+    // adds the memory used by the curves, risk factors and fx matrix
+    void memory_report(memory_report_t& report) const;
+
     // destroy all existing objects and modify a selected number of data points
     void set_risk_factors(const vec_risk_factor_t& risk_factors);
 
+    // modify a selected number of data points, destroying only the objects
+    // which depend on them
+    void update_risk_factors(const vec_risk_factor_t& risk_factors);
+
+    // Builds the curves needed by the pricers on pool, each exactly once,
+    // independent curves concurrently: the discount and fx spot curves
+    // first, then the fx forward curves built from them. Curves which fail
+    // to build are left to be built (and fail) on demand while pricing.
+    // Returns the number of curves built. The data should be prefetched, or
+    // the fetches from the market data server are serialized.
+    size_t build_curves(const market_requirements_t& req, ThreadPool& pool);
+
+    // Dependency tracking: between begin_recording and end_recording, the
+    // names of all risk factors read, directly or through market objects
+    // (including the ones already built), are collected. Recordings can be
+    // nested, and are separate for each thread.
+    void begin_recording();
+    std::set<string> end_recording();
+
     void construct_fx_spot_rate_matrix();
 
+    // Finds the nodes of a discount curve in the market snapshot, if the
+    // market has one and its risk factors have not been modified since. The
+    // risk factors of the curve are fetched as if it was built from the
+    // ones matching regex.
+    bool find_snapshot_curve(const string& name, const string& regex,
+        snapshot_curve_t& curve);
+
+    const std::shared_ptr<const MarketSnapshot>& snapshot() const
+    {
+        return m_snapshot;
+    }
+
+    // the fx matrix (see construct_fx_spot_rate_matrix), row major by
+    // currency index
+    const std::map<string, u_int32_t>& fx_ccy_index() const { return m_fx_ccy_idx; }
+    const double *fx_spot_rates() const { return m_fx_spot_rate.get(); }
+    const int32_t *fx_via() const { return m_fx_via.get(); }
+    const int32_t *fx_edge() const { return m_fx_edge.get(); }
+    const std::vector<string>& fx_risk_factor_names() const { return m_fx_rf_names; }
+
     std::pair<std::string, std::string> fx_spot_name_to_ccy_pair(
         const std::string& name);
 
     std::pair<std::string, std::string> fx_fwd_name_to_ccy_pair(
         const std::string&name);
 
+private:
+    // the innermost recording of this market on this thread, if any
+    std::set<string> *current_recording() const;
+
+    void record(const string& name)
+    {
+        if (auto *r = current_recording())
+            r->insert(name);
+    }
+
+    // records the quoted rates used to derive the fx rate between the
+    // currencies with index i and j
+    void record_fx_path(int i, int j);
+
+    // views the fx matrix of the market snapshot
+    void attach_fx_spot_rate_matrix();
+
+    struct curve_entry_t {
+        ptr_curve_t curve;     // null if cleared or evicted
+        size_t bytes = 0;
+        uint64_t last_used = 0;
+    };
+
+    // under the lock
+    void drop_curve(curve_entry_t& entry);
+    void evict_curves();
+
 private:
     Date m_today;
     std::shared_ptr<const MarketDataServer> m_mds;
-
-    // market curves
-    std::map<string, ptr_curve_t> m_curves;
+    // kept after disconnecting, the curves and fx matrix may point into it
+    std::shared_ptr<const MarketSnapshot> m_snapshot;
+    bool m_snapshot_modified;
+
+    // market curves, allocated in the arena of this market unless there is a
+    // budget or some curves were dropped by update_risk_factors (the arena
+    // does not release them until clear), and the total of their sizes
+    std::map<string, curve_entry_t> m_curves;
+    ScenarioArena m_arena;
+    bool m_curves_updated;
+    size_t m_curve_bytes;
+    size_t m_curve_budget;
+    uint64_t m_curve_tick;
 
     // raw risk factors
     std::map<string, double> m_risk_factors;
     std::set<std::string> m_fetched_regex;
 
-    // fx spot, assuming number of fx ccy is fewer than 200
+    // risk factors each curve depends on, directly or through other curves
+    std::map<string, std::set<string>> m_curve_deps;
+
+    // guards the curves and the risk factors while curves are built
+    // concurrently; a copy of the market has its own
+    struct market_mutex_t : std::recursive_mutex {
+        market_mutex_t() {}
+        market_mutex_t(const market_mutex_t&) {}
+        market_mutex_t& operator=(const market_mutex_t&) { return *this; }
+    };
+    mutable market_mutex_t m_mutex;
+
+    // for each pair of currency indices (i * number of ccys + j): the fx
+    // spot rate, the index of the intermediate currency on the path found by
+    // construct_fx_spot_rate_matrix, or -1 for a quoted rate, and the index
+    // in m_fx_rf_names of the quoted rate. The arrays are never modified, so
+    // they are shared by copies of the market, and may be in the snapshot.
     std::map<string, u_int32_t> m_fx_ccy_idx;
-    double m_fx_spot_rate[200][200];
+    std::shared_ptr<const double> m_fx_spot_rate;
+    std::shared_ptr<const int32_t> m_fx_via;
+    std::shared_ptr<const int32_t> m_fx_edge;
+    std::vector<string> m_fx_rf_names;
 };
 
 } // namespace minirisk
@@ -1,5 +1,6 @@
 #include "MarketDataServer.h"
 #include "Macros.h"
+#include "MarketSnapshot.h"
 #include "Streamer.h"
 
 #include <limits>
@@ -17,6 +18,7 @@ string mds_spot_name(const string& name) {
 }
 
 MarketDataServer::MarketDataServer(const string& filename) {
+  INSTR_SCOPE("MarketDataServer");
   std::ifstream is(filename);
   MYASSERT(!is.fail(), "Could not open file " << filename);
   do {
@@ -29,13 +31,26 @@ MarketDataServer::MarketDataServer(const string& filename) {
   } while (is);
 }
 
+MarketDataServer::MarketDataServer(
+    std::shared_ptr<const MarketSnapshot> snapshot)
+  : m_snapshot(snapshot) {
+  MYASSERT(m_snapshot, "No market snapshot");
+}
+
 double MarketDataServer::get(const string& name) const {
+  if (m_snapshot) {
+    auto res = m_snapshot->lookup(name);
+    MYASSERT(res.second, "Market data not found: " << name);
+    return res.first;
+  }
   auto iter = m_data.find(name);
   MYASSERT(iter != m_data.end(), "Market data not found: " << name);
   return iter->second;
 }
 
 std::pair<double, bool> MarketDataServer::lookup(const string& name) const {
+  if (m_snapshot)
+    return m_snapshot->lookup(name);
   auto iter = m_data.find(name);
   return (iter != m_data.end())  // found?
           ? std::make_pair(iter->second, true)
@@ -44,6 +59,8 @@ std::pair<double, bool> MarketDataServer::lookup(const string& name) const {
 
 std::vector<std::string> MarketDataServer::match(
     const std::string& expr) const {
+  if (m_snapshot)
+    return m_snapshot->match(expr);
   std::regex r(expr);
   std::vector<std::string> matched;
   for (auto it = m_data.begin(); it != m_data.end(); ++it) {
@@ -54,4 +71,17 @@ std::vector<std::string> MarketDataServer::match(
   return matched;
 }
 
+std::vector<std::pair<string, double>> MarketDataServer::fetch(
+    const std::vector<std::string>& exprs) const {
+  std::vector<std::pair<string, double>> res;
+  if (exprs.empty())
+    return res;
+  string expr;
+  for (const auto& e : exprs)
+    expr += (expr.empty() ? "(?:" : "|(?:") + e + ")";
+  for (const auto& name : match(expr))
+    res.push_back(std::make_pair(name, get(name)));
+  return res;
+}
+
 } // namespace minirisk
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <map>
+#include <memory>
 #include <regex>
 #include <string>
 
@@ -8,6 +9,8 @@
 
 namespace minirisk {
 
+struct MarketSnapshot;
+
 // This is a dummy object that in a real system should be replaced by a server providing
 // with real time (or historical) market data on demand and capable to produce snapshots of data.
 // For the purpose of this example this simply serves to clients some stale pre-loaded market info.
@@ -16,14 +19,29 @@ struct MarketDataServer
 public:
     MarketDataServer(const string& filename);
 
+    // serves the risk factors of a market snapshot, without copying them
+    explicit MarketDataServer(std::shared_ptr<const MarketSnapshot> snapshot);
+
+    // the snapshot this server reads from, if any
+    const std::shared_ptr<const MarketSnapshot>& snapshot() const
+    {
+        return m_snapshot;
+    }
+
     // queries
     double get(const string& name) const;
     std::pair<double, bool> lookup(const string& name) const;
     std::vector<std::string> match(const std::string& expr) const;
 
+    // bulk query: all the risk factors matching any of the expressions, in
+    // one pass over the data (one round trip for a remote server)
+    std::vector<std::pair<string, double>> fetch(
+        const std::vector<std::string>& exprs) const;
+
 private:
     // for simplicity, assumes market data can only have type double
     std::map<string, double> m_data;
+    std::shared_ptr<const MarketSnapshot> m_snapshot;
 };
 
 string mds_spot_name(const string& name);
@@ -0,0 +1,51 @@
+#include "MarketDataSource.h"
+
+#include "Macros.h"
+#include "MarketSnapshot.h"
+
+namespace minirisk {
+
+MarketDataSource::MarketDataSource(const std::string& risk_factors_file,
+    const std::string& fixing_path, const std::string& snapshot_file)
+  : m_risk_factors_file(risk_factors_file)
+  , m_fixing_path(fixing_path)
+  , m_snapshot_file(snapshot_file) {
+  MYASSERT(risk_factors_file.empty() != snapshot_file.empty(),
+      "Either a risk factors file or a market snapshot is needed");
+  m_current = load(1);
+}
+
+MarketDataSource::MarketDataSource(
+    std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds)
+  : m_current(new market_data_t{std::move(mds), std::move(fds), 1}) {
+}
+
+std::shared_ptr<const market_data_t> MarketDataSource::load(
+    uint64_t version) const {
+  std::shared_ptr<market_data_t> res(new market_data_t{nullptr, nullptr, version});
+  if (!m_snapshot_file.empty()) {
+    // a snapshot is republished by renaming a new file over the old one, the
+    // old mapping stays valid for the previous version
+    std::shared_ptr<const MarketSnapshot> snapshot(
+        new MarketSnapshot(m_snapshot_file));
+    res->mds.reset(new MarketDataServer(snapshot));
+    res->fds.reset(new FixingDataServer(snapshot));
+  } else {
+    res->mds.reset(new MarketDataServer(m_risk_factors_file));
+    if (!m_fixing_path.empty())
+      res->fds.reset(new FixingDataServer(m_fixing_path));
+  }
+  return res;
+}
+
+uint64_t MarketDataSource::reload() {
+  std::lock_guard<std::mutex> lock(m_reload_mutex);
+  MYASSERT(!m_risk_factors_file.empty() || !m_snapshot_file.empty(),
+      "The market data was not loaded from files, it cannot be reloaded");
+  auto next = load(current()->version + 1);
+  std::atomic_store(&m_current, next);
+  return next->version;
+}
+
+} // namespace minirisk
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "FixingDataServer.h"
+#include "MarketDataServer.h"
+
+namespace minirisk {
+
+// One version of the market data and fixings, consistent with each other.
+struct market_data_t {
+  std::shared_ptr<const MarketDataServer> mds;
+  std::shared_ptr<const FixingDataServer> fds;  // null if there are none
+  uint64_t version;
+};
+
+// Current market data and fixings, which can be reloaded from disk while
+// they are in use (read-copy-update). A reload loads the files into new
+// servers, then publishes them with an atomic pointer swap. Readers take
+// the current version once, e.g. to construct a Market, and keep a
+// consistent view for as long as they hold it, their lookups never taking
+// a lock. A version is released when its last reader drops it.
+struct MarketDataSource {
+ public:
+  // from a risk factors file and an optional fixings file, or from a market
+  // snapshot (published by DemoPublishSnapshot) if snapshot_file is set
+  MarketDataSource(const std::string& risk_factors_file,
+      const std::string& fixing_path, const std::string& snapshot_file = "");
+
+  // fixed data, which cannot be reloaded
+  MarketDataSource(std::shared_ptr<const MarketDataServer> mds,
+      std::shared_ptr<const FixingDataServer> fds);
+
+  MarketDataSource(const MarketDataSource&) = delete;
+  MarketDataSource& operator=(const MarketDataSource&) = delete;
+
+  // taken once by each reader, not on its lookup path
+  std::shared_ptr<const market_data_t> current() const {
+    return std::atomic_load(&m_current);
+  }
+
+  // Loads the files again and publishes them as a new version, which is
+  // returned. If loading fails, the error is thrown and the current version
+  // stays. Concurrent reloads are serialized.
+  uint64_t reload();
+
+ private:
+  std::shared_ptr<const market_data_t> load(uint64_t version) const;
+
+  std::string m_risk_factors_file;
+  std::string m_fixing_path;
+  std::string m_snapshot_file;
+  std::mutex m_reload_mutex;
+  std::shared_ptr<const market_data_t> m_current;  // accessed atomically
+};
+
+} // namespace minirisk
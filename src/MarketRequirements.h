@@ -0,0 +1,22 @@
+#pragma once
+
+#include <set>
+#include <string>
+#include <utility>
+
+#include "Date.h"
+
+namespace minirisk {
+
+// Market data a portfolio needs to be priced, declared by its pricers before
+// pricing starts (see IPricer::add_requirements). Only the data the pricers
+// will actually read is declared, e.g. no forward curve for a forward whose
+// fixing is known.
+struct market_requirements_t {
+  std::set<std::string> discount_curves;
+  std::set<std::string> fx_fwd_curves;
+  std::set<std::string> fx_spots;                   // FX.SPOT.CCY1.CCY2
+  std::set<std::pair<std::string, Date>> fixings;  // must be known
+};
+
+} // namespace minirisk
@@ -0,0 +1,381 @@
+#include "MarketSnapshot.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <map>
+#include <regex>
+#include <set>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "CurveDiscount.h"
+#include "FixingDataServer.h"
+#include "Global.h"
+#include "Instrumentation.h"
+#include "Macros.h"
+#include "Market.h"
+#include "MarketDataServer.h"
+
+namespace minirisk {
+namespace {
+const char snapshot_magic[8] = {'M', 'R', 'S', 'N', 'A', 'P', '0', '1'};
+
+// Layout of the file. All offsets are in bytes from the start of the file,
+// and all sections are 8-byte aligned.
+struct header_t {
+  char magic[8];
+  uint64_t size;                   // of the whole file
+  uint64_t n_rfs, rfs;             // rf_entry_t, sorted by name
+  uint64_t n_fixings, fixings;     // fixing_entry_t, sorted by name and date
+  uint64_t n_curves, curves;       // curve_entry_t, sorted by name
+  uint64_t n_nodes, nodes;         // (time, log df) pairs of all curves
+  uint64_t n_curve_rfs, curve_rfs; // uint32_t indices in rfs
+  uint64_t n_ccys, ccys;           // string_ref_t, in fx index order
+  uint64_t fx_rates;               // n_ccys x n_ccys doubles
+  uint64_t fx_via, fx_edge;        // n_ccys x n_ccys int32_t
+  uint64_t n_fx_rfs, fx_rfs;       // uint32_t indices in rfs
+  uint64_t n_chars, chars;         // string pool
+};
+
+struct string_ref_t {
+  uint32_t offset;  // in the string pool
+  uint32_t length;
+};
+
+struct rf_entry_t {
+  string_ref_t name;
+  double value;
+};
+
+struct fixing_entry_t {
+  string_ref_t name;
+  uint32_t date;
+  uint32_t padding;
+  double value;
+};
+
+struct curve_entry_t {
+  string_ref_t name;
+  uint32_t first_node, n_nodes;
+  uint32_t first_rf, n_rfs;
+  int64_t last_tenor;
+  double rate;
+};
+
+const header_t& header(const char *base) {
+  return *reinterpret_cast<const header_t *>(base);
+}
+
+int compare(const char *pool, const string_ref_t& ref, const std::string& s) {
+  int c = std::memcmp(pool + ref.offset, s.data(),
+      std::min<size_t>(ref.length, s.length()));
+  if (c != 0)
+    return c;
+  return ref.length < s.length() ? -1 : ref.length > s.length() ? 1 : 0;
+}
+
+// builds the sections of a snapshot file
+struct writer_t {
+  string_ref_t intern(const std::string& s) {
+    auto ins = m_strings.emplace(s, string_ref_t{
+        static_cast<uint32_t>(m_pool.size()),
+        static_cast<uint32_t>(s.length())});
+    if (ins.second)
+      m_pool += s;
+    return ins.first->second;
+  }
+
+  // appends an array, returning its offset
+  template <typename T>
+  uint64_t append(const std::vector<T>& v) {
+    return append(v.data(), v.size() * sizeof(T));
+  }
+
+  uint64_t append(const void *p, size_t n) {
+    uint64_t offset = m_data.size();
+    m_data.append(reinterpret_cast<const char *>(p), n);
+    m_data.append((8 - m_data.size() % 8) % 8, '\0');
+    return offset;
+  }
+
+  std::map<std::string, string_ref_t> m_strings;
+  std::string m_pool;
+  std::string m_data;
+};
+} // namespace
+
+MarketSnapshot::MarketSnapshot(const std::string& filename) {
+  INSTR_SCOPE("MarketSnapshot");
+  int fd = ::open(filename.c_str(), O_RDONLY);
+  MYASSERT(fd >= 0, "Could not open file " << filename << ": "
+      << std::strerror(errno));
+  struct stat st;
+  void *p = MAP_FAILED;
+  if (::fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(header_t))
+    p = ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  MYASSERT(p != MAP_FAILED, "Could not map market snapshot " << filename);
+  m_base = static_cast<const char *>(p);
+  m_size = st.st_size;
+
+  // check the layout, not the content
+  const header_t& h = header(m_base);
+  bool valid = std::memcmp(h.magic, snapshot_magic, sizeof(h.magic)) == 0
+    && h.size == m_size;
+  auto fits = [&](uint64_t offset, uint64_t n, size_t elem_size) {
+    return offset % 8 == 0 && offset <= m_size
+      && n <= (m_size - offset) / elem_size;
+  };
+  valid = valid
+    && fits(h.rfs, h.n_rfs, sizeof(rf_entry_t))
+    && fits(h.fixings, h.n_fixings, sizeof(fixing_entry_t))
+    && fits(h.curves, h.n_curves, sizeof(curve_entry_t))
+    && fits(h.nodes, h.n_nodes, sizeof(std::pair<double, double>))
+    && fits(h.curve_rfs, h.n_curve_rfs, sizeof(uint32_t))
+    && fits(h.ccys, h.n_ccys, sizeof(string_ref_t))
+    && fits(h.fx_rates, h.n_ccys * h.n_ccys, sizeof(double))
+    && fits(h.fx_via, h.n_ccys * h.n_ccys, sizeof(int32_t))
+    && fits(h.fx_edge, h.n_ccys * h.n_ccys, sizeof(int32_t))
+    && fits(h.fx_rfs, h.n_fx_rfs, sizeof(uint32_t))
+    && fits(h.chars, h.n_chars, 1);
+  if (!valid) {
+    ::munmap(const_cast<char *>(m_base), m_size);
+    THROW("Invalid market snapshot " << filename);
+  }
+}
+
+MarketSnapshot::~MarketSnapshot() {
+  ::munmap(const_cast<char *>(m_base), m_size);
+}
+
+std::pair<double, bool> MarketSnapshot::lookup(const std::string& name) const {
+  const header_t& h = header(m_base);
+  const char *pool = section<char>(h.chars);
+  const rf_entry_t *begin = section<rf_entry_t>(h.rfs);
+  const rf_entry_t *end = begin + h.n_rfs;
+  auto it = std::lower_bound(begin, end, name,
+      [pool](const rf_entry_t& e, const std::string& s) {
+        return compare(pool, e.name, s) < 0; });
+  return (it != end && compare(pool, it->name, name) == 0)
+    ? std::make_pair(it->value, true)
+    : std::make_pair(nan<double>(), false);
+}
+
+std::vector<std::string> MarketSnapshot::match(const std::string& expr) const {
+  const header_t& h = header(m_base);
+  const char *pool = section<char>(h.chars);
+  const rf_entry_t *rfs = section<rf_entry_t>(h.rfs);
+  std::regex r(expr);
+  std::vector<std::string> matched;
+  for (size_t i = 0; i < h.n_rfs; ++i) {
+    std::string name(pool + rfs[i].name.offset, rfs[i].name.length);
+    if (std::regex_match(name, r))
+      matched.push_back(name);
+  }
+  return matched;
+}
+
+size_t MarketSnapshot::n_risk_factors() const {
+  return header(m_base).n_rfs;
+}
+
+std::pair<double, bool> MarketSnapshot::lookup_fixing(
+    const std::string& name, const Date& t) const {
+  const header_t& h = header(m_base);
+  const char *pool = section<char>(h.chars);
+  const fixing_entry_t *begin = section<fixing_entry_t>(h.fixings);
+  const fixing_entry_t *end = begin + h.n_fixings;
+  auto it = std::lower_bound(begin, end, name,
+      [pool, &t](const fixing_entry_t& e, const std::string& s) {
+        int c = compare(pool, e.name, s);
+        return c < 0 || (c == 0 && e.date < t.serial()); });
+  return (it != end && compare(pool, it->name, name) == 0
+      && it->date == t.serial())
+    ? std::make_pair(it->value, true)
+    : std::make_pair(nan<double>(), false);
+}
+
+void MarketSnapshot::for_each_fixing(
+    const std::function<void(const std::string&, const Date&, double)>& f)
+  const {
+  const header_t& h = header(m_base);
+  const char *pool = section<char>(h.chars);
+  const fixing_entry_t *fixings = section<fixing_entry_t>(h.fixings);
+  for (size_t i = 0; i < h.n_fixings; ++i)
+    f(std::string(pool + fixings[i].name.offset, fixings[i].name.length),
+        Date(fixings[i].date), fixings[i].value);
+}
+
+bool MarketSnapshot::find_curve(
+    const std::string& name, snapshot_curve_t& curve) const {
+  const header_t& h = header(m_base);
+  const char *pool = section<char>(h.chars);
+  const curve_entry_t *begin = section<curve_entry_t>(h.curves);
+  const curve_entry_t *end = begin + h.n_curves;
+  auto it = std::lower_bound(begin, end, name,
+      [pool](const curve_entry_t& e, const std::string& s) {
+        return compare(pool, e.name, s) < 0; });
+  if (it == end || compare(pool, it->name, name) != 0)
+    return false;
+  MYASSERT(it->first_node + it->n_nodes <= h.n_nodes
+      && it->first_rf + it->n_rfs <= h.n_curve_rfs,
+      "Invalid curve " << name << " in market snapshot");
+  curve.log_dfs =
+    section<std::pair<double, double>>(h.nodes) + it->first_node;
+  curve.n_log_dfs = it->n_nodes;
+  curve.rate = it->rate;
+  curve.last_tenor = it->last_tenor;
+  curve.risk_factors.clear();
+  const uint32_t *curve_rfs = section<uint32_t>(h.curve_rfs) + it->first_rf;
+  const rf_entry_t *rfs = section<rf_entry_t>(h.rfs);
+  for (size_t i = 0; i < it->n_rfs; ++i) {
+    const auto& rf = rfs[curve_rfs[i]].name;
+    curve.risk_factors.emplace_back(pool + rf.offset, rf.length);
+  }
+  return true;
+}
+
+size_t MarketSnapshot::n_fx_ccys() const {
+  return header(m_base).n_ccys;
+}
+
+std::string MarketSnapshot::fx_ccy(size_t i) const {
+  const header_t& h = header(m_base);
+  const string_ref_t& ref = section<string_ref_t>(h.ccys)[i];
+  return std::string(section<char>(h.chars) + ref.offset, ref.length);
+}
+
+const double *MarketSnapshot::fx_rates() const {
+  return section<double>(header(m_base).fx_rates);
+}
+
+const int32_t *MarketSnapshot::fx_via() const {
+  return section<int32_t>(header(m_base).fx_via);
+}
+
+const int32_t *MarketSnapshot::fx_edge() const {
+  return section<int32_t>(header(m_base).fx_edge);
+}
+
+size_t MarketSnapshot::n_fx_risk_factors() const {
+  return header(m_base).n_fx_rfs;
+}
+
+std::string MarketSnapshot::fx_risk_factor(size_t i) const {
+  const header_t& h = header(m_base);
+  const auto& ref =
+    section<rf_entry_t>(h.rfs)[section<uint32_t>(h.fx_rfs)[i]].name;
+  return std::string(section<char>(h.chars) + ref.offset, ref.length);
+}
+
+void publish_market_snapshot(const std::string& filename,
+    const std::shared_ptr<const MarketDataServer>& mds,
+    const FixingDataServer *fds) {
+  INSTR_SCOPE("publish_market_snapshot");
+  writer_t w;
+  header_t h;
+  std::memset(&h, 0, sizeof(h));
+  std::memcpy(h.magic, snapshot_magic, sizeof(h.magic));
+  w.append(&h, sizeof(h));
+
+  // risk factors, sorted as by the market data server
+  std::vector<std::string> names = mds->match(".*");
+  std::vector<rf_entry_t> rfs;
+  for (const auto& name : names)
+    rfs.push_back(rf_entry_t{w.intern(name), mds->get(name)});
+  auto rf_index = [&names](const std::string& name) {
+    auto it = std::lower_bound(names.begin(), names.end(), name);
+    MYASSERT(it != names.end() && *it == name, "Risk factor not found " << name);
+    return static_cast<uint32_t>(it - names.begin());
+  };
+
+  std::vector<fixing_entry_t> fixings;
+  if (fds)
+    fds->for_each([&](const std::string& name, const Date& t, double value) {
+        fixings.push_back(fixing_entry_t{w.intern(name), t.serial(), 0, value});
+      });
+
+  // every discount curve which can be built from the risk factors; the
+  // nodes do not depend on today, only the date of the last tenor does
+  Date today;
+  Market mkt(mds, today);
+  std::set<std::string> ccys;
+  for (const auto& name : names)
+    if (name.compare(0, ir_rate_prefix.length(), ir_rate_prefix) == 0)
+      ccys.insert(name.substr(name.length() - 3));
+  std::vector<curve_entry_t> curves;
+  std::vector<std::pair<double, double>> nodes;
+  std::vector<uint32_t> curve_rfs;
+  for (const auto& ccy : ccys) {
+    const std::string curve_name = ir_curve_discount_name(ccy);
+    std::shared_ptr<const CurveDiscount> curve;
+    mkt.begin_recording();
+    try {
+      curve = std::dynamic_pointer_cast<const CurveDiscount>(
+          mkt.get_discount_curve(curve_name));
+    } catch (const std::exception&) {
+    }
+    std::set<std::string> deps = mkt.end_recording();
+    if (!curve)
+      continue;
+    curves.push_back(curve_entry_t{w.intern(curve_name),
+        static_cast<uint32_t>(nodes.size()),
+        static_cast<uint32_t>(curve->n_log_dfs()),
+        static_cast<uint32_t>(curve_rfs.size()),
+        static_cast<uint32_t>(deps.size()), curve->last_tenor(),
+        curve->rate()});
+    nodes.insert(nodes.end(),
+        curve->log_dfs(), curve->log_dfs() + curve->n_log_dfs());
+    for (const auto& d : deps)
+      curve_rfs.push_back(rf_index(d));
+  }
+
+  // fx matrix, as built by the market
+  const size_t n_ccys = mkt.fx_ccy_index().size();
+  std::vector<string_ref_t> fx_ccys(n_ccys);
+  for (const auto& c : mkt.fx_ccy_index())
+    fx_ccys[c.second] = w.intern(c.first);
+  std::vector<uint32_t> fx_rfs;
+  for (const auto& name : mkt.fx_risk_factor_names())
+    fx_rfs.push_back(rf_index(name));
+
+  h.n_rfs = rfs.size();
+  h.rfs = w.append(rfs);
+  h.n_fixings = fixings.size();
+  h.fixings = w.append(fixings);
+  h.n_curves = curves.size();
+  h.curves = w.append(curves);
+  h.n_nodes = nodes.size();
+  h.nodes = w.append(nodes);
+  h.n_curve_rfs = curve_rfs.size();
+  h.curve_rfs = w.append(curve_rfs);
+  h.n_ccys = n_ccys;
+  h.ccys = w.append(fx_ccys);
+  h.fx_rates = w.append(mkt.fx_spot_rates(), n_ccys * n_ccys * sizeof(double));
+  h.fx_via = w.append(mkt.fx_via(), n_ccys * n_ccys * sizeof(int32_t));
+  h.fx_edge = w.append(mkt.fx_edge(), n_ccys * n_ccys * sizeof(int32_t));
+  h.n_fx_rfs = fx_rfs.size();
+  h.fx_rfs = w.append(fx_rfs);
+  h.n_chars = w.m_pool.size();
+  h.chars = w.append(w.m_pool.data(), w.m_pool.size());
+  h.size = w.m_data.size();
+  std::memcpy(&w.m_data[0], &h, sizeof(h));
+
+  // readers attached to the previous snapshot keep their mapping
+  std::string tmp = filename + ".tmp" + std::to_string(::getpid());
+  std::FILE *f = std::fopen(tmp.c_str(), "wb");
+  MYASSERT(f, "Could not open file " << tmp);
+  bool ok = std::fwrite(w.m_data.data(), 1, w.m_data.size(), f)
+    == w.m_data.size();
+  ok = (std::fclose(f) == 0) && ok;
+  if (!ok || std::rename(tmp.c_str(), filename.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    THROW("Could not write market snapshot " << filename);
+  }
+}
+
+} // namespace minirisk
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Date.h"
+
+namespace minirisk {
+
+struct MarketDataServer;
+struct FixingDataServer;
+
+// prebuilt discount curve stored in a market snapshot
+struct snapshot_curve_t {
+  const std::pair<double, double> *log_dfs;  // (time, log df), first is (0, 0)
+  size_t n_log_dfs;
+  double rate;                    // yield, used if there is only the first node
+  long last_tenor;                // days from today to the last tenor
+  std::vector<std::string> risk_factors;  // the curve was built from
+};
+
+// Read-only view of a market snapshot file written by
+// publish_market_snapshot. The file is mapped in memory, so that all the
+// processes attached to the same snapshot share one copy of the data.
+// Nothing is parsed or copied: offsets in the file are relative to its
+// start, the tables are sorted by name and are searched in place.
+struct MarketSnapshot {
+ public:
+  explicit MarketSnapshot(const std::string& filename);
+  ~MarketSnapshot();
+
+  MarketSnapshot(const MarketSnapshot&) = delete;
+  MarketSnapshot& operator=(const MarketSnapshot&) = delete;
+
+  // size of the mapping in bytes
+  size_t size() const { return m_size; }
+
+  // risk factors, same queries as MarketDataServer
+  std::pair<double, bool> lookup(const std::string& name) const;
+  std::vector<std::string> match(const std::string& expr) const;
+  size_t n_risk_factors() const;
+
+  // fixings, same query as FixingDataServer
+  std::pair<double, bool> lookup_fixing(
+      const std::string& name, const Date& t) const;
+  void for_each_fixing(
+      const std::function<void(const std::string&, const Date&, double)>& f)
+    const;
+
+  // finds a discount curve by name
+  bool find_curve(const std::string& name, snapshot_curve_t& curve) const;
+
+  // fx matrix as built by Market::construct_fx_spot_rate_matrix: currencies
+  // in index order, n x n rates, intermediate currencies and quoted rates
+  size_t n_fx_ccys() const;
+  std::string fx_ccy(size_t i) const;
+  const double *fx_rates() const;
+  const int32_t *fx_via() const;
+  const int32_t *fx_edge() const;
+  size_t n_fx_risk_factors() const;
+  std::string fx_risk_factor(size_t i) const;
+
+ private:
+  template <typename T>
+  const T *section(uint64_t offset) const {
+    return reinterpret_cast<const T *>(m_base + offset);
+  }
+
+  const char *m_base;
+  size_t m_size;
+};
+
+// Writes all the risk factors of mds, the fixings of fds (optional), and the
+// discount curves and fx matrix built from them. The file is written under a
+// temporary name and then renamed, so that readers never see a partial
+// snapshot. A path under /dev/shm keeps the snapshot in shared memory.
+void publish_market_snapshot(const std::string& filename,
+    const std::shared_ptr<const MarketDataServer>& mds,
+    const FixingDataServer *fds);
+
+} // namespace minirisk
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace minirisk {
+
+// Estimates of the memory used by the objects, in bytes, to keep the
+// footprint of a run predictable. They count the objects and what they own
+// on the heap, not what they share (e.g. curves held by other curves, or
+// data viewed in a market snapshot), nor the allocator overheads.
+
+// heap bytes of a string, the standard library keeps short strings in place
+inline size_t heap_size(const std::string& s) {
+  return s.capacity() > 15 ? s.capacity() + 1 : 0;
+}
+
+template <typename T>
+size_t heap_size(const std::vector<T>& v) {
+  return v.capacity() * sizeof(T);
+}
+
+// bytes of the links of a std::map or std::set node
+const size_t map_node_overhead = 4 * sizeof(void *);
+
+// memory used by each subsystem of a run
+struct memory_report_t {
+  void add(const std::string& subsystem, size_t bytes) {
+    entries.push_back(std::make_pair(subsystem, bytes));
+  }
+
+  size_t total() const {
+    size_t res = 0;
+    for (const auto& e : entries)
+      res += e.second;
+    return res;
+  }
+
+  void print(std::ostream& os) const {
+    for (const auto& e : entries)
+      os << e.first << ": " << e.second << " bytes\n";
+    os << "total: " << total() << " bytes\n";
+  }
+
+  std::vector<std::pair<std::string, size_t>> entries;
+};
+
+} // namespace minirisk
@@ -0,0 +1,89 @@
+#include "MultiDate.h"
+
+#include <cmath>
+#include <future>
+#include <map>
+
+#include "Instrumentation.h"
+#include "Market.h"
+#include "PortfolioUtils.h"
+#include "ThreadPool.h"
+
+namespace minirisk {
+namespace {
+// prices on one date, with the status code of the trades in error
+struct date_prices_t {
+  portfolio_values_t values;
+  std::vector<status_code_t> codes;
+};
+
+date_prices_t price_on(const std::vector<ppricer_t>& pricers,
+    std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds, const Date& today) {
+  INSTR_SCOPE("price_on");
+  Market mkt(mds, today);
+  mkt.prefetch(get_requirements(pricers, today, fds.get()), fds.get());
+  date_prices_t res;
+  res.values.reserve(pricers.size());
+  res.codes.reserve(pricers.size());
+  for (const auto& p : pricers) {
+    INSTR_COUNT(instr::pricer_call);
+    try {
+      double price;
+      Status status = p->try_price(mkt, fds.get(), price);
+      res.values.push_back(status.ok() ? std::make_pair(price, string())
+          : std::make_pair(nan<double>(), status.message()));
+      res.codes.push_back(status.code());
+    } catch (const std::exception& e) {
+      res.values.push_back(std::make_pair(nan<double>(), e.what()));
+      res.codes.push_back(status_code_t::missing_data);
+    }
+  }
+  return res;
+}
+} // namespace
+
+RiskCube compute_pv_dates(const std::vector<ppricer_t>& pricers,
+    std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds,
+    const std::vector<Date>& dates, ThreadPool& pool) {
+  INSTR_SCOPE("compute_pv_dates");
+  // each date and the next one, priced once
+  std::map<unsigned, std::future<date_prices_t>> tasks;
+  for (const auto& d : dates) {
+    for (const Date& t : {d, d + 1}) {
+      if (tasks.count(t.serial()))
+        continue;
+      tasks[t.serial()] = pool.async([&pricers, mds, fds, t] {
+          return price_on(pricers, mds, fds, t); });
+    }
+  }
+  std::map<unsigned, date_prices_t> prices;
+  for (auto& t : tasks)
+    prices[t.first] = t.second.get();
+
+  RiskCube cube(pricers.size());
+  for (const auto& d : dates)
+    cube.add_scenario(scenario_info_t{"PV " + d.to_string(), measure_t::pv,
+        {}, bump_type_t::none, 0.0}, prices[d.serial()].values);
+  for (const auto& d : dates) {
+    const auto& today = prices[d.serial()];
+    const auto& next = prices[(d + 1).serial()];
+    portfolio_values_t theta(pricers.size());
+    for (size_t i = 0; i < pricers.size(); ++i) {
+      if (std::isnan(today.values[i].first))
+        theta[i] = today.values[i];
+      else if (next.codes[i] == status_code_t::expired)
+        theta[i].first = 0.0;
+      else if (std::isnan(next.values[i].first))
+        theta[i] = next.values[i];
+      else
+        theta[i].first = next.values[i].first - today.values[i].first;
+    }
+    cube.add_scenario(scenario_info_t{"Theta " + d.to_string(),
+        measure_t::theta, {}, bump_type_t::none, 1.0}, theta);
+  }
+  return cube;
+}
+
+} // namespace minirisk
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "Date.h"
+#include "FixingDataServer.h"
+#include "IPricer.h"
+#include "MarketDataServer.h"
+#include "RiskCube.h"
+
+namespace minirisk {
+
+struct ThreadPool;
+
+// Revalues the pricers on each of a list of valuation dates, sharing the
+// market data and fixings. Each date has its own market, whose curves are
+// built from the same rates by tenor from that date: the market rolls
+// forward unchanged. Fixings are used on and after their fixing date, as
+// in a run on that date. The dates are priced concurrently on the pool.
+//
+// Returns one row "PV <date>" per date, then one row "Theta <date>" per
+// date: the one-day theta PV(date + 1) - PV(date). A trade which expires
+// before the next day has a theta of zero, its cash flow settling at its
+// PV. A trade in error on either day has the error of the first one.
+RiskCube compute_pv_dates(const std::vector<ppricer_t>& pricers,
+    std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds,
+    const std::vector<Date>& dates, ThreadPool& pool);
+
+} // namespace minirisk
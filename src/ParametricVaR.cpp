@@ -0,0 +1,259 @@
+#include "ParametricVaR.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+
+#include "Global.h"
+#include "Instrumentation.h"
+#include "Macros.h"
+#include "RiskCube.h"
+
+namespace minirisk {
+namespace {
+// doubles of a vector block kept in the L1 cache by the kernels (4KB)
+const size_t tile = 512;
+// rows x rows blocks of the covariance matrix accumulated at once
+const size_t cov_tile = 64;
+
+bool is_sensitivity(const scenario_info_t& info) {
+  return info.risk_factors.size() == 1
+    && (info.measure == measure_t::pv01_bucketed
+      || info.measure == measure_t::pv01_parallel
+      || info.measure == measure_t::fx_delta);
+}
+
+double dot(const std::vector<double>& a, const std::vector<double>& b) {
+  double res = 0.0;
+  for (size_t i = 0; i < a.size(); ++i)
+    res += a[i] * b[i];
+  return res;
+}
+} // namespace
+
+std::vector<std::string> sensitivity_risk_factors(const RiskCube& cube) {
+  std::vector<std::string> res;
+  for (size_t s = 0; s < cube.n_scenarios(); ++s) {
+    const auto& info = cube.scenario(s);
+    if (is_sensitivity(info)
+        && std::find(res.begin(), res.end(), info.risk_factors[0]) == res.end())
+      res.push_back(info.risk_factors[0]);
+  }
+  return res;
+}
+
+void gemv(const double *a, size_t rows, size_t cols, const double *x,
+    double *y) {
+  std::fill(y, y + rows, 0.0);
+  for (size_t j0 = 0; j0 < cols; j0 += tile) {
+    const size_t j1 = std::min(cols, j0 + tile);
+    for (size_t i = 0; i < rows; ++i) {
+      const double *ai = a + i * cols;
+      // four partial sums of interleaved terms
+      double p0 = 0.0, p1 = 0.0, p2 = 0.0, p3 = 0.0;
+      size_t j = j0;
+      for (; j + 4 <= j1; j += 4) {
+        p0 += ai[j] * x[j];
+        p1 += ai[j + 1] * x[j + 1];
+        p2 += ai[j + 2] * x[j + 2];
+        p3 += ai[j + 3] * x[j + 3];
+      }
+      for (; j < j1; ++j)
+        p0 += ai[j] * x[j];
+      y[i] += (p0 + p1) + (p2 + p3);
+    }
+  }
+}
+
+void gemv_t(const double *a, size_t rows, size_t cols, const double *x,
+    double *y) {
+  std::fill(y, y + cols, 0.0);
+  for (size_t j0 = 0; j0 < cols; j0 += tile) {
+    const size_t j1 = std::min(cols, j0 + tile);
+    // four rows at a time, each element of y is updated once per pass
+    size_t i = 0;
+    for (; i + 4 <= rows; i += 4) {
+      const double *a0 = a + i * cols, *a1 = a0 + cols, *a2 = a1 + cols,
+            *a3 = a2 + cols;
+      const double x0 = x[i], x1 = x[i + 1], x2 = x[i + 2], x3 = x[i + 3];
+      for (size_t j = j0; j < j1; ++j)
+        y[j] += (a0[j] * x0 + a1[j] * x1) + (a2[j] * x2 + a3[j] * x3);
+    }
+    for (; i < rows; ++i) {
+      const double *ai = a + i * cols;
+      const double xi = x[i];
+      for (size_t j = j0; j < j1; ++j)
+        y[j] += ai[j] * xi;
+    }
+  }
+}
+
+double normal_quantile(double p) {
+  MYASSERT(p > 0.0 && p < 1.0, "Invalid probability " << p);
+  // bisection of the cumulative distribution 0.5 * erfc(-x / sqrt(2))
+  double lo = -40.0, hi = 40.0;
+  for (int i = 0; i < 200 && lo < hi; ++i) {
+    double mid = 0.5 * (lo + hi);
+    if (mid == lo || mid == hi)
+      break;
+    if (0.5 * std::erfc(-mid / std::sqrt(2.0)) < p)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return 0.5 * (lo + hi);
+}
+
+covariance_t estimate_covariance(const FixingDataServer& history,
+    const std::vector<std::string>& risk_factors) {
+  INSTR_SCOPE("estimate_covariance");
+  const size_t n = risk_factors.size();
+  std::map<std::string, size_t> index;
+  for (size_t i = 0; i < n; ++i)
+    index.emplace(risk_factors[i], i);
+
+  // values by date, on the dates on which all the risk factors are known
+  std::map<Date, std::pair<size_t, std::vector<double>>> values;
+  std::vector<bool> found(n, false);
+  history.for_each([&](const std::string& name, const Date& t, double v) {
+      auto i = index.find(name);
+      if (i == index.end())
+        return;
+      auto& d = values[t];
+      if (d.second.empty())
+        d.second.resize(n);
+      d.second[i->second] = v;
+      ++d.first;
+      found[i->second] = true;
+    });
+  for (size_t i = 0; i < n; ++i)
+    MYASSERT(found[i], "No history of risk factor " << risk_factors[i]);
+  std::vector<const std::vector<double> *> dates;
+  for (const auto& d : values)
+    if (d.second.first == n)
+      dates.push_back(&d.second.second);
+  MYASSERT(dates.size() > 2, "Not enough history to estimate a covariance: "
+      << dates.size() << " dates with all the risk factors");
+
+  // centered changes, one row per change
+  const size_t m = dates.size() - 1;
+  std::vector<double> x(m * n);
+  std::vector<double> mean(n, 0.0);
+  for (size_t k = 0; k < m; ++k) {
+    for (size_t i = 0; i < n; ++i) {
+      x[k * n + i] = (*dates[k + 1])[i] - (*dates[k])[i];
+      mean[i] += x[k * n + i];
+    }
+  }
+  for (size_t k = 0; k < m; ++k)
+    for (size_t i = 0; i < n; ++i)
+      x[k * n + i] -= mean[i] / m;
+
+  // X'X / (m - 1), by blocks on and above the diagonal
+  covariance_t res{risk_factors, std::vector<double>(n * n, 0.0), m};
+  double *c = res.matrix.data();
+  for (size_t i0 = 0; i0 < n; i0 += cov_tile) {
+    const size_t i1 = std::min(n, i0 + cov_tile);
+    for (size_t j0 = i0; j0 < n; j0 += cov_tile) {
+      const size_t j1 = std::min(n, j0 + cov_tile);
+      for (size_t k = 0; k < m; ++k) {
+        const double *xk = x.data() + k * n;
+        for (size_t i = i0; i < i1; ++i) {
+          const double xi = xk[i];
+          double *ci = c + i * n;
+          for (size_t j = j0; j < j1; ++j)
+            ci[j] += xi * xk[j];
+        }
+      }
+    }
+  }
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = i; j < n; ++j) {
+      c[i * n + j] /= m - 1;
+      c[j * n + i] = c[i * n + j];
+    }
+  }
+  return res;
+}
+
+parametric_var_t compute_parametric_var(const RiskCube& sensitivities,
+    const covariance_t& cov, double confidence, double horizon_days) {
+  INSTR_SCOPE("compute_parametric_var");
+  MYASSERT(horizon_days > 0.0, "Invalid VaR horizon " << horizon_days);
+  const size_t n = cov.risk_factors.size();
+  const size_t n_trades = sensitivities.n_trades();
+  std::map<std::string, size_t> index;
+  for (size_t i = 0; i < n; ++i)
+    index.emplace(cov.risk_factors[i], i);
+
+  // sensitivity of each trade (column) to each risk factor (row)
+  std::vector<double> s(n * n_trades, 0.0);
+  std::vector<const std::string *> errors(n_trades, nullptr);
+  std::vector<bool> filled(n, false);
+  for (size_t r = 0; r < sensitivities.n_scenarios(); ++r) {
+    const auto& info = sensitivities.scenario(r);
+    if (!is_sensitivity(info))
+      continue;
+    auto i = index.find(info.risk_factors[0]);
+    if (i == index.end() || filled[i->second])
+      continue;
+    filled[i->second] = true;
+    const double *row = sensitivities.row(r);
+    double *si = s.data() + i->second * n_trades;
+    for (size_t t = 0; t < n_trades; ++t) {
+      if (!std::isnan(row[t]))
+        si[t] = row[t];
+      else if (!errors[t])
+        errors[t] = sensitivities.error(r, t);
+    }
+  }
+  std::vector<size_t> in_error;
+  for (size_t t = 0; t < n_trades; ++t)
+    if (errors[t])
+      in_error.push_back(t);
+  for (size_t i = 0; i < n && !in_error.empty(); ++i)
+    for (size_t t : in_error)
+      s[i * n_trades + t] = 0.0;
+
+  // portfolio sensitivity p, and C p
+  std::vector<double> ones(n_trades, 1.0), p(n), cp(n);
+  gemv(s.data(), n, n_trades, ones.data(), p.data());
+  gemv_t(cov.matrix.data(), n, n, p.data(), cp.data());
+  const double sigma = std::sqrt(std::max(dot(p, cp), 0.0));
+  const double scale = normal_quantile(confidence) * std::sqrt(horizon_days);
+
+  parametric_var_t res;
+  res.var = scale * sigma;
+  res.marginal.assign(n, 0.0);
+  if (sigma > 0.0)
+    for (size_t i = 0; i < n; ++i)
+      res.marginal[i] = scale * cp[i] / sigma;
+  std::vector<double> component(n_trades);
+  gemv_t(s.data(), n, n_trades, res.marginal.data(), component.data());
+  res.component.resize(n_trades);
+  for (size_t t = 0; t < n_trades; ++t)
+    res.component[t] = errors[t] ? std::make_pair(nan<double>(), *errors[t])
+      : std::make_pair(component[t], std::string());
+
+  std::map<std::string, std::vector<size_t>> by_ccy;
+  for (size_t i = 0; i < n; ++i) {
+    const auto& name = cov.risk_factors[i];
+    by_ccy[name.substr(name.length() - std::min<size_t>(3, name.length()))]
+      .push_back(i);
+  }
+  for (const auto& c : by_ccy) {
+    double contribution = 0.0, variance = 0.0;
+    for (size_t i : c.second) {
+      contribution += p[i] * res.marginal[i];
+      const double *ci = cov.matrix.data() + i * n;
+      for (size_t j : c.second)
+        variance += p[i] * ci[j] * p[j];
+    }
+    res.ccys.push_back(c.first);
+    res.ccy_component.push_back(contribution);
+    res.ccy_standalone.push_back(scale * std::sqrt(std::max(variance, 0.0)));
+  }
+  return res;
+}
+
+} // namespace minirisk
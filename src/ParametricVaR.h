@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "FixingDataServer.h"
+#include "PortfolioUtils.h"
+
+namespace minirisk {
+
+struct RiskCube;
+
+// Covariance matrix of the daily changes of some risk factors
+struct covariance_t {
+  std::vector<std::string> risk_factors;
+  std::vector<double> matrix;  // row major, risk factors x risk factors
+  size_t n_changes;            // number of daily changes it is estimated on
+};
+
+// Estimates the covariance of the changes of the risk factors between
+// consecutive dates of a history, read as fixings (lines "name yyyymmdd
+// value", see FixingDataServer). Only the dates on which all the risk
+// factors have a value are used. Throws if a risk factor has no history,
+// or if there are less than two changes.
+covariance_t estimate_covariance(const FixingDataServer& history,
+    const std::vector<std::string>& risk_factors);
+
+// Delta-normal VaR of a portfolio, with its decomposition
+struct parametric_var_t {
+  double var;
+  // dVaR / dsensitivity, for each risk factor of the covariance
+  std::vector<double> marginal;
+  // contribution of each trade, adding up to var; trades in error (in any
+  // sensitivity) are left out of the portfolio and report the error
+  portfolio_values_t component;
+  // per currency of the risk factors (last 3 letters of their name): the
+  // contribution to var, and the VaR of the risk factors of that currency
+  std::vector<std::string> ccys;
+  std::vector<double> ccy_component;
+  std::vector<double> ccy_standalone;
+};
+
+// the risk factors of the sensitivities used by compute_parametric_var, in
+// the order of the rows
+std::vector<std::string> sensitivity_risk_factors(const RiskCube& cube);
+
+// Parametric VaR from the sensitivities of the trades to single risk factors
+// (e.g. the rows of compute_pv01_bucketed and compute_fx_delta, in units of
+// PV per unit of the risk factor), assuming normal changes of the risk
+// factors with covariance cov over one day, scaled to the horizon by the
+// square root of time. The risk factors without sensitivity have none, the
+// sensitivities to a risk factor not in cov are ignored.
+parametric_var_t compute_parametric_var(const RiskCube& sensitivities,
+    const covariance_t& cov, double confidence = 0.99,
+    double horizon_days = 1.0);
+
+// quantile of the standard normal distribution
+double normal_quantile(double p);
+
+// Kernels, on row major matrices, blocked so that the blocks of the vectors
+// they read stay in the L1 cache, with independent accumulators which the
+// compiler vectorizes.
+// y = A x, A is rows x cols
+void gemv(const double *a, size_t rows, size_t cols, const double *x,
+    double *y);
+// y = A' x, A is rows x cols
+void gemv_t(const double *a, size_t rows, size_t cols, const double *x,
+    double *y);
+
+} // namespace minirisk
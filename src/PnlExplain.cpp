@@ -0,0 +1,233 @@
+#include "PnlExplain.h"
+
+#include <cmath>
+#include <functional>
+#include <future>
+#include <map>
+
+#include "Global.h"
+#include "GreekEngine.h"
+#include "Instrumentation.h"
+#include "Macros.h"
+#include "Market.h"
+#include "PortfolioUtils.h"
+#include "ThreadPool.h"
+
+namespace minirisk {
+namespace {
+// one step of the revaluation
+struct step_t {
+  std::string name;
+  std::unique_ptr<Market> mkt;
+  std::shared_ptr<const FixingDataServer> fds;
+};
+
+market_requirements_t merge(
+    market_requirements_t a, const market_requirements_t& b) {
+  a.discount_curves.insert(b.discount_curves.begin(), b.discount_curves.end());
+  a.fx_fwd_curves.insert(b.fx_fwd_curves.begin(), b.fx_fwd_curves.end());
+  a.fx_spots.insert(b.fx_spots.begin(), b.fx_spots.end());
+  a.fixings.insert(b.fixings.begin(), b.fixings.end());
+  return a;
+}
+
+// market on a date with all the data required, built once
+std::unique_ptr<Market> make_market(std::shared_ptr<const MarketDataServer> mds,
+    const Date& today, const market_requirements_t& req,
+    const FixingDataServer *fds, ThreadPool& pool) {
+  std::unique_ptr<Market> mkt(new Market(mds, today));
+  mkt->prefetch(req, fds);
+  mkt->build_curves(req, pool);
+  return mkt;
+}
+
+bool is_ir(const std::string& name) {
+  return name.compare(0, ir_rate_prefix.length(), ir_rate_prefix) == 0;
+}
+
+bool is_fx_spot(const std::string& name) {
+  return name.compare(0, fx_spot_prefix.length(), fx_spot_prefix) == 0;
+}
+
+std::string risk_ccy(const std::string& name) {
+  return name.substr(name.length() - 3);
+}
+} // namespace
+
+RiskCube explain_pnl(const std::vector<ppricer_t>& pricers,
+    std::shared_ptr<const MarketDataServer> mds0, const Date& date0,
+    std::shared_ptr<const MarketDataServer> mds1, const Date& date1,
+    std::shared_ptr<const FixingDataServer> fds, ThreadPool& pool) {
+  INSTR_SCOPE("explain_pnl");
+  MYASSERT(date0 <= date1, "The P&L is explained from "
+      << date0.to_string() << " to an earlier date " << date1.to_string());
+  std::shared_ptr<const FixingDataServer> fds0;
+  if (fds)
+    fds0 = std::make_shared<const FixingDataServer>(*fds, date0);
+
+  std::vector<step_t> steps;
+  steps.push_back(step_t{"PV " + date0.to_string(), make_market(mds0, date0,
+      get_requirements(pricers, date0, fds0.get()), fds0.get(), pool), fds0});
+
+  // the steps on date1 are copies of one market with the risk factors of
+  // mds0, disconnected so that nothing else is read from mds0
+  auto req1 = get_requirements(pricers, date1, fds.get());
+  auto req = merge(get_requirements(pricers, date1, fds0.get()), req1);
+  steps.push_back(step_t{"Time decay",
+      make_market(mds0, date1, req, fds.get(), pool), fds0});
+  steps.back().mkt->disconnect();
+  steps.push_back(step_t{"New fixings",
+      std::unique_ptr<Market>(new Market(*steps.back().mkt)), fds});
+
+  // the moves of the risk factors, by step
+  std::map<std::string, Market::vec_risk_factor_t> ir_moves;
+  Market::vec_risk_factor_t fx_moves;
+  std::map<std::string, std::pair<double, double>> moves;
+  for (const auto& rf : steps.back().mkt->get_risk_factors(".+")) {
+    auto v1 = mds1->lookup(rf.first);
+    if (!v1.second || v1.first == rf.second)
+      continue;
+    moves[rf.first] = std::make_pair(rf.second, v1.first);
+    auto move = std::make_pair(rf.first, v1.first);
+    if (is_ir(rf.first))
+      ir_moves[risk_ccy(rf.first)].push_back(move);
+    else if (is_fx_spot(rf.first))
+      fx_moves.push_back(move);
+  }
+  for (const auto& rf : steps[0].mkt->get_risk_factors(ir_rate_prefix + ".+"))
+    ir_moves[risk_ccy(rf.first)];
+  auto add_step = [&](const std::string& name,
+      const Market::vec_risk_factor_t& risk_factors) {
+    std::unique_ptr<Market> mkt(new Market(*steps.back().mkt));
+    if (!risk_factors.empty()) {
+      mkt->update_risk_factors(risk_factors);
+      mkt->build_curves(req1, pool);
+    }
+    steps.push_back(step_t{name, std::move(mkt), fds});
+  };
+  for (const auto& m : ir_moves)
+    add_step("IR " + m.first, m.second);
+  add_step("FX spot", fx_moves);
+  steps.push_back(step_t{"PV " + date1.to_string(),
+      make_market(mds1, date1, req1, fds.get(), pool), fds});
+
+  // all the steps and the sensitivities at once, the sensitivities on a
+  // copy made before the step markets are used by their tasks
+  RiskCube greeks(pricers.size());
+  Market greeks_mkt(*steps[0].mkt);
+  std::vector<std::future<portfolio_values_t>> tasks;
+  for (auto& s : steps) {
+    tasks.push_back(pool.async([&pricers, &s] {
+        return compute_prices(pricers, *s.mkt, s.fds); }));
+  }
+  auto greeks_task = pool.async([&] {
+      compute_pv01(pricers, greeks_mkt, fds0, greeks);
+      compute_greeks(pricers, greeks_mkt, fds0,
+          select_measures(default_greek_config(),
+            {measure_t::pv01_bucketed, measure_t::fx_delta}), greeks);
+      return true; });
+  std::vector<portfolio_values_t> pv;
+  for (auto& t : tasks)
+    pv.push_back(t.get());
+  greeks_task.get();
+
+  const size_t n = pricers.size();
+  const portfolio_values_t& start = pv.front();
+  const portfolio_values_t& end = pv.back();
+  RiskCube cube(n);
+  cube.add_scenario(scenario_info_t{steps.front().name, measure_t::pv, {},
+      bump_type_t::none, 0.0}, start);
+  std::vector<portfolio_values_t> explained(steps.size() - 1,
+      portfolio_values_t(n));
+  for (size_t t = 0; t < n; ++t) {
+    const trade_value_t *error = std::isnan(start[t].first) ? &start[t]
+      : std::isnan(end[t].first) ? &end[t] : nullptr;
+    double prev = start[t].first;
+    for (size_t k = 1; k < steps.size(); ++k) {
+      auto& e = explained[k - 1][t];
+      if (error) {
+        e = *error;
+      } else if (!std::isnan(pv[k][t].first)) {
+        e.first = pv[k][t].first - prev;
+        prev = pv[k][t].first;
+      }
+    }
+  }
+  // the change to the end market is the one of everything else
+  for (size_t k = 1; k < steps.size(); ++k) {
+    cube.add_scenario(scenario_info_t{
+        k + 1 < steps.size() ? steps[k].name : "Other", measure_t::pnl, {},
+        bump_type_t::none, 0.0}, explained[k - 1]);
+  }
+  portfolio_values_t pnl(explained.back());
+  for (size_t t = 0; t < n; ++t) {
+    if (!std::isnan(pnl[t].first))
+      pnl[t].first = end[t].first - start[t].first;
+  }
+  cube.add_scenario(scenario_info_t{steps.back().name, measure_t::pv, {},
+      bump_type_t::none, 0.0}, end);
+  cube.add_scenario(scenario_info_t{"P&L", measure_t::pnl, {},
+      bump_type_t::none, 0.0}, pnl);
+
+  // predicted P&L: starts from the time decay and new fixings
+  portfolio_values_t predicted(n);
+  for (size_t t = 0; t < n; ++t) {
+    predicted[t] = explained[0][t];
+    if (!std::isnan(predicted[t].first))
+      predicted[t].first += explained[1][t].first;
+  }
+  auto predict = [&](const std::string& name,
+      const std::function<bool(const std::string&)>& selected) {
+    portfolio_values_t res(n);
+    for (size_t t = 0; t < n; ++t) {
+      if (std::isnan(pnl[t].first))
+        res[t] = pnl[t];
+    }
+    for (size_t s = 0; s < greeks.n_scenarios(); ++s) {
+      const auto& info = greeks.scenario(s);
+      if (info.risk_factors.size() != 1 || !selected(info.risk_factors[0]))
+        continue;
+      auto m = moves.find(info.risk_factors[0]);
+      if (m == moves.end())
+        continue;
+      double dx = m->second.second - m->second.first;
+      for (size_t t = 0; t < n; ++t) {
+        if (std::isnan(res[t].first))
+          continue;
+        if (const std::string *error = greeks.error(s, t))
+          res[t] = std::make_pair(nan<double>(), *error);
+        else
+          res[t].first += greeks.row(s)[t] * dx;
+      }
+    }
+    for (size_t t = 0; t < n; ++t) {
+      if (std::isnan(predicted[t].first))
+        continue;
+      if (std::isnan(res[t].first))
+        predicted[t] = res[t];
+      else
+        predicted[t].first += res[t].first;
+    }
+    cube.add_scenario(scenario_info_t{name, measure_t::pnl, {},
+        bump_type_t::none, 0.0}, res);
+  };
+  for (const auto& m : ir_moves) {
+    const std::string& ccy = m.first;
+    predict("Predicted IR " + ccy, [&ccy](const std::string& rf) {
+        return is_ir(rf) && risk_ccy(rf) == ccy; });
+  }
+  predict("Predicted FX spot", is_fx_spot);
+  cube.add_scenario(scenario_info_t{"Predicted P&L", measure_t::pnl, {},
+      bump_type_t::none, 0.0}, predicted);
+
+  portfolio_values_t unexplained(predicted);
+  for (size_t t = 0; t < n; ++t) {
+    if (!std::isnan(unexplained[t].first))
+      unexplained[t].first = pnl[t].first - predicted[t].first;
+  }
+  cube.add_scenario(scenario_info_t{"Unexplained", measure_t::pnl, {},
+      bump_type_t::none, 0.0}, unexplained);
+  return cube;
+}
+
+} // namespace minirisk
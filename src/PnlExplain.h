@@ -0,0 +1,51 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "Date.h"
+#include "FixingDataServer.h"
+#include "IPricer.h"
+#include "MarketDataServer.h"
+#include "RiskCube.h"
+
+namespace minirisk {
+
+struct ThreadPool;
+
+// Explains the change of PV of each trade between a market on date0 (risk
+// factors of mds0, fixings up to date0) and a market on date1 (risk factors
+// of mds1, all the fixings), by revaluing it in a sequence of markets which
+// each change one more thing from the first market to the last one:
+//   "PV <date0>"          start market
+//   "Time decay"          rolled to date1, same risk factors and fixings
+//   "New fixings"         with the fixings up to date1
+//   "IR <ccy>"            with the interest rates of ccy from mds1, per ccy
+//   "FX spot"             with the fx spot rates from mds1
+//   "Other"               from the last step to the end market: the other
+//                         risk factors, and the data missing in mds0
+//   "PV <date1>"          end market
+//   "P&L"                 PV <date1> - PV <date0>
+// The steps are revalued concurrently on the pool, each market being a copy
+// of the previous one which only rebuilds the curves depending on the risk
+// factors it changed. A trade which fails to price in a step (e.g. a forward
+// which fixed between the two dates, until the new fixings are known) has
+// a zero change in it, its change being explained by the next step.
+//
+// The sensitivities to each interest rate and fx spot rate in the start
+// market (see compute_pv01_bucketed and compute_fx_delta) give a predicted
+// P&L for the same moves of the risk factors:
+//   "Predicted IR <ccy>"  sum of PV01 * change of rate, per ccy
+//   "Predicted FX spot"   sum of fx delta * change of rate
+//   "Predicted P&L"       time decay, new fixings and the predicted rows
+//   "Unexplained"         P&L - Predicted P&L
+//
+// A trade which fails to price in the start or end market has the error
+// in all the rows but the PV ones, as has a trade whose sensitivities fail
+// in the predicted rows.
+RiskCube explain_pnl(const std::vector<ppricer_t>& pricers,
+    std::shared_ptr<const MarketDataServer> mds0, const Date& date0,
+    std::shared_ptr<const MarketDataServer> mds1, const Date& date1,
+    std::shared_ptr<const FixingDataServer> fds, ThreadPool& pool);
+
+} // namespace minirisk
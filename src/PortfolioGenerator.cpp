@@ -0,0 +1,190 @@
+#include "PortfolioGenerator.h"
+
+#include <cstdio>
+#include <cmath>
+#include <fstream>
+#include <map>
+
+#include "Global.h"
+#include "Macros.h"
+#include "Streamer.h"
+#include "TradePayment.h"
+#include "TradeFXForward.h"
+
+namespace minirisk {
+namespace {
+// Tenor grid from which the IR nodes are picked.
+const std::vector<std::string> tenor_grid = {
+  "1W", "2W", "1M", "2M", "3M", "6M", "9M", "1Y", "18M", "2Y", "3Y", "4Y",
+  "5Y", "7Y", "10Y", "15Y", "20Y", "30Y"};
+
+// Real currency codes, used before falling back to synthetic ones.
+const std::vector<std::string> iso_ccys = {
+  "USD", "EUR", "GBP", "JPY", "CHF", "AUD", "CAD", "NZD", "SEK", "NOK", "DKK",
+  "HKD", "SGD", "CNY", "KRW", "INR", "MXN", "BRL", "ZAR", "TRY", "PLN", "CZK",
+  "HUF", "ILS", "THB", "MYR", "IDR", "PHP", "TWD", "RUB", "CLP", "COP", "PEN",
+  "SAR", "AED", "QAR", "KWD", "EGP", "NGN", "KES"};
+
+// keeps the fx matrix of Market (n x n rates) small
+const unsigned max_ccys = 200;
+
+// Deterministic generator (splitmix64). The standard distributions are
+// implementation defined, so we do not use them to keep files reproducible
+// across compilers.
+struct rng_t {
+  explicit rng_t(uint64_t seed) : m_state(seed) {}
+
+  uint64_t next() {
+    uint64_t z = (m_state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+  }
+
+  // uniform in [0, 1)
+  double uniform() { return (next() >> 11) * (1.0 / 9007199254740992.0); }
+
+  // uniform in [0, n)
+  unsigned index(unsigned n) { return static_cast<unsigned>(uniform() * n); }
+
+  bool flip(double p) { return uniform() < p; }
+
+ private:
+  uint64_t m_state;
+};
+
+// same convention as CurveDiscount::convert_tenor_to_int
+unsigned tenor_to_days(const std::string& tenor) {
+  unsigned n = std::stoul(tenor.substr(0, tenor.length() - 1));
+  switch (tenor.back()) {
+    case 'D': return n;
+    case 'W': return n * 7;
+    case 'M': return n * 30;
+    case 'Y': return n * 365;
+  }
+  THROW("Unexpected tenor type " << tenor);
+}
+
+std::string to_yyyymmdd(const Date& d) {
+  unsigned y, m, dd;
+  d.to_y_m_d(&y, &m, &dd);
+  char buf[9];
+  std::snprintf(buf, sizeof(buf), "%04u%02u%02u", y, m, dd);
+  return buf;
+}
+} // namespace
+
+PortfolioGenerator::PortfolioGenerator(const generator_config_t& cfg)
+    : m_cfg(cfg) {
+  MYASSERT(cfg.n_ccys >= 1 && cfg.n_ccys <= max_ccys,
+      "Number of currencies must be in [1, " << max_ccys << "], got "
+      << cfg.n_ccys);
+  for (double p : {cfg.fx_forward_fraction, cfg.expired_fraction,
+      cfg.missing_data_fraction})
+    MYASSERT(p >= 0.0 && p <= 1.0, "Fraction out of range: " << p);
+
+  // currencies: ISO codes first, then AAA, AAB, ... skipping the ISO ones
+  for (size_t i = 0; i < iso_ccys.size() && m_ccys.size() < cfg.n_ccys; ++i)
+    m_ccys.push_back(iso_ccys[i]);
+  for (unsigned i = 0; m_ccys.size() < cfg.n_ccys; ++i) {
+    std::string ccy = {char('A' + i / 676), char('A' + i / 26 % 26),
+      char('A' + i % 26)};
+    if (std::find(iso_ccys.begin(), iso_ccys.end(), ccy) == iso_ccys.end())
+      m_ccys.push_back(ccy);
+  }
+
+  // tenors evenly spread over the grid, always including the longest one
+  unsigned n_grid = tenor_grid.size();
+  unsigned n_tenors = std::min(cfg.n_tenors, n_grid);
+  for (unsigned i = 0; i < n_tenors; ++i)
+    m_tenors.push_back(tenor_grid[(i + 1) * n_grid / n_tenors - 1]);
+  m_max_days = m_tenors.empty() ? 10 * 365 : tenor_to_days(m_tenors.back());
+
+  rng_t rng(cfg.seed);
+  for (size_t i = 0; i < m_ccys.size(); ++i) {
+    ccy_data_t d;
+    d.spot = i == 0 ? 1.0 : std::exp(std::log(0.005) * rng.uniform());
+    d.rate = 0.001 + 0.08 * rng.uniform();
+    d.slope = 0.002 * rng.uniform();
+    // USD data is never missing, as it is the pivot of all FX spots
+    d.has_curve = i == 0 || !rng.flip(cfg.missing_data_fraction);
+    d.has_spot = i == 0 || !rng.flip(cfg.missing_data_fraction);
+    m_ccy_data.push_back(d);
+  }
+}
+
+double PortfolioGenerator::cross_spot(size_t ccy1, size_t ccy2) const {
+  return m_ccy_data[ccy1].spot / m_ccy_data[ccy2].spot;
+}
+
+void PortfolioGenerator::write_risk_factors(const std::string& filename) const {
+  std::ofstream os(filename);
+  MYASSERT(!os.fail(), "Could not open file " << filename);
+  os.precision(10);
+  for (size_t i = 0; i < m_ccys.size(); ++i) {
+    const ccy_data_t& d = m_ccy_data[i];
+    if (i > 0 && d.has_spot)
+      os << fx_spot_prefix << m_ccys[i] << " " << d.spot << "\n";
+    if (!d.has_curve)
+      continue;
+    if (m_tenors.empty())
+      os << ir_rate_prefix << m_ccys[i] << " " << d.rate << "\n";
+    for (const auto& tenor : m_tenors)
+      os << ir_rate_prefix << tenor << "." << m_ccys[i] << " "
+        << d.rate + d.slope * tenor_to_days(tenor) / 365.0 << "\n";
+  }
+}
+
+void PortfolioGenerator::write_portfolio(
+    const std::string& portfolio_file, const std::string& fixings_file) const {
+  my_ofstream of(portfolio_file);
+  std::ofstream fixings(fixings_file);
+  MYASSERT(!fixings.fail(), "Could not open file " << fixings_file);
+  fixings.precision(10);
+
+  // fixings already decided, true if written (FixingDataServer rejects
+  // duplicates, and a fixing is either available to all trades or to none)
+  std::map<std::pair<std::string, unsigned>, bool> fixed;
+
+  rng_t rng(m_cfg.seed ^ 0x5deece66dULL);
+  const Date& today = m_cfg.today;
+  unsigned n_ccys = m_ccys.size();
+  TradePayment pmt;
+  TradeFXForward fwd;
+  for (size_t i = 0; i < m_cfg.n_trades; ++i) {
+    double quantity = (rng.flip(0.5) ? -1.0 : 1.0) * (1 + rng.index(1000));
+    bool expired = rng.flip(m_cfg.expired_fraction);
+    if (n_ccys < 2 || !rng.flip(m_cfg.fx_forward_fraction)) {
+      unsigned ccy = rng.index(n_ccys);
+      Date delivery = expired
+        ? today - static_cast<int>(1 + rng.index(365))
+        : today + static_cast<int>(rng.index(m_max_days + 1));
+      pmt.init(m_ccys[ccy], quantity, delivery);
+      static_cast<const ITrade&>(pmt).save(of);
+    } else {
+      unsigned ccy1 = rng.index(n_ccys);
+      unsigned ccy2 = (ccy1 + 1 + rng.index(n_ccys - 1)) % n_ccys;
+      double fwd_rate = cross_spot(ccy1, ccy2);
+      Date fixing_date = expired
+        ? today - static_cast<int>(3 + rng.index(60))
+        : today - 2 + static_cast<int>(rng.index(m_max_days - 1));
+      fwd.init(m_ccys[ccy1], m_ccys[ccy2], quantity,
+          fwd_rate * (0.95 + 0.1 * rng.uniform()), fixing_date,
+          fixing_date + 2);
+      static_cast<const ITrade&>(fwd).save(of);
+
+      if (fixing_date <= today) {
+        const string name = fx_spot_name(m_ccys[ccy1], m_ccys[ccy2]);
+        auto ins = fixed.emplace(std::make_pair(name, fixing_date.serial()),
+            !rng.flip(m_cfg.missing_data_fraction));
+        if (ins.second && ins.first->second)
+          fixings << name << " " << to_yyyymmdd(fixing_date) << " "
+            << fwd_rate * (0.99 + 0.02 * rng.uniform()) << "\n";
+      }
+    }
+    of.endl();
+  }
+  of.close();
+}
+
+} // namespace minirisk
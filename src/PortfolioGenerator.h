@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Date.h"
+
+namespace minirisk {
+
+// Parameters controlling the synthetic portfolio and market data generator.
+// All fractions are probabilities in [0, 1].
+struct generator_config_t {
+  uint64_t seed = 1;
+  size_t n_trades = 1000;
+  double fx_forward_fraction = 0.5;   // share of TradeFXForward vs TradePayment
+  unsigned n_ccys = 10;               // number of currencies, USD included
+  unsigned n_tenors = 10;             // IR nodes per curve, 0 for a flat yield
+  double expired_fraction = 0.05;     // trades settled before today
+  double missing_data_fraction = 0.0; // curves, spots and fixings left out
+  Date today = Date(2017, 8, 5);
+};
+
+// Generates a consistent set of portfolio, risk factor and fixing files which
+// can be fed to DemoRisk. The output only depends on the configuration, so
+// the same seed always reproduces the same files. Trades are streamed to disk
+// one at a time, hence the portfolio size is only limited by disk space.
+struct PortfolioGenerator {
+ public:
+  explicit PortfolioGenerator(const generator_config_t& cfg);
+
+  // write the IR and FX spot risk factors
+  void write_risk_factors(const std::string& filename) const;
+
+  // write the trades and the fixings of the FX forwards fixed in the past
+  void write_portfolio(
+      const std::string& portfolio_file, const std::string& fixings_file) const;
+
+  const std::vector<std::string>& ccys() const { return m_ccys; }
+
+ private:
+  struct ccy_data_t {
+    double spot;       // value of one unit of currency in USD
+    double rate;       // short end of the curve
+    double slope;      // rate increase per year
+    bool has_curve;
+    bool has_spot;
+  };
+
+  double cross_spot(size_t ccy1, size_t ccy2) const;
+
+  generator_config_t m_cfg;
+  std::vector<std::string> m_ccys;
+  std::vector<ccy_data_t> m_ccy_data;
+  std::vector<std::string> m_tenors;
+  unsigned m_max_days;  // days to the last tenor, trades mature before it
+};
+
+} // namespace minirisk
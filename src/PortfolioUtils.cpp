@@ -1,7 +1,13 @@
 #include "Global.h"
 #include "PortfolioUtils.h"
+#include "GreekEngine.h"
 #include "TradePayment.h"
 #include "TradeFXForward.h"
+#include "Instrumentation.h"
+#include "MemoryReport.h"
+#include "Reduction.h"
+#include "ResultWriter.h"
+#include "RiskCube.h"
 
 #include <cmath>
 #include <set>
@@ -9,30 +15,6 @@
 
 namespace minirisk {
 namespace {
-void bump_risk_factors(const double bump_size, 
-    std::vector<std::pair<std::string, double>>* bumped_up, 
-    std::vector<std::pair<std::string, double>>* bumped_dn) {
-  for (auto& p : *bumped_up) {
-    p.second += bump_size;
-  }
-  for (auto& p : *bumped_dn) {
-    p.second -= bump_size;
-  }
-}
-
-void find_all_risk_ccy(
-    const std::vector<std::pair<std::string, double>>& risk_factors, 
-    std::vector<std::string> *ccys) {
-  std::set<std::string> risk_ccys;
-  for (const auto& rf : risk_factors) {
-    std::string ccy = rf.first.substr(rf.first.length() - 3);
-    if (risk_ccys.find(ccy) == risk_ccys.end()) {
-      risk_ccys.insert(ccy);
-      ccys->push_back(ccy);
-    }
-  }
-}
-
 trade_value_t pv01_or_nan(trade_value_t& hi, trade_value_t& lo, double dr) {
   if (std::isnan(hi.first))
     return std::make_pair(nan<double>(), hi.second);
@@ -40,6 +22,30 @@ trade_value_t pv01_or_nan(trade_value_t& hi, trade_value_t& lo, double dr) {
     return std::make_pair(nan<double>(), lo.second);
   return std::make_pair((hi.first - lo.first) / dr, "");
 }
+
+// append to the cube the central differences estimator (hi - lo) / dr
+void add_central_difference(RiskCube& cube, const scenario_info_t& info,
+    portfolio_values_t& hi, portfolio_values_t& lo, double dr) {
+  portfolio_values_t res(hi.size());
+  std::transform(hi.begin(), hi.end(), lo.begin(), res.begin(),
+      [dr](auto& h, auto& l) -> trade_value_t { return pv01_or_nan(h, l, dr); });
+  cube.add_scenario(info, res);
+}
+
+// the price of a trade, or the error of its pricer
+trade_value_t price_trade(const IPricer& pricer, Market& mkt,
+    const FixingDataServer* fds) {
+  try {
+    double price;
+    Status status = pricer.try_price(mkt, fds, price);
+    if (status.ok())
+      return std::make_pair(price, "");
+    return std::make_pair(nan<double>(), status.message());
+  } catch (std::exception& e) {
+    return std::make_pair(nan<double>(), e.what());
+  }
+}
+
 }
 
 void print_portfolio(const portfolio_t& portfolio) {
@@ -49,30 +55,81 @@ void print_portfolio(const portfolio_t& portfolio) {
 std::vector<ppricer_t> get_pricers(
     const portfolio_t& portfolio, const std::string& base_ccy) {
   std::vector<ppricer_t> pricers(portfolio.size());
+  // all pricers are released together
+  std::shared_ptr<Arena> arena = std::make_shared<Arena>();
   std::transform(
       portfolio.begin(), portfolio.end(), pricers.begin(), 
-      [base_ccy](auto &pt) -> ppricer_t { return pt->pricer(base_ccy); } );
+      [&](auto &pt) -> ppricer_t { return pt->pricer(base_ccy, arena); } );
   return pricers;
 }
 
+market_requirements_t get_requirements(const std::vector<ppricer_t>& pricers,
+    const Date& today, const FixingDataServer *fds) {
+  INSTR_SCOPE("get_requirements");
+  market_requirements_t req;
+  for (const auto& p : pricers)
+    p->add_requirements(today, fds, req);
+  return req;
+}
+
 portfolio_values_t compute_prices(
     const std::vector<ppricer_t>& pricers, Market& mkt, 
-    std::shared_ptr<const FixingDataServer> fds) {
+    std::shared_ptr<const FixingDataServer> fds,
+    const portfolio_values_t* base, trade_dependencies_t* deps) {
+  INSTR_SCOPE("compute_prices");
+  MYASSERT(!base || base->size() == pricers.size(),
+      "Base prices do not match the number of pricers");
   portfolio_values_t prices;
-  for (const auto& pricer : pricers) {
-    try {
-      auto price = pricer->price(mkt, fds.get());
-      prices.push_back(std::make_pair(price, ""));
-    } catch (std::exception& e) {
-      prices.push_back(std::make_pair(nan<double>(), e.what()));
+  prices.reserve(pricers.size());
+  if (deps)
+    deps->assign(pricers.size(), std::set<std::string>());
+  for (size_t i = 0; i < pricers.size(); ++i) {
+    // a trade failing in the base market fails in the same way when bumped
+    if (base && std::isnan((*base)[i].first)) {
+      prices.push_back((*base)[i]);
+      continue;
     }
+    INSTR_COUNT(instr::pricer_call);
+    if (deps)
+      mkt.begin_recording();
+    prices.push_back(price_trade(*pricers[i], mkt, fds.get()));
+    if (deps)
+      (*deps)[i] = mkt.end_recording();
   }
   return prices;
 }
 
+void compute_prices_batch(
+    const std::vector<ppricer_t>& pricers, Market* const* mkts, size_t n,
+    std::shared_ptr<const FixingDataServer> fds, portfolio_values_t* values) {
+  INSTR_SCOPE("compute_prices_batch");
+  MYASSERT(n <= max_price_lanes, "Too many lanes: " << n);
+  for (size_t k = 0; k < n; ++k)
+    values[k].resize(pricers.size());
+  Status status[max_price_lanes];
+  double price[max_price_lanes];
+  for (size_t i = 0; i < pricers.size(); ++i) {
+    INSTR_COUNT(instr::pricer_call);
+    bool thrown = false;
+    try {
+      pricers[i]->try_price_batch(mkts, n, fds.get(), status, price);
+    } catch (std::exception&) {
+      thrown = true;
+    }
+    for (size_t k = 0; k < n; ++k) {
+      if (thrown)
+        values[k][i] = price_trade(*pricers[i], *mkts[k], fds.get());
+      else if (status[k].ok())
+        values[k][i] = std::make_pair(price[k], "");
+      else
+        values[k][i] = std::make_pair(nan<double>(), status[k].message());
+    }
+  }
+}
+
 std::pair<double, std::vector<std::pair<size_t, std::string>>> portfolio_total(
     const portfolio_values_t& values) {
-  double total = 0.0;
+  ExactSum total;
   std::vector<std::pair<size_t, std::string>> errors;
   for (int i = 0; i < values.size(); ++i) {
     const auto& value = values[i];
@@ -82,14 +139,14 @@ std::pair<double, std::vector<std::pair<size_t, std::string>>> portfolio_total(
       total += value.first;
     }
   }
-  return std::make_pair(total, errors);
+  return std::make_pair(total.value(), errors);
 }
 
-std::vector<std::pair<string, portfolio_values_t>> compute_pv01(
+void compute_pv01(
     const std::vector<ppricer_t>& pricers, const Market& mkt,
-    std::shared_ptr<const FixingDataServer> fds) {
-    std::vector<std::pair<string, portfolio_values_t>> pv01;  // PV01 per trade
-
+    std::shared_ptr<const FixingDataServer> fds, RiskCube& cube,
+    const portfolio_values_t* base_pv) {
+    INSTR_SCOPE("compute_pv01");
     const double bump_size = 0.01 / 100;
 
     // filter risk factors related to IR
@@ -100,141 +157,61 @@ std::vector<std::pair<string, portfolio_values_t>> compute_pv01(
     Market tmpmkt(mkt);
 
     // compute prices for perturbated markets and aggregate results
-    pv01.reserve(base.size());
     for (const auto& d : base) {
         std::vector<std::pair<string, double>> bumped(1, d);
-        pv01.push_back(std::make_pair(
-              d.first, std::vector<trade_value_t>(pricers.size())));
 
         // bump down and price
         bumped[0].second = d.second - bump_size;
         tmpmkt.set_risk_factors(bumped);
-        auto pv_dn = compute_prices(pricers, tmpmkt, fds);
+        auto pv_dn = compute_prices(pricers, tmpmkt, fds, base_pv);
 
         // bump up and price
         bumped[0].second = d.second + bump_size; // bump up
         tmpmkt.set_risk_factors(bumped);
-        auto pv_up = compute_prices(pricers, tmpmkt, fds);
+        auto pv_up = compute_prices(pricers, tmpmkt, fds, base_pv);
 
         // compute estimator of the derivative via central finite differences
         double dr = 2.0 * bump_size;
-        std::transform(pv_up.begin(), pv_up.end(), pv_dn.begin(), pv01.back().second.begin()
-            , [dr](auto& hi, auto& lo) -> trade_value_t { return pv01_or_nan(hi, lo, dr); });
+        add_central_difference(cube, scenario_info_t{"PV01 " + d.first,
+            measure_t::pv01_parallel, {d.first}, bump_type_t::absolute,
+            bump_size}, pv_up, pv_dn, dr);
     }
-
-    return pv01;
 }
 
-std::vector<std::pair<std::string, portfolio_values_t>> compute_pv01_parallel(
+void compute_pv01_parallel(
     const std::vector<ppricer_t>& pricers, const Market& mkt,
-    std::shared_ptr<const FixingDataServer> fds) {
-  std::vector<std::pair<std::string, portfolio_values_t>> pv01;
-  const double bump_size = 0.01 / 100;
-  const double dr = 2.0 * bump_size;
-  auto risk_factors = mkt.get_risk_factors(
-      ir_rate_prefix + "([0-9]+(D|W|M|Y)\\.)?[A-Z]{3}");
-  std::vector<std::string> risk_ccys;
-  find_all_risk_ccy(risk_factors, &risk_ccys);
-  Market tmpmkt(mkt);
-
-  for (const auto& risk_ccy : risk_ccys) {
-    auto base = mkt.get_risk_factors(
-        ir_rate_prefix + "([0-9]+(D|W|M|Y)\\.)?" + risk_ccy);
-    std::vector<std::pair<std::string, double>> bumped_up(base);
-    std::vector<std::pair<std::string, double>> bumped_dn(base);
-    bump_risk_factors(bump_size, &bumped_up, &bumped_dn);
-    tmpmkt.set_risk_factors(bumped_up);
-    auto pv_up = compute_prices(pricers, tmpmkt, fds);
-    tmpmkt.set_risk_factors(bumped_dn);
-    auto pv_dn = compute_prices(pricers, tmpmkt, fds);
-    tmpmkt.set_risk_factors(base);
-
-    pv01.push_back(
-        std::make_pair(
-          "parallel " + ir_rate_prefix + risk_ccy, 
-          std::vector<trade_value_t>(pricers.size())));
-    std::transform(
-        pv_up.begin(), pv_up.end(), pv_dn.begin(), pv01.back().second.begin(),
-        [dr](auto& hi, auto& lo) -> 
-        trade_value_t { return pv01_or_nan(hi, lo, dr); });
-  }
-  return pv01;
+    std::shared_ptr<const FixingDataServer> fds, RiskCube& cube,
+    const portfolio_values_t* base_pv) {
+  INSTR_SCOPE("compute_pv01_parallel");
+  greek_config_t config;
+  config.classes.push_back(bump_config_t{risk_class_t::ir_parallel,
+      bump_type_t::absolute, 0.01 / 100, bump_scheme_t::central, false});
+  compute_greeks(pricers, mkt, fds, config, cube, base_pv);
 }
 
-std::vector<std::pair<std::string, portfolio_values_t>> compute_pv01_bucketed(
+void compute_pv01_bucketed(
     const std::vector<ppricer_t>& pricers, const Market& mkt,
-    std::shared_ptr<const FixingDataServer> fds) {
-  std::vector<std::pair<std::string, portfolio_values_t>> pv01;
-  const double bump_size = 0.01 / 100;
-  const double dr = 2.0 * bump_size;
-  std::set<std::string> buckets; 
-  Market tmpmkt(mkt);
-  auto base = mkt.get_risk_factors(
-      ir_rate_prefix + "[0-9]+(D|W|M|Y)\\.[A-Z]{3}");
-  for (auto& rf : base) {
-    auto original_value = rf.second;
-    const auto& bucket = rf.first;
-
-    rf.second = original_value + bump_size;
-    tmpmkt.set_risk_factors(base);
-    auto pv_up = compute_prices(pricers, tmpmkt, fds);
-
-    rf.second = original_value - bump_size;
-    tmpmkt.set_risk_factors(base);
-    auto pv_dn = compute_prices(pricers, tmpmkt, fds);
-
-    // Revert changes.
-    rf.second = original_value;
-
-    pv01.push_back(
-        std::make_pair(
-          "bucketed " + bucket, std::vector<trade_value_t>(pricers.size())));
-    std::transform(
-        pv_up.begin(), pv_up.end(), pv_dn.begin(), pv01.back().second.begin(),
-        [dr](auto& hi, auto& lo) -> 
-        trade_value_t { return pv01_or_nan(hi, lo, dr); });
-  }
-  return pv01;
+    std::shared_ptr<const FixingDataServer> fds, RiskCube& cube,
+    const portfolio_values_t* base_pv) {
+  INSTR_SCOPE("compute_pv01_bucketed");
+  greek_config_t config;
+  config.classes.push_back(bump_config_t{risk_class_t::ir_tenor,
+      bump_type_t::absolute, 0.01 / 100, bump_scheme_t::central, false});
+  compute_greeks(pricers, mkt, fds, config, cube, base_pv);
 }
 
-std::vector<std::pair<std::string, portfolio_values_t>> compute_fx_delta(
+void compute_fx_delta(
      const std::vector<ppricer_t>& pricers, const Market& mkt,
-     std::shared_ptr<const FixingDataServer> fds) {
-  std::vector<std::pair<std::string, portfolio_values_t>> fx_delta;
-  auto fx_spots = mkt.get_risk_factors(fx_spot_prefix + "[A-Z]{3}");
-  std::vector<std::string> risk_ccys;
-  find_all_risk_ccy(fx_spots, &risk_ccys);
-  Market tmpmkt(mkt);
-
-  for (const auto& risk_ccy : risk_ccys) {
-    auto risk_factors = mkt.get_risk_factors(fx_spot_prefix + risk_ccy);
-    MYASSERT(risk_factors.size() == 1, 
-        "Duplicate fx spot rate." << fx_spot_prefix + risk_ccy);
-    const double original_value = risk_factors[0].second;
-    double bump_size = original_value * 0.1 / 100;
-    double dr = 2 * bump_size;
-    risk_factors[0].second = original_value + bump_size;
-    tmpmkt.set_risk_factors(risk_factors);
-    auto pv_up = compute_prices(pricers, tmpmkt, fds);
-    risk_factors[0].second = original_value - bump_size;
-    tmpmkt.set_risk_factors(risk_factors);
-    auto pv_dn = compute_prices(pricers, tmpmkt, fds);
-    risk_factors[0].second = original_value;
-    tmpmkt.set_risk_factors(risk_factors);
-
-    fx_delta.push_back(
-        std::make_pair(fx_spot_prefix + risk_ccy,
-          std::vector<trade_value_t>(pricers.size())));
-
-    std::transform(
-        pv_up.begin(), pv_up.end(), pv_dn.begin(), 
-        fx_delta.back().second.begin(), [dr](auto& hi, auto& lo) ->
-        trade_value_t { return pv01_or_nan(hi, lo, dr); });
-  }
-  return fx_delta;
+     std::shared_ptr<const FixingDataServer> fds, RiskCube& cube,
+     const portfolio_values_t* base_pv) {
+  INSTR_SCOPE("compute_fx_delta");
+  greek_config_t config;
+  config.classes.push_back(bump_config_t{risk_class_t::fx_spot,
+      bump_type_t::relative, 0.1 / 100, bump_scheme_t::central, false});
+  compute_greeks(pricers, mkt, fds, config, cube, base_pv);
 }
 
-ptrade_t load_trade(my_ifstream& is) {
+ptrade_t load_trade(my_ifstream& is, const std::shared_ptr<Arena>& arena) {
   string name;
   ptrade_t p;
 
@@ -243,9 +220,9 @@ ptrade_t load_trade(my_ifstream& is) {
   is >> id;
 
   if (id == TradePayment::m_id)
-    p.reset(new TradePayment);
+    p = make_in_arena<TradePayment>(arena);
   else if (id == TradeFXForward::m_id)
-    p.reset(new TradeFXForward);
+    p = make_in_arena<TradeFXForward>(arena);
   else
     THROW("Unknown trade type:" << id);
 
@@ -256,6 +233,7 @@ ptrade_t load_trade(my_ifstream& is) {
 
 void save_portfolio(const string& filename, const std::vector<ptrade_t>& portfolio)
 {
+    INSTR_SCOPE("save_portfolio");
     // test saving to file
     my_ofstream of(filename);
     for( const auto& pt : portfolio) {
@@ -267,33 +245,82 @@ void save_portfolio(const string& filename, const std::vector<ptrade_t>& portfol
 
 std::vector<ptrade_t> load_portfolio(const string& filename)
 {
+    INSTR_SCOPE("load_portfolio");
     std::vector<ptrade_t> portfolio;
+    // all trades are released together
+    std::shared_ptr<Arena> arena = std::make_shared<Arena>();
 
     // test reloading the portfolio
     my_ifstream is(filename);
     while (is.read_line())
-        portfolio.push_back(load_trade(is));
+        portfolio.push_back(load_trade(is, arena));
+
+    return portfolio;
+}
+
+std::vector<ptrade_t> load_portfolio(
+    const string& filename, const std::vector<size_t>& indices)
+{
+    INSTR_SCOPE("load_portfolio");
+    std::vector<ptrade_t> portfolio;
+    portfolio.reserve(indices.size());
+    std::shared_ptr<Arena> arena = std::make_shared<Arena>();
+
+    my_ifstream is(filename);
+    size_t i = 0;
+    for (size_t next : indices) {
+        MYASSERT(next >= i, "Trade indices must be increasing");
+        for (; i <= next; ++i)
+            MYASSERT(is.read_line(), "Trade " << next << " not found in " << filename);
+        portfolio.push_back(load_trade(is, arena));
+    }
 
     return portfolio;
 }
 
+void load_portfolio_chunks(const string& filename, size_t chunk_size,
+    const std::function<void(size_t, portfolio_t&&)>& f)
+{
+    INSTR_SCOPE("load_portfolio_chunks");
+    MYASSERT(chunk_size > 0, "The chunk size must be positive");
+    std::shared_ptr<Arena> arena = std::make_shared<Arena>();
+    my_ifstream is(filename);
+    portfolio_t chunk;
+    size_t first = 0;
+    while (is.read_line()) {
+        chunk.push_back(load_trade(is, arena));
+        if (chunk.size() == chunk_size) {
+            f(first, std::move(chunk));
+            first += chunk_size;
+            chunk.clear();
+        }
+    }
+    if (!chunk.empty())
+        f(first, std::move(chunk));
+}
+
+void scan_portfolio(const string& filename,
+    const std::function<void(size_t, const ITrade&)>& f)
+{
+    my_ifstream is(filename);
+    for (size_t i = 0; is.read_line(); ++i)
+        f(i, *load_trade(is, nullptr));
+}
+
+void memory_report(const portfolio_t& portfolio,
+    const std::vector<ppricer_t>& pricers, memory_report_t& report) {
+  size_t bytes = heap_size(portfolio);
+  for (const auto& t : portfolio)
+    bytes += t->memory_size();
+  report.add("trades", bytes);
+  bytes = heap_size(pricers);
+  for (const auto& p : pricers)
+    bytes += p->memory_size();
+  report.add("pricers", bytes);
+}
+
 void print_price_vector(const string& name, const portfolio_values_t& values) {
-  const auto& res = portfolio_total(values);
-  std::cout
-      << "========================\n"
-      << name << ":\n"
-      << "========================\n"
-      << "Total:  " << res.first << "\n"
-      << "Errors: " << res.second.size() << "\n"
-      << "\n========================\n";
-
-  for (size_t i = 0, n = values.size(); i < n; ++i)
-    if (std::isnan(values[i].first)) 
-      std::cout << std::setw(5) << i << ": " << values[i].second << "\n";
-    else
-      std::cout << std::setw(5) << i << ": " << values[i].first << "\n";
-
-  std::cout << "========================\n\n";
+  ResultWriter("", result_format_t::text).write(name, values);
 }
 
 } // namespace minirisk
@@ -1,5 +1,8 @@
 #pragma once
 
+#include <functional>
+#include <set>
+#include <string>
 #include <vector>
 
 #include "ITrade.h"
@@ -9,40 +12,70 @@
 namespace minirisk {
 
 struct Market;
+struct RiskCube;
+struct memory_report_t;
 
 typedef std::pair<double, std::string> trade_value_t;
 typedef std::vector<trade_value_t> portfolio_values_t;
 
+// risk factors each trade depends on
+typedef std::vector<std::set<std::string>> trade_dependencies_t;
+
 // get pricer for each trade
 std::vector<ppricer_t> get_pricers(
     const portfolio_t& portfolio, const std::string& base_ccy);
 
+// union of the market data needed to price on today (see
+// IPricer::add_requirements), to be fetched with Market::prefetch
+market_requirements_t get_requirements(const std::vector<ppricer_t>& pricers,
+    const Date& today, const FixingDataServer *fds);
+
 // compute prices
+// if base prices are given, trades which failed to price in the base market
+// are not priced again and report the same error
+// if deps are given, they receive the risk factors read by each pricer,
+// directly or through curves (see Market::begin_recording)
 portfolio_values_t compute_prices(
     const std::vector<ppricer_t>& pricers, Market& mkt,
-    std::shared_ptr<const FixingDataServer> fds);
-
-// compute the cumulative book value
+    std::shared_ptr<const FixingDataServer> fds,
+    const portfolio_values_t* base = nullptr,
+    trade_dependencies_t* deps = nullptr);
+
+// compute prices on n <= max_price_lanes markets, e.g. the scenarios of a
+// batch: values[k] are the prices on mkts[k], as given by compute_prices.
+// Each pricer is called once for all the markets (see
+// IPricer::try_price_batch), and again on each market if that throws.
+void compute_prices_batch(
+    const std::vector<ppricer_t>& pricers, Market* const* mkts, size_t n,
+    std::shared_ptr<const FixingDataServer> fds, portfolio_values_t* values);
+
+// compute the cumulative book value, summed exactly (see ExactSum)
 std::pair<double, std::vector<std::pair<size_t, std::string>>> portfolio_total(
     const portfolio_values_t& values);
 
 // Compute PV01 (i.e. sensitivity with respect to interest rate dV/dr)
 // Use central differences, absolute bump of 0.01%, rescale result for rate movement of 0.01%
-std::vector<std::pair<string, portfolio_values_t>> compute_pv01(
+// The greeks append one row per risk factor (or currency) to the cube, and
+// optionally take the prices in the unbumped market (see compute_prices)
+void compute_pv01(
     const std::vector<ppricer_t>& pricers, const Market& mkt,
-    std::shared_ptr<const FixingDataServer> fds);
+    std::shared_ptr<const FixingDataServer> fds, RiskCube& cube,
+    const portfolio_values_t* base_pv = nullptr);
 
-std::vector<std::pair<std::string, portfolio_values_t>> compute_pv01_parallel(
+void compute_pv01_parallel(
     const std::vector<ppricer_t>& pricers, const Market& mkt,
-    std::shared_ptr<const FixingDataServer> fds);
+    std::shared_ptr<const FixingDataServer> fds, RiskCube& cube,
+    const portfolio_values_t* base_pv = nullptr);
 
-std::vector<std::pair<std::string, portfolio_values_t>> compute_pv01_bucketed(
+void compute_pv01_bucketed(
     const std::vector<ppricer_t>& pricers, const Market& mkt,
-    std::shared_ptr<const FixingDataServer> fds);
+    std::shared_ptr<const FixingDataServer> fds, RiskCube& cube,
+    const portfolio_values_t* base_pv = nullptr);
 
-std::vector<std::pair<std::string, portfolio_values_t>> compute_fx_delta(
+void compute_fx_delta(
     const std::vector<ppricer_t>& pricers, const Market& mkt,
-    std::shared_ptr<const FixingDataServer> fds);
+    std::shared_ptr<const FixingDataServer> fds, RiskCube& cube,
+    const portfolio_values_t* base_pv = nullptr);
 
 // save portfolio to file
 void save_portfolio(const string& filename, const std::vector<ptrade_t>& portfolio);
@@ -50,6 +83,24 @@ void save_portfolio(const string& filename, const std::vector<ptrade_t>& portfol
 // load portfolio from file
 std::vector<ptrade_t> load_portfolio(const string& filename);
 
+// load only the trades with the given indices, in increasing order
+std::vector<ptrade_t> load_portfolio(
+    const string& filename, const std::vector<size_t>& indices);
+
+// load a portfolio from file in chunks of at most chunk_size trades, calling
+// f(index of the first trade, trades) as soon as each chunk is read
+void load_portfolio_chunks(const string& filename, size_t chunk_size,
+    const std::function<void(size_t, portfolio_t&&)>& f);
+
+// call f(index, trade) for each trade of a portfolio file, without keeping
+// the trades in memory
+void scan_portfolio(const string& filename,
+    const std::function<void(size_t, const ITrade&)>& f);
+
+// adds the memory used by the trades and the pricers
+void memory_report(const portfolio_t& portfolio,
+    const std::vector<ppricer_t>& pricers, memory_report_t& report);
+
 // print portfolio to cout
 void print_portfolio(const portfolio_t& portfolio);
 
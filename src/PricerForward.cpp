@@ -2,8 +2,10 @@
 
 #include <cmath>
 
+#include "CurveDiscount.h"
 #include "Global.h"
 #include "Macros.h"
+#include "MemoryReport.h"
 
 namespace minirisk {
 
@@ -17,16 +19,41 @@ PricerForward::PricerForward(
       m_settle_date(trd.settle_date()),
       m_base_ccy(base_ccy) {}
 
-double PricerForward::price(Market& m, const FixingDataServer* fds) const {
+Status PricerForward::try_price(
+    Market& m, const FixingDataServer* fds, double& price) const {
   ptr_disc_curve_t df = m.get_discount_curve(ir_curve_discount_name(m_ccy2));
-  double disc_factor = df->df(m_settle_date);
+  double disc_factor;
+  Status status = df->try_df(m_settle_date, disc_factor);
+  if (!status.ok())
+    return status;
+  return try_price_discounted(m, fds, disc_factor, price);
+}
+
+void PricerForward::try_price_batch(Market* const* mkts, size_t n,
+    const FixingDataServer* fds, Status* status, double* price) const {
+  MYASSERT(n <= max_price_lanes, "Too many lanes: " << n);
+  const string curve = ir_curve_discount_name(m_ccy2);
+  ptr_disc_curve_t disc[max_price_lanes];
+  double disc_factor[max_price_lanes];
+  for (size_t k = 0; k < n; ++k)
+    disc[k] = mkts[k]->get_discount_curve(curve);
+  try_df_batch(disc, n, m_settle_date, status, disc_factor);
+  for (size_t k = 0; k < n; ++k)
+    if (status[k].ok())
+      status[k] = try_price_discounted(*mkts[k], fds, disc_factor[k], price[k]);
+}
 
+Status PricerForward::try_price_discounted(Market& m,
+    const FixingDataServer* fds, double disc_factor, double& price) const {
+  Status status;
   double fwd_rate = nan<double>();
   if (fds && m.today() >= m_fixing_date) {
     const auto& fixing_name = fx_spot_name(m_ccy1, m_ccy2);
     if (m.today() > m_fixing_date) {
       // Must contain fixing, otherwise price failure.
-      fwd_rate = fds->get(fixing_name, m_fixing_date);
+      status = fds->try_get(fixing_name, m_fixing_date, fwd_rate);
+      if (!status.ok())
+        return status;
     } else {
       // Might contain fixing.
       const auto& res = fds->lookup(fixing_name, m_fixing_date);
@@ -37,15 +64,51 @@ double PricerForward::price(Market& m, const FixingDataServer* fds) const {
   if (std::isnan(fwd_rate)) {
     // Try to resolve price from forward curve.
     ptr_fx_fwd_curve_t fwd = m.get_fx_fwd_curve(fx_fwd_name(m_ccy1, m_ccy2));
-    fwd_rate = fwd->fwd(m_fixing_date);
+    status = fwd->try_fwd(m_fixing_date, fwd_rate);
+    if (!status.ok())
+      return status;
+  }
+  const string& ccy1 = m_ccy1;
+  const string& ccy2 = m_ccy2;
+  const Date& fixing_date = m_fixing_date;
+  const Date& settle_date = m_settle_date;
+  if (std::isnan(fwd_rate))
+    RETURN_ERROR(status_code_t::missing_data, "FX forward or fixing not available "
+        << ccy1 << ccy2 << " for " << fixing_date.to_string());
+  if (std::isnan(disc_factor))
+    RETURN_ERROR(status_code_t::missing_data, "Disc factor not available "
+        << ccy1 << ccy2 << " for " << settle_date.to_string());
+  double fx_spot;
+  status = m.try_get_fx_spot(m_ccy2, m_base_ccy, fx_spot);
+  if (status.ok())
+    price = m_amt * disc_factor * (fwd_rate - m_strike) * fx_spot;
+  return status;
+}
+
+void PricerForward::add_requirements(const Date& today,
+    const FixingDataServer* fds, market_requirements_t& req) const {
+  // same steps as try_price
+  req.discount_curves.insert(ir_curve_discount_name(m_ccy2));
+  if (m_settle_date < today)
+    return;
+  bool fixed = false;
+  if (fds && today >= m_fixing_date) {
+    const auto& fixing_name = fx_spot_name(m_ccy1, m_ccy2);
+    fixed = fds->lookup(fixing_name, m_fixing_date).second;
+    if (today > m_fixing_date) {
+      req.fixings.insert(std::make_pair(fixing_name, m_fixing_date));
+      if (!fixed)
+        return;
+    }
   }
-  MYASSERT(!std::isnan(fwd_rate), "FX forward or fixing not available " 
-      << m_ccy1 << m_ccy2 << " for " << m_fixing_date.to_string());
-  MYASSERT(!std::isnan(disc_factor), "Disc factor not available " 
-      << m_ccy1 << m_ccy2 << " for " << m_settle_date.to_string());
-  double fx_spot = 
-    m.get_fx_spot(fx_spot_name(m_ccy2, m_base_ccy));
-  return m_amt * disc_factor * (fwd_rate - m_strike) * fx_spot;
+  if (!fixed)
+    req.fx_fwd_curves.insert(fx_fwd_name(m_ccy1, m_ccy2));
+  req.fx_spots.insert(fx_spot_name(m_ccy2, m_base_ccy));
+}
+
+size_t PricerForward::memory_size() const {
+  return sizeof(*this) + heap_size(m_ccy1) + heap_size(m_ccy2)
+    + heap_size(m_base_ccy);
 }
 
 } // namespace minirisk
@@ -7,8 +7,18 @@ namespace minirisk {
 
 struct PricerForward : IPricer {
   PricerForward(const TradeFXForward& trd, const std::string& base_ccy);
-  virtual double price(Market& m, const FixingDataServer* fds) const;
+  virtual Status try_price(
+      Market& m, const FixingDataServer* fds, double& price) const;
+  virtual void try_price_batch(Market* const* mkts, size_t n,
+      const FixingDataServer* fds, Status* status, double* price) const;
+  virtual void add_requirements(const Date& today,
+      const FixingDataServer* fds, market_requirements_t& req) const;
+  virtual size_t memory_size() const;
  private:
+  // the price given the discount factor to the settlement date
+  Status try_price_discounted(Market& m, const FixingDataServer* fds,
+      double disc_factor, double& price) const;
+
   double m_amt;
   double m_strike;
   std::string m_ccy1;
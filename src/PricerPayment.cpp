@@ -1,6 +1,7 @@
 #include "PricerPayment.h"
 #include "TradePayment.h"
 #include "CurveDiscount.h"
+#include "MemoryReport.h"
 
 namespace minirisk {
 
@@ -11,13 +12,44 @@ PricerPayment::PricerPayment(
     , m_ir_curve(ir_curve_discount_name(trd.ccy()))
     , m_fx_ccy(fx_spot_name(trd.ccy(), base_ccy)) {}
 
-double PricerPayment::price(Market& mkt, const FixingDataServer* fds) const {
+Status PricerPayment::try_price(
+    Market& mkt, const FixingDataServer* fds, double& price) const {
   ptr_disc_curve_t disc = mkt.get_discount_curve(m_ir_curve);
-  double df = disc->df(m_dt); // this throws an exception if m_dt<today
+  double df, fx_spot;
+  Status status = disc->try_df(m_dt, df); // this fails if m_dt<today
+  if (status.ok())
+    status = mkt.try_get_fx_spot(m_fx_ccy, fx_spot);
+  if (status.ok())
+    price = m_amt * df * fx_spot;
+  return status;
+}
+
+void PricerPayment::try_price_batch(Market* const* mkts, size_t n,
+    const FixingDataServer* fds, Status* status, double* price) const {
+  MYASSERT(n <= max_price_lanes, "Too many lanes: " << n);
+  ptr_disc_curve_t disc[max_price_lanes];
+  double df[max_price_lanes];
+  for (size_t k = 0; k < n; ++k)
+    disc[k] = mkts[k]->get_discount_curve(m_ir_curve);
+  try_df_batch(disc, n, m_dt, status, df);
+  for (size_t k = 0; k < n; ++k) {
+    double fx_spot;
+    if (status[k].ok())
+      status[k] = mkts[k]->try_get_fx_spot(m_fx_ccy, fx_spot);
+    if (status[k].ok())
+      price[k] = m_amt * df[k] * fx_spot;
+  }
+}
 
-  const auto fx_spot = mkt.get_fx_spot(m_fx_ccy); 
+void PricerPayment::add_requirements(const Date& today,
+    const FixingDataServer* fds, market_requirements_t& req) const {
+  req.discount_curves.insert(m_ir_curve);
+  if (!(m_dt < today))
+    req.fx_spots.insert(m_fx_ccy);
+}
 
-  return m_amt * df * fx_spot;
+size_t PricerPayment::memory_size() const {
+  return sizeof(*this) + heap_size(m_ir_curve) + heap_size(m_fx_ccy);
 }
 
 } // namespace minirisk
@@ -9,7 +9,15 @@ struct PricerPayment : IPricer
 {
     PricerPayment(const TradePayment& trd, const std::string& base_ccy);
 
-    virtual double price(Market& m, const FixingDataServer* fds) const;
+    virtual Status try_price(Market& m, const FixingDataServer* fds, double& price) const;
+
+    virtual void try_price_batch(Market* const* mkts, size_t n,
+        const FixingDataServer* fds, Status* status, double* price) const;
+
+    virtual void add_requirements(const Date& today,
+        const FixingDataServer* fds, market_requirements_t& req) const;
+
+    virtual size_t memory_size() const;
 
 private:
     double m_amt;
@@ -0,0 +1,210 @@
+#include "PricingProtocol.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Macros.h"
+#include "ResultWriter.h"
+
+namespace minirisk {
+namespace {
+const char message_magic[4] = {'M', 'R', 'P', 'C'};
+
+struct message_header_t {
+  char magic[4];
+  uint32_t type;
+  uint64_t length;
+};
+
+// read exactly n bytes, returns the number of bytes read before the end of
+// the stream
+size_t read_all(int fd, char *buf, size_t n) {
+  size_t done = 0;
+  while (done < n) {
+    ssize_t r = ::read(fd, buf + done, n - done);
+    if (r < 0 && errno == EINTR)
+      continue;
+    MYASSERT(r >= 0, "Read failed: " << std::strerror(errno));
+    if (r == 0)
+      break;
+    done += r;
+  }
+  return done;
+}
+
+template <typename T>
+void put(std::string& s, const T& v) {
+  s.append(reinterpret_cast<const char *>(&v), sizeof(T));
+}
+
+template <typename T>
+T get(const std::string& s, size_t& pos) {
+  T v;
+  MYASSERT(pos + sizeof(T) <= s.size(), "Truncated request");
+  std::memcpy(&v, s.data() + pos, sizeof(T));
+  pos += sizeof(T);
+  return v;
+}
+
+void check_header(const message_header_t& h) {
+  MYASSERT(std::memcmp(h.magic, message_magic, sizeof(h.magic)) == 0,
+      "Invalid message header");
+  MYASSERT(h.length <= max_message_length,
+      "Message too long: " << h.length << " bytes");
+}
+} // namespace
+
+request_type_t parse_request_type(const std::string& s) {
+  if (s == "pv")
+    return request_type_t::pv;
+  if (s == "pv01_bucketed")
+    return request_type_t::pv01_bucketed;
+  if (s == "pv01_parallel")
+    return request_type_t::pv01_parallel;
+  if (s == "fx_delta")
+    return request_type_t::fx_delta;
+  if (s == "what_if")
+    return request_type_t::what_if;
+  if (s == "shutdown")
+    return request_type_t::shutdown;
+  if (s == "reload")
+    return request_type_t::reload;
+  THROW("Unknown request type: " << s);
+}
+
+std::string encode_request(const pricing_request_t& req) {
+  std::string s;
+  put(s, static_cast<uint32_t>(req.trades.size()));
+  for (uint32_t t : req.trades)
+    put(s, t);
+  put(s, static_cast<uint32_t>(req.overrides.size()));
+  for (const auto& o : req.overrides) {
+    put(s, static_cast<uint32_t>(o.first.size()));
+    s += o.first;
+    put(s, o.second);
+  }
+  return s;
+}
+
+pricing_request_t decode_request(uint32_t type, const std::string& payload) {
+  MYASSERT(type >= static_cast<uint32_t>(request_type_t::pv)
+      && type <= static_cast<uint32_t>(request_type_t::reload),
+      "Unknown request type " << type);
+  pricing_request_t req;
+  req.type = static_cast<request_type_t>(type);
+  size_t pos = 0;
+  // counts are checked against the payload before allocating
+  uint32_t n_trades = get<uint32_t>(payload, pos);
+  MYASSERT(n_trades <= (payload.size() - pos) / sizeof(uint32_t),
+      "Truncated request");
+  req.trades.resize(n_trades);
+  for (auto& t : req.trades)
+    t = get<uint32_t>(payload, pos);
+  uint32_t n = get<uint32_t>(payload, pos);
+  MYASSERT(n <= (payload.size() - pos) / (sizeof(uint32_t) + sizeof(double)),
+      "Truncated request");
+  for (uint32_t i = 0; i < n; ++i) {
+    uint32_t len = get<uint32_t>(payload, pos);
+    MYASSERT(pos + len <= payload.size(), "Truncated request");
+    std::string name = payload.substr(pos, len);
+    pos += len;
+    req.overrides.push_back(std::make_pair(name, get<double>(payload, pos)));
+  }
+  return req;
+}
+
+std::string encode_message(uint32_t type, const std::string& payload) {
+  message_header_t h;
+  std::memcpy(h.magic, message_magic, sizeof(h.magic));
+  h.type = type;
+  h.length = payload.size();
+  std::string msg(reinterpret_cast<const char *>(&h), sizeof(h));
+  return msg + payload;
+}
+
+void send_message(int fd, uint32_t type, const std::string& payload) {
+  const std::string msg = encode_message(type, payload);
+  size_t done = 0;
+  while (done < msg.size()) {
+    ssize_t w = ::send(fd, msg.data() + done, msg.size() - done, MSG_NOSIGNAL);
+    if (w < 0 && errno == EINTR)
+      continue;
+    MYASSERT(w > 0, "Send failed: " << std::strerror(errno));
+    done += w;
+  }
+}
+
+bool receive_message(int fd, uint32_t& type, std::string& payload) {
+  message_header_t h;
+  size_t n = read_all(fd, reinterpret_cast<char *>(&h), sizeof(h));
+  if (n == 0)
+    return false;
+  MYASSERT(n == sizeof(h), "Invalid message header");
+  check_header(h);
+  type = h.type;
+  payload.resize(h.length);
+  MYASSERT(read_all(fd, &payload[0], h.length) == h.length,
+      "Connection closed in the middle of a message");
+  return true;
+}
+
+bool has_message(const std::string& buffer) {
+  message_header_t h;
+  if (buffer.size() < sizeof(h))
+    return false;
+  std::memcpy(&h, buffer.data(), sizeof(h));
+  check_header(h);
+  return buffer.size() - sizeof(h) >= h.length;
+}
+
+bool take_message(std::string& buffer, uint32_t& type, std::string& payload) {
+  if (!has_message(buffer))
+    return false;
+  message_header_t h;
+  std::memcpy(&h, buffer.data(), sizeof(h));
+  type = h.type;
+  payload.assign(buffer, sizeof(h), h.length);
+  buffer.erase(0, sizeof(h) + h.length);
+  return true;
+}
+
+int connect_to_server(const std::string& socket_path) {
+  sockaddr_un addr;
+  MYASSERT(socket_path.size() < sizeof(addr.sun_path),
+      "Socket path too long: " << socket_path);
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::strcpy(addr.sun_path, socket_path.c_str());
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  MYASSERT(fd >= 0, "Cannot create socket: " << std::strerror(errno));
+  if (::connect(fd, reinterpret_cast<sockaddr *>(&addr), sizeof(addr)) != 0) {
+    int err = errno;
+    ::close(fd);
+    THROW("Cannot connect to " << socket_path << ": " << std::strerror(err));
+  }
+  return fd;
+}
+
+std::vector<std::pair<std::string, portfolio_values_t>> send_request(
+    int fd, const pricing_request_t& req) {
+  send_message(fd, static_cast<uint32_t>(req.type), encode_request(req));
+  uint32_t status;
+  std::string payload;
+  MYASSERT(receive_message(fd, status, payload),
+      "Connection closed by the server");
+  MYASSERT(status == static_cast<uint32_t>(response_status_t::ok),
+      "Server error: " << payload);
+  if (payload.empty())
+    return {};
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> f(
+      ::fmemopen(&payload[0], payload.size(), "rb"), &std::fclose);
+  MYASSERT(f, "Cannot read the response");
+  return read_binary_results(f.get(), "response");
+}
+
+} // namespace minirisk
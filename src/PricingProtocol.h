@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Market.h"
+#include "PortfolioUtils.h"
+
+namespace minirisk {
+
+// Binary protocol of the pricing server, over a Unix domain socket.
+//
+// Each message is a header (4 characters "MRPC", uint32 type or status,
+// uint64 payload length) followed by the payload, in native endianness.
+// A connection can carry any number of request/response pairs.
+//
+// Request payload:
+//   uint32 number of trades T, T times uint32 trade index (T = 0 for all)
+//   uint32 number of overrides O, O times (uint32 name length, name
+//   characters, double value), only for what-if requests
+// Response payload: for status ok, results in the binary layout of
+// ResultWriter (one vector per scenario), otherwise the error message.
+
+enum class request_type_t : uint32_t {
+  pv = 1,
+  pv01_bucketed,
+  pv01_parallel,
+  fx_delta,
+  what_if,   // PV with some risk factors overridden
+  shutdown,
+  reload     // reload the market data and fixings, see MarketDataSource
+};
+
+enum class response_status_t : uint32_t { ok = 0, error };
+
+// parse "pv", "pv01_bucketed", "pv01_parallel", "fx_delta", "what_if",
+// "shutdown" or "reload"
+request_type_t parse_request_type(const std::string& s);
+
+struct pricing_request_t {
+  request_type_t type;
+  std::vector<uint32_t> trades;          // empty means all trades
+  Market::vec_risk_factor_t overrides;   // what-if only
+};
+
+std::string encode_request(const pricing_request_t& req);
+pricing_request_t decode_request(uint32_t type, const std::string& payload);
+
+// a message as sent, header and payload
+std::string encode_message(uint32_t type, const std::string& payload);
+
+// send a message, throws on failure
+void send_message(int fd, uint32_t type, const std::string& payload);
+
+// largest payload accepted, longer messages are rejected before allocating
+const uint64_t max_message_length = uint64_t(1) << 30;
+
+// receive a message, returns false if the peer closed the connection
+// before the start of the message, throws on other failures
+bool receive_message(int fd, uint32_t& type, std::string& payload);
+
+// whether the bytes received so far start with a complete message, throws
+// on an invalid header
+bool has_message(const std::string& buffer);
+
+// Takes the first message out of the bytes received so far, returns false
+// if it is not complete yet. Throws on an invalid header.
+bool take_message(std::string& buffer, uint32_t& type, std::string& payload);
+
+// open a connection to the server listening on socket_path
+int connect_to_server(const std::string& socket_path);
+
+// Client side: send a request and wait for the results. Errors reported by
+// the server are thrown.
+std::vector<std::pair<std::string, portfolio_values_t>> send_request(
+    int fd, const pricing_request_t& req);
+
+} // namespace minirisk
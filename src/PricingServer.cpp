@@ -0,0 +1,324 @@
+#include "PricingServer.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <map>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "Instrumentation.h"
+#include "Macros.h"
+#include "ResultWriter.h"
+
+namespace minirisk {
+namespace {
+// how long the responses still unsent at shutdown are waited for
+const int shutdown_timeout_ms = 1000;
+
+// a connection: the bytes received not decoded yet, and the responses not
+// sent yet
+struct client_t {
+  std::string received;
+  std::string output;
+  size_t n_sent = 0;
+  bool closing = false;  // closed once the output is sent
+
+  bool has_output() const { return n_sent < output.size(); }
+
+  void add_output(response_status_t status, const std::string& payload) {
+    output.erase(0, n_sent);
+    n_sent = 0;
+    output += encode_message(static_cast<uint32_t>(status), payload);
+  }
+
+  // sends what the socket takes without blocking, false on error
+  bool send_output(int fd) {
+    while (has_output()) {
+      ssize_t w = ::send(fd, output.data() + n_sent, output.size() - n_sent,
+          MSG_NOSIGNAL);
+      if (w < 0 && errno == EINTR)
+        continue;
+      if (w < 0)
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+      n_sent += w;
+    }
+    return true;
+  }
+};
+} // namespace
+
+PricingServer::PricingServer(const portfolio_t& portfolio,
+    const std::string& base_ccy, std::shared_ptr<MarketDataSource> source,
+    const Date& today)
+  : m_pricers(get_pricers(portfolio, base_ccy))
+  , m_source(source)
+  , m_today(today)
+  , m_version(0)
+  , m_n_computed(0) {
+  load_market();
+}
+
+PricingServer::PricingServer(const portfolio_t& portfolio,
+    const std::string& base_ccy, std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds, const Date& today)
+  : PricingServer(portfolio, base_ccy,
+      std::make_shared<MarketDataSource>(mds, fds), today) {
+}
+
+void PricingServer::load_market() {
+  // the market keeps this version of the data, whatever the later reloads
+  auto data = m_source->current();
+  m_version = data->version;
+  m_fds = data->fds;
+  m_mkt.reset(new Market(data->mds, m_today));
+  m_results.clear();
+  // fetch all data at once, then price once to build all curves
+  for (const auto& m : m_mkt->prefetch(
+        get_requirements(m_pricers, m_today, m_fds.get()), m_fds.get()))
+    std::cerr << "Missing market data: " << m << "\n";
+  compute(pricing_request_t{request_type_t::pv, {}, {}});
+  m_prices = m_results[request_type_t::pv]->values(0);
+}
+
+std::shared_ptr<const RiskCube> PricingServer::compute(
+    const pricing_request_t& req) {
+  INSTR_SCOPE("PricingServer::compute");
+  if (req.type != request_type_t::what_if) {
+    auto iter = m_results.find(req.type);
+    if (iter != m_results.end())
+      return iter->second;
+  }
+
+  ++m_n_computed;
+  std::shared_ptr<RiskCube> cube(new RiskCube(m_pricers.size()));
+  switch (req.type) {
+    case request_type_t::pv:
+      cube->add_scenario(scenario_info_t{"PV", measure_t::pv, {},
+          bump_type_t::none, 0.0}, compute_prices(m_pricers, *m_mkt, m_fds));
+      break;
+    case request_type_t::pv01_bucketed:
+      compute_pv01_bucketed(m_pricers, *m_mkt, m_fds, *cube, &m_prices);
+      break;
+    case request_type_t::pv01_parallel:
+      compute_pv01_parallel(m_pricers, *m_mkt, m_fds, *cube, &m_prices);
+      break;
+    case request_type_t::fx_delta:
+      compute_fx_delta(m_pricers, *m_mkt, m_fds, *cube, &m_prices);
+      break;
+    case request_type_t::what_if: {
+      Market tmpmkt(*m_mkt);
+      tmpmkt.set_risk_factors(req.overrides);
+      cube->add_scenario(scenario_info_t{"PV what-if", measure_t::pv, {},
+          bump_type_t::none, 0.0}, compute_prices(m_pricers, tmpmkt, m_fds));
+      return cube;
+    }
+    case request_type_t::shutdown:
+    case request_type_t::reload:
+      return cube;
+  }
+  m_results[req.type] = cube;
+  return cube;
+}
+
+std::string PricingServer::encode_results(
+    const RiskCube& cube, const std::vector<uint32_t>& trades) const {
+  char *buf = nullptr;
+  size_t size = 0;
+  std::FILE *f = ::open_memstream(&buf, &size);
+  MYASSERT(f, "Cannot create memory stream");
+  {
+    ResultWriter out(f, result_format_t::binary);
+    if (trades.empty()) {
+      for (size_t s = 0; s < cube.n_scenarios(); ++s)
+        out.write(cube, s);
+    } else {
+      for (size_t s = 0; s < cube.n_scenarios(); ++s) {
+        portfolio_values_t values;
+        values.reserve(trades.size());
+        const double *row = cube.row(s);
+        for (uint32_t t : trades) {
+          const std::string *err = cube.error(s, t);
+          values.push_back(std::make_pair(row[t], err ? *err : ""));
+        }
+        out.write(cube.scenario(s).name, values);
+      }
+    }
+  }
+  std::fclose(f);
+  std::string res(buf, size);
+  std::free(buf);
+  return res;
+}
+
+std::vector<std::pair<response_status_t, std::string>> PricingServer::process(
+    const std::vector<pricing_request_t>& requests) {
+  // what-if requests are shared by their (encoded) overrides
+  std::map<std::string, std::shared_ptr<const RiskCube>> what_if;
+  std::vector<std::pair<response_status_t, std::string>> responses;
+  for (const auto& req : requests) {
+    try {
+      for (uint32_t t : req.trades)
+        MYASSERT(t < m_pricers.size(), "Invalid trade index " << t);
+      if (req.type == request_type_t::shutdown) {
+        responses.push_back(std::make_pair(response_status_t::ok, ""));
+        continue;
+      }
+      if (req.type == request_type_t::reload) {
+        // the requests after this one in the batch see the new market
+        m_source->reload();
+        load_market();
+        what_if.clear();
+        responses.push_back(std::make_pair(response_status_t::ok, ""));
+        continue;
+      }
+      std::shared_ptr<const RiskCube> cube;
+      if (req.type == request_type_t::what_if) {
+        auto& shared = what_if[
+          encode_request(pricing_request_t{req.type, {}, req.overrides})];
+        if (!shared)
+          shared = compute(req);
+        cube = shared;
+      } else {
+        cube = compute(req);
+      }
+      responses.push_back(std::make_pair(
+            response_status_t::ok, encode_results(*cube, req.trades)));
+    } catch (const std::exception& e) {
+      responses.push_back(std::make_pair(response_status_t::error, e.what()));
+    }
+  }
+  return responses;
+}
+
+void PricingServer::serve(const std::string& socket_path) {
+  sockaddr_un addr;
+  MYASSERT(socket_path.size() < sizeof(addr.sun_path),
+      "Socket path too long: " << socket_path);
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::strcpy(addr.sun_path, socket_path.c_str());
+  int listen_fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  MYASSERT(listen_fd >= 0, "Cannot create socket: " << std::strerror(errno));
+  ::unlink(socket_path.c_str());
+  MYASSERT(::bind(listen_fd, reinterpret_cast<sockaddr *>(&addr),
+        sizeof(addr)) == 0 && ::listen(listen_fd, 64) == 0,
+      "Cannot listen on " << socket_path << ": " << std::strerror(errno));
+
+  // Client sockets are non-blocking. A request is only decoded once it is
+  // complete, and a response is sent as the client reads it, so that a slow
+  // client does not hold the others. A client gets no new request answered
+  // until it has read the previous response.
+  std::map<int, client_t> clients;
+  bool running = true;
+  bool pending = false;
+  std::vector<pollfd> fds;
+  while (true) {
+    fds.clear();
+    if (running)
+      fds.push_back(pollfd{listen_fd, POLLIN, 0});
+    bool unsent = false;
+    for (const auto& c : clients) {
+      short events = 0;
+      if (c.second.has_output()) {
+        events = POLLOUT;
+        unsent = true;
+      } else if (running && !c.second.closing) {
+        events = POLLIN;
+      }
+      fds.push_back(pollfd{c.first, events, 0});
+    }
+    // after a shutdown, only until the responses are sent
+    if (!running && !unsent)
+      break;
+    // without waiting if some client has a complete request left
+    int n = ::poll(fds.data(), fds.size(),
+        pending ? 0 : running ? -1 : shutdown_timeout_ms);
+    if (n < 0) {
+      MYASSERT(errno == EINTR, "Poll failed: " << std::strerror(errno));
+      continue;
+    }
+    if (n == 0 && !running)
+      break;
+
+    // collect one request from every client which sent one, so that
+    // concurrent requests are answered as one batch
+    std::vector<int> requesters;
+    std::vector<pricing_request_t> requests;
+    pending = false;
+    for (const auto& p : fds) {
+      if (p.fd == listen_fd)
+        continue;
+      client_t& c = clients[p.fd];
+      bool closed = false;
+      if (p.events & POLLOUT) {
+        if (p.revents)
+          closed = !c.send_output(p.fd);
+      } else if (p.revents) {
+        char chunk[65536];
+        ssize_t r = ::read(p.fd, chunk, sizeof(chunk));
+        if (r > 0)
+          c.received.append(chunk, r);
+        else if (r == 0 || (errno != EINTR && errno != EAGAIN))
+          closed = true;
+      }
+      if (!closed && running && !c.closing && !c.has_output()) {
+        try {
+          uint32_t type;
+          std::string payload;
+          if (take_message(c.received, type, payload)) {
+            requests.push_back(decode_request(type, payload));
+            requesters.push_back(p.fd);
+            pending |= has_message(c.received);
+          }
+        } catch (const std::exception& e) {
+          // the request taken before an invalid header is dropped too, the
+          // client is told why before it is closed
+          std::cerr << e.what() << "\n";
+          if (!requesters.empty() && requesters.back() == p.fd) {
+            requesters.pop_back();
+            requests.pop_back();
+          }
+          c.add_output(response_status_t::error, e.what());
+          c.received.clear();
+          c.closing = true;
+        }
+      }
+      if (closed || (c.closing && !c.has_output())) {
+        if (!c.received.empty())
+          std::cerr << "Connection closed in the middle of a message\n";
+        clients.erase(p.fd);
+        ::close(p.fd);
+      }
+    }
+    if (running && (fds[0].revents & POLLIN)) {
+      int fd = ::accept(listen_fd, nullptr, nullptr);
+      if (fd >= 0) {
+        if (::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK) == 0)
+          clients[fd];
+        else
+          ::close(fd);
+      }
+    }
+
+    auto responses = process(requests);
+    for (size_t r = 0; r < responses.size(); ++r) {
+      clients[requesters[r]].add_output(
+          responses[r].first, responses[r].second);
+      if (requests[r].type == request_type_t::shutdown)
+        running = false;
+    }
+  }
+
+  for (const auto& c : clients)
+    ::close(c.first);
+  ::close(listen_fd);
+  ::unlink(socket_path.c_str());
+}
+
+} // namespace minirisk
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "FixingDataServer.h"
+#include "Market.h"
+#include "MarketDataServer.h"
+#include "MarketDataSource.h"
+#include "PricingProtocol.h"
+#include "RiskCube.h"
+
+namespace minirisk {
+
+// Resident pricing server: the portfolio, the pricers and the market (with
+// its curves) are built once at startup, and the results in the base market
+// are computed on first request and then kept. A reload request replaces the
+// market with the current version of the market data source, and drops the
+// results. See PricingProtocol.h for the wire format.
+struct PricingServer {
+ public:
+  PricingServer(const portfolio_t& portfolio, const std::string& base_ccy,
+      std::shared_ptr<MarketDataSource> source, const Date& today);
+
+  // fixed market data, reload requests fail
+  PricingServer(const portfolio_t& portfolio, const std::string& base_ccy,
+      std::shared_ptr<const MarketDataServer> mds,
+      std::shared_ptr<const FixingDataServer> fds, const Date& today);
+
+  // serve requests on a Unix domain socket until a shutdown request
+  void serve(const std::string& socket_path);
+
+  // Answer a batch of requests. Requests for the same measure in the same
+  // market (the base market, or the same set of what-if overrides) are
+  // computed once. Returns the status and payload of each response.
+  std::vector<std::pair<response_status_t, std::string>> process(
+      const std::vector<pricing_request_t>& requests);
+
+  // number of revaluations of the whole portfolio performed so far
+  size_t n_computed() const { return m_n_computed; }
+
+  // version of the market data in use
+  uint64_t market_version() const { return m_version; }
+
+ private:
+  // builds the market from the current market data and prices the PV
+  void load_market();
+
+  // results of a request, ignoring the trade selection
+  std::shared_ptr<const RiskCube> compute(const pricing_request_t& req);
+
+  // results restricted to the selected trades, in binary layout
+  std::string encode_results(
+      const RiskCube& cube, const std::vector<uint32_t>& trades) const;
+
+  std::vector<ppricer_t> m_pricers;
+  std::shared_ptr<MarketDataSource> m_source;
+  Date m_today;
+  uint64_t m_version;
+  std::shared_ptr<const FixingDataServer> m_fds;
+  std::unique_ptr<Market> m_mkt;
+  portfolio_values_t m_prices;
+  std::map<request_type_t, std::shared_ptr<const RiskCube>> m_results;
+  size_t m_n_computed;
+};
+
+} // namespace minirisk
@@ -0,0 +1,91 @@
+#include "Reduction.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+
+#include "ThreadPool.h"
+
+namespace minirisk {
+namespace {
+// values summed by each task of sum_valid
+const size_t block_size = 1 << 14;
+
+ExactSum sum_block(const double *v, size_t n) {
+  ExactSum res;
+  for (size_t i = 0; i < n; ++i)
+    if (!std::isnan(v[i]))
+      res.add(v[i]);
+  return res;
+}
+} // namespace
+
+void ExactSum::add(double x) {
+  if (!std::isfinite(x)) {
+    m_special += x;
+    return;
+  }
+  // two-sum of x with each partial, keeping the non zero round-off errors
+  size_t n = 0;
+  for (double y : m_partials) {
+    if (std::fabs(x) < std::fabs(y))
+      std::swap(x, y);
+    double hi = x + y;
+    double lo = y - (hi - x);
+    if (lo != 0.0)
+      m_partials[n++] = lo;
+    x = hi;
+  }
+  m_partials.resize(n);
+  m_partials.push_back(x);
+}
+
+void ExactSum::add(const ExactSum& other) {
+  for (double x : other.m_partials)
+    add(x);
+  m_special += other.m_special;
+}
+
+double ExactSum::value() const {
+  if (m_special != 0.0 || std::isnan(m_special))
+    return m_special;
+  size_t n = m_partials.size();
+  if (n == 0)
+    return 0.0;
+  // add from the largest partial until the sum becomes inexact
+  double hi = m_partials[--n];
+  double lo = 0.0;
+  while (n > 0) {
+    double x = hi;
+    double y = m_partials[--n];
+    hi = x + y;
+    lo = y - (hi - x);
+    if (lo != 0.0)
+      break;
+  }
+  // round half to even correctly when the rest has the sign of the error
+  if (n > 0 && ((lo < 0.0 && m_partials[n - 1] < 0.0)
+      || (lo > 0.0 && m_partials[n - 1] > 0.0))) {
+    double y = lo * 2.0;
+    double x = hi + y;
+    if (y == x - hi)
+      hi = x;
+  }
+  return hi;
+}
+
+double sum_valid(const double *v, size_t n, ThreadPool *pool) {
+  if (!pool || n <= block_size)
+    return sum_block(v, n).value();
+  std::vector<std::future<ExactSum>> blocks;
+  for (size_t i = 0; i < n; i += block_size) {
+    const size_t m = std::min(block_size, n - i);
+    blocks.push_back(pool->async([v, i, m] { return sum_block(v + i, m); }));
+  }
+  ExactSum res;
+  for (auto& b : blocks)
+    res.add(b.get());
+  return res.value();
+}
+
+} // namespace minirisk
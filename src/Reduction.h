@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace minirisk {
+
+struct ThreadPool;
+
+// Exact sum of doubles: the value is the exact sum correctly rounded, so it
+// does not depend on the order in which the terms are added, nor on how they
+// are split between accumulators merged later. Totals are thus reproducible
+// bit for bit whatever the number of threads or shards, and do not lose the
+// small terms of large sums with mixed signs. Subtracting a term added
+// before cancels it exactly.
+//
+// The sum is kept as a few non-overlapping partial sums (Shewchuk's
+// algorithm, as in Python's math.fsum). Infinities and NaNs are summed
+// naively on the side.
+struct ExactSum {
+ public:
+  ExactSum() : m_special(0.0) {}
+
+  void add(double x);
+  void add(const ExactSum& other);
+
+  ExactSum& operator+=(double x) { add(x); return *this; }
+  ExactSum& operator+=(const ExactSum& other) { add(other); return *this; }
+
+  double value() const;
+
+ private:
+  std::vector<double> m_partials;  // increasing magnitude
+  double m_special;                // sum of the non finite terms
+};
+
+// exact sum of the values which are not NaN, accumulated by blocks
+// concurrently on the pool if given
+double sum_valid(const double *v, size_t n, ThreadPool *pool = nullptr);
+
+} // namespace minirisk
@@ -0,0 +1,300 @@
+#include "ResultWriter.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+
+#include "Macros.h"
+#include "RiskCube.h"
+
+namespace minirisk {
+namespace {
+const char binary_magic[8] = {'M', 'R', 'R', 'E', 'S', 'U', 'L', 'T'};
+const uint32_t binary_version = 1;
+
+const size_t buffer_size = 1 << 20;
+
+const char separator_line[] = "========================\n";
+
+// %g with the default precision of std::ostream
+size_t format_default(double v, char *buf) {
+  return std::snprintf(buf, 32, "%g", v);
+}
+
+size_t format_index(size_t i, char *buf) {
+  return std::snprintf(buf, 24, "%5zu", i);
+}
+
+std::string csv_quote(const std::string& s) {
+  if (s.find_first_of(",\"\n") == std::string::npos)
+    return s;
+  std::string res = "\"";
+  for (char c : s) {
+    if (c == '"')
+      res += '"';
+    res += c;
+  }
+  return res + '"';
+}
+
+template <typename T>
+void read_pod(std::FILE *f, T& v, const std::string& filename) {
+  MYASSERT(std::fread(&v, sizeof(T), 1, f) == 1,
+      "Unexpected end of file " << filename);
+}
+
+std::string read_chars(std::FILE *f, size_t len, const std::string& filename) {
+  std::string s(len, '\0');
+  MYASSERT(std::fread(&s[0], 1, len, f) == len,
+      "Unexpected end of file " << filename);
+  return s;
+}
+
+std::string read_string(std::FILE *f, const std::string& filename) {
+  uint32_t len;
+  read_pod(f, len, filename);
+  return read_chars(f, len, filename);
+}
+} // namespace
+
+result_format_t parse_result_format(const std::string& s) {
+  if (s == "text")
+    return result_format_t::text;
+  if (s == "csv")
+    return result_format_t::csv;
+  if (s == "binary")
+    return result_format_t::binary;
+  THROW("Unknown result format: " << s);
+}
+
+size_t format_shortest(double v, char *buf) {
+  if (std::isnan(v))
+    return std::snprintf(buf, 25, "nan");
+  // 15 significant digits are always exact for doubles produced from decimal
+  // input, 17 always round trip
+  size_t n = 0;
+  for (int prec = 15; prec <= 17; ++prec) {
+    n = std::snprintf(buf, 25, "%.*g", prec, v);
+    if (std::strtod(buf, nullptr) == v)
+      break;
+  }
+  return n;
+}
+
+ResultWriter::ResultWriter(const std::string& filename, result_format_t format)
+  : m_file(filename.empty() ? stdout : std::fopen(filename.c_str(), "wb"))
+  , m_owned(!filename.empty())
+  , m_format(format)
+  , m_buf(buffer_size)
+  , m_size(0) {
+  MYASSERT(m_file, "Could not open file " << filename);
+  write_header();
+}
+
+ResultWriter::ResultWriter(std::FILE *file, result_format_t format)
+  : m_file(file)
+  , m_owned(false)
+  , m_format(format)
+  , m_buf(buffer_size)
+  , m_size(0) {
+  write_header();
+}
+
+void ResultWriter::write_header() {
+  if (m_format == result_format_t::csv) {
+    append(std::string("name,trade,value,error\n"));
+  } else if (m_format == result_format_t::binary) {
+    append(binary_magic, sizeof(binary_magic));
+    append_pod(binary_version);
+  }
+}
+
+ResultWriter::~ResultWriter() {
+  try {
+    close();
+  } catch (const std::exception&) {
+    if (m_owned && m_file)
+      std::fclose(m_file);
+  }
+}
+
+void ResultWriter::flush() {
+  write_buffer();
+  MYASSERT(std::fflush(m_file) == 0, "Could not write results");
+}
+
+void ResultWriter::close() {
+  if (!m_file)
+    return;
+  flush();
+  std::FILE *f = m_file;
+  m_file = nullptr;
+  MYASSERT(!m_owned || std::fclose(f) == 0, "Could not write results");
+}
+
+void ResultWriter::write_buffer() {
+  MYASSERT(m_file, "Results written after close");
+  const size_t n = m_size;
+  m_size = 0;
+  MYASSERT(std::fwrite(m_buf.data(), 1, n, m_file) == n,
+      "Could not write results");
+}
+
+char *ResultWriter::reserve(size_t n) {
+  if (m_size + n > m_buf.size()) {
+    write_buffer();
+    if (n > m_buf.size())
+      m_buf.resize(n);
+  }
+  return m_buf.data() + m_size;
+}
+
+void ResultWriter::append(const char *s, size_t n) {
+  if (n == 0)
+    return;
+  std::memcpy(reserve(n), s, n);
+  m_size += n;
+}
+
+template <typename T>
+void ResultWriter::append_pod(const T& v) {
+  append(reinterpret_cast<const char *>(&v), sizeof(T));
+}
+
+void ResultWriter::write(
+    const std::string& name, const portfolio_values_t& values) {
+  RiskCube cube(values.size());
+  cube.add_scenario(
+      scenario_info_t{name, measure_t::pv, {}, bump_type_t::none, 0.0}, values);
+  write(cube, 0);
+}
+
+void ResultWriter::write(const RiskCube& cube, size_t s) {
+  switch (m_format) {
+    case result_format_t::text:
+      write_text(cube, s);
+      break;
+    case result_format_t::csv:
+      write_csv(cube, s);
+      break;
+    case result_format_t::binary:
+      write_binary(cube, s);
+      break;
+  }
+}
+
+void ResultWriter::write_text(const RiskCube& cube, size_t s) {
+  const auto& res = cube.total(s);
+  append(separator_line, sizeof(separator_line) - 1);
+  append(cube.scenario(s).name);
+  append(":\n", 2);
+  append(separator_line, sizeof(separator_line) - 1);
+  append("Total:  ", 8);
+  m_size += format_default(res.first, reserve(32));
+  append("\nErrors: ", 9);
+  m_size += std::snprintf(reserve(24), 24, "%zu", res.second);
+  append("\n\n", 2);
+  append(separator_line, sizeof(separator_line) - 1);
+
+  const double *values = cube.row(s);
+  for (size_t i = 0, n = cube.n_trades(); i < n; ++i) {
+    m_size += format_index(i, reserve(24));
+    append(": ", 2);
+    if (std::isnan(values[i]))
+      append(*cube.error(s, i));
+    else
+      m_size += format_default(values[i], reserve(32));
+    append("\n", 1);
+  }
+
+  append(separator_line, sizeof(separator_line) - 1);
+  append("\n", 1);
+}
+
+void ResultWriter::write_csv(const RiskCube& cube, size_t s) {
+  const std::string prefix = csv_quote(cube.scenario(s).name) + ",";
+  const double *values = cube.row(s);
+  for (size_t i = 0, n = cube.n_trades(); i < n; ++i) {
+    append(prefix);
+    m_size += std::snprintf(reserve(24), 24, "%zu,", i);
+    if (std::isnan(values[i])) {
+      append(",", 1);
+      append(csv_quote(*cube.error(s, i)));
+    } else {
+      m_size += format_shortest(values[i], reserve(25));
+      append(",", 1);
+    }
+    append("\n", 1);
+  }
+}
+
+// Layout of each vector (after the file header: magic, uint32 version):
+//   uint32 name length, name characters
+//   uint64 number of trades N, N doubles (NaN for trades in error)
+//   uint64 number of errors E, E times (uint64 trade index, uint32 message
+//   length, message characters)
+void ResultWriter::write_binary(const RiskCube& cube, size_t s) {
+  const std::string& name = cube.scenario(s).name;
+  const double *values = cube.row(s);
+  const size_t n = cube.n_trades();
+  append_pod(static_cast<uint32_t>(name.size()));
+  append(name);
+  append_pod(static_cast<uint64_t>(n));
+  append(reinterpret_cast<const char *>(values), n * sizeof(double));
+  append_pod(static_cast<uint64_t>(cube.total(s).second));
+  for (size_t i = 0; i < n; ++i) {
+    if (std::isnan(values[i])) {
+      const std::string& msg = *cube.error(s, i);
+      append_pod(static_cast<uint64_t>(i));
+      append_pod(static_cast<uint32_t>(msg.size()));
+      append(msg);
+    }
+  }
+}
+
+std::vector<std::pair<std::string, portfolio_values_t>> read_binary_results(
+    const std::string& filename) {
+  std::FILE *f = std::fopen(filename.c_str(), "rb");
+  MYASSERT(f, "Could not open file " << filename);
+  std::unique_ptr<std::FILE, int (*)(std::FILE *)> closer(f, &std::fclose);
+  return read_binary_results(f, filename);
+}
+
+std::vector<std::pair<std::string, portfolio_values_t>> read_binary_results(
+    std::FILE *f, const std::string& filename) {
+  char magic[sizeof(binary_magic)];
+  uint32_t version;
+  MYASSERT(std::fread(magic, 1, sizeof(magic), f) == sizeof(magic)
+      && std::memcmp(magic, binary_magic, sizeof(magic)) == 0,
+      "Not a binary result file: " << filename);
+  read_pod(f, version, filename);
+  MYASSERT(version == binary_version,
+      "Unsupported binary result version " << version << " in " << filename);
+
+  std::vector<std::pair<std::string, portfolio_values_t>> results;
+  uint32_t name_len;
+  while (std::fread(&name_len, sizeof(name_len), 1, f) == 1) {
+    std::string name = read_chars(f, name_len, filename);
+    uint64_t n;
+    read_pod(f, n, filename);
+    std::vector<double> prices(n);
+    MYASSERT(std::fread(prices.data(), sizeof(double), n, f) == n,
+        "Unexpected end of file " << filename);
+    portfolio_values_t values(n);
+    for (size_t i = 0; i < n; ++i)
+      values[i].first = prices[i];
+    uint64_t n_errors;
+    read_pod(f, n_errors, filename);
+    for (uint64_t e = 0; e < n_errors; ++e) {
+      uint64_t i;
+      read_pod(f, i, filename);
+      MYASSERT(i < n, "Invalid trade index " << i << " in " << filename);
+      values[i].second = read_string(f, filename);
+    }
+    results.emplace_back(std::move(name), std::move(values));
+  }
+  return results;
+}
+
+} // namespace minirisk
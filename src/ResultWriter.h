@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "PortfolioUtils.h"
+
+namespace minirisk {
+
+struct RiskCube;
+
+enum class result_format_t {
+  text,    // human readable layout, as printed by print_price_vector
+  csv,     // one line per trade: name,index,value,error
+  binary   // native endianness, see write_binary for the layout
+};
+
+// parse "text", "csv" or "binary"
+result_format_t parse_result_format(const std::string& s);
+
+// Writes the shortest representation of v which parses back to the same
+// double, returns the number of characters written (at most 24, no
+// terminator). NaN and infinities are written as nan, inf and -inf.
+size_t format_shortest(double v, char *buf);
+
+// Buffered writer for vectors of results. Output is accumulated in memory
+// and handed to the C runtime in large blocks, bypassing iostreams.
+struct ResultWriter {
+ public:
+  // an empty filename means stdout
+  ResultWriter(const std::string& filename, result_format_t format);
+  // write to an open file (e.g. a memory stream), which is not closed
+  ResultWriter(std::FILE *file, result_format_t format);
+  // closes as close() does, ignoring errors
+  ~ResultWriter();
+
+  result_format_t format() const { return m_format; }
+
+  void write(const std::string& name, const portfolio_values_t& values);
+
+  // write row s of the cube, labelled with the scenario name
+  void write(const RiskCube& cube, size_t s);
+
+  // force buffered data to the output, throws if it cannot be written
+  void flush();
+
+  // flush, then close the file if owned, throws if either fails
+  void close();
+
+ private:
+  ResultWriter(const ResultWriter&) = delete;
+  ResultWriter& operator=(const ResultWriter&) = delete;
+
+  void write_text(const RiskCube& cube, size_t s);
+  void write_csv(const RiskCube& cube, size_t s);
+  void write_binary(const RiskCube& cube, size_t s);
+
+  // hand the buffer to the C runtime, throws on a short write
+  void write_buffer();
+  // make room for at least n more bytes
+  char *reserve(size_t n);
+  void append(const char *s, size_t n);
+  void append(const std::string& s) { append(s.data(), s.size()); }
+  template <typename T> void append_pod(const T& v);
+  void write_header();
+
+  std::FILE *m_file;
+  bool m_owned;
+  result_format_t m_format;
+  std::vector<char> m_buf;
+  size_t m_size;
+};
+
+// read back a file written in binary format
+std::vector<std::pair<std::string, portfolio_values_t>> read_binary_results(
+    const std::string& filename);
+
+// same as above, reading from an open file; name is only used in messages
+std::vector<std::pair<std::string, portfolio_values_t>> read_binary_results(
+    std::FILE *f, const std::string& name);
+
+} // namespace minirisk
@@ -0,0 +1,115 @@
+#include "RiskCube.h"
+
+#include <cmath>
+#include <map>
+
+#include "Macros.h"
+#include "Reduction.h"
+
+namespace minirisk {
+namespace {
+
+// assigns group indices in alphabetical order of the labels
+template <typename F>
+trade_grouping_t group_by(const portfolio_t& portfolio, F label_of) {
+  std::map<std::string, unsigned> index;
+  for (const auto& pt : portfolio)
+    index.emplace(label_of(*pt), 0);
+  trade_grouping_t res;
+  for (auto& i : index) {
+    i.second = res.labels.size();
+    res.labels.push_back(i.first);
+  }
+  res.group.reserve(portfolio.size());
+  for (const auto& pt : portfolio)
+    res.group.push_back(index[label_of(*pt)]);
+  return res;
+}
+
+// upper bounds (in days) of the tenor buckets, and their labels
+const std::vector<long> tenor_bucket_days = {0, 30, 91, 365, 1826, 3652};
+const std::vector<std::string> tenor_bucket_labels = {
+  "expired", "<=1M", "<=3M", "<=1Y", "<=5Y", "<=10Y", ">10Y"};
+
+} // namespace
+
+trade_grouping_t group_by_ccy(const portfolio_t& portfolio) {
+  return group_by(portfolio, [](const ITrade& t) { return t.ccy(); });
+}
+
+trade_grouping_t group_by_tenor(const portfolio_t& portfolio, const Date& today) {
+  trade_grouping_t res;
+  res.labels = tenor_bucket_labels;
+  for (const auto& pt : portfolio) {
+    long days = pt->maturity() - today;
+    res.group.push_back(days < 0 ? 0 : std::lower_bound(
+          tenor_bucket_days.begin() + 1, tenor_bucket_days.end(), days)
+        - tenor_bucket_days.begin());
+  }
+  return res;
+}
+
+trade_grouping_t group_by_type(const portfolio_t& portfolio) {
+  return group_by(portfolio, [](const ITrade& t) { return t.idname(); });
+}
+
+size_t RiskCube::add_scenario(
+    const scenario_info_t& info, const portfolio_values_t& values) {
+  MYASSERT(values.size() == m_n_trades, "Scenario " << info.name << " has "
+      << values.size() << " values, expected " << m_n_trades);
+  size_t s = m_scenarios.size();
+  m_scenarios.push_back(info);
+  m_values.reserve(m_values.size() + m_n_trades);
+  for (size_t t = 0; t < m_n_trades; ++t) {
+    m_values.push_back(values[t].first);
+    if (std::isnan(values[t].first)) {
+      auto ins = m_message_index.emplace(values[t].second, m_messages.size());
+      if (ins.second)
+        m_messages.push_back(values[t].second);
+      m_errors.emplace(s * m_n_trades + t, ins.first->second);
+    }
+  }
+  return s;
+}
+
+const std::string *RiskCube::error(size_t s, size_t t) const {
+  auto iter = m_errors.find(s * m_n_trades + t);
+  return iter == m_errors.end() ? nullptr : &m_messages[iter->second];
+}
+
+portfolio_values_t RiskCube::values(size_t s) const {
+  portfolio_values_t res(m_n_trades);
+  const double *r = row(s);
+  for (size_t t = 0; t < m_n_trades; ++t) {
+    res[t].first = r[t];
+    if (std::isnan(r[t]))
+      res[t].second = *error(s, t);
+  }
+  return res;
+}
+
+std::pair<double, size_t> RiskCube::total(size_t s) const {
+  const double *r = row(s);
+  size_t n_errors = 0;
+  for (size_t t = 0; t < m_n_trades; ++t)
+    n_errors += std::isnan(r[t]) ? 1 : 0;
+  return std::make_pair(sum_valid(r, m_n_trades), n_errors);
+}
+
+std::vector<double> RiskCube::aggregate(
+    size_t s, const trade_grouping_t& g) const {
+  MYASSERT(g.group.size() == m_n_trades, "Grouping has " << g.group.size()
+      << " trades, expected " << m_n_trades);
+  std::vector<ExactSum> sums(g.labels.size());
+  const double *r = row(s);
+  const unsigned *group = g.group.data();
+  for (size_t t = 0; t < m_n_trades; ++t)
+    if (!std::isnan(r[t]))
+      sums[group[t]] += r[t];
+  std::vector<double> res(sums.size());
+  for (size_t i = 0; i < sums.size(); ++i)
+    res[i] = sums[i].value();
+  return res;
+}
+
+} // namespace minirisk
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Date.h"
+#include "ITrade.h"
+#include "PortfolioUtils.h"
+
+namespace minirisk {
+
+enum class measure_t { pv, pv01_bucketed, pv01_parallel, fx_delta, theta, pnl,
+  var, gamma, cross_gamma };
+
+enum class bump_type_t { none, absolute, relative };
+
+// Metadata of a row of the risk cube
+struct scenario_info_t {
+  std::string name;                       // label used in reports
+  measure_t measure;
+  std::vector<std::string> risk_factors;  // bumped risk factors, if any
+  bump_type_t bump_type;
+  double bump_size;
+};
+
+// Partition of the trades of a portfolio in labelled groups
+struct trade_grouping_t {
+  std::vector<std::string> labels;
+  std::vector<unsigned> group;  // group index of each trade
+};
+
+// group trades by settlement currency
+trade_grouping_t group_by_ccy(const portfolio_t& portfolio);
+
+// group trades by time to maturity, in standard tenor buckets
+trade_grouping_t group_by_tenor(const portfolio_t& portfolio, const Date& today);
+
+// group trades by trade type
+trade_grouping_t group_by_type(const portfolio_t& portfolio);
+
+// Results of a risk run: a dense scenario x trade matrix of doubles, stored
+// row by row. Trades in error hold a NaN, and the error message is kept in a
+// sparse side table referring to a pool of interned messages, as the same
+// message is typically repeated in many scenarios.
+struct RiskCube {
+ public:
+  explicit RiskCube(size_t n_trades) : m_n_trades(n_trades) {}
+
+  size_t n_trades() const { return m_n_trades; }
+  size_t n_scenarios() const { return m_scenarios.size(); }
+
+  // append a row, returns its index
+  size_t add_scenario(
+      const scenario_info_t& info, const portfolio_values_t& values);
+
+  const scenario_info_t& scenario(size_t s) const { return m_scenarios[s]; }
+
+  // values of row s, NaN for trades in error
+  const double *row(size_t s) const { return m_values.data() + s * m_n_trades; }
+
+  // error message of a trade, nullptr if the trade has a value
+  const std::string *error(size_t s, size_t t) const;
+
+  // row s in the legacy format
+  portfolio_values_t values(size_t s) const;
+
+  // exact sum of row s (see ExactSum) and number of trades in error
+  std::pair<double, size_t> total(size_t s) const;
+
+  // exact sum of row s by group, trades in error are skipped
+  std::vector<double> aggregate(size_t s, const trade_grouping_t& g) const;
+
+ private:
+  size_t m_n_trades;
+  std::vector<scenario_info_t> m_scenarios;
+  std::vector<double> m_values;
+  std::unordered_map<size_t, unsigned> m_errors;  // cell -> message index
+  std::vector<std::string> m_messages;
+  std::unordered_map<std::string, unsigned> m_message_index;
+};
+
+} // namespace minirisk
@@ -0,0 +1,185 @@
+#include "RiskPlan.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+
+#include "Instrumentation.h"
+#include "Macros.h"
+#include "ThreadPool.h"
+
+namespace minirisk {
+namespace {
+// the changes from the scenario `from` to the scenario `to`: the factors
+// moved in `from` only are restored, the others take their values in `to`
+Market::vec_risk_factor_t changes(const risk_plan_t& plan,
+    const market_scenario_t& from, const market_scenario_t& to) {
+  Market::vec_risk_factor_t res;
+  auto f = from.begin();
+  auto t = to.begin();
+  while (f != from.end() || t != to.end()) {
+    if (t == to.end() || (f != from.end() && f->first < t->first)) {
+      res.push_back(std::make_pair(f->first, plan.base.at(f->first)));
+      ++f;
+    } else if (f == from.end() || t->first < f->first) {
+      res.push_back(*t++);
+    } else {
+      if (f->second != t->second)
+        res.push_back(*t);
+      ++f;
+      ++t;
+    }
+  }
+  return res;
+}
+} // namespace
+
+risk_plan_t::risk_plan_t()
+  : scenarios(1)
+  , lanes(4)
+{
+  m_index.emplace(market_scenario_t(), 0);
+}
+
+size_t risk_plan_t::add_scenario(
+    const std::map<std::string, std::pair<double, double>>& moves) {
+  market_scenario_t s;
+  for (const auto& m : moves) {
+    if (m.second.second == m.second.first)
+      continue;
+    base.emplace(m.first, m.second.first);
+    s.push_back(std::make_pair(m.first, m.second.second));
+  }
+  auto ins = m_index.emplace(s, scenarios.size());
+  if (ins.second)
+    scenarios.push_back(std::move(s));
+  return ins.first->second;
+}
+
+void run_risk_plan(const std::vector<ppricer_t>& pricers, const Market& mkt,
+    std::shared_ptr<const FixingDataServer> fds, const risk_plan_t& plan,
+    RiskCube& cube, const portfolio_values_t* base_pv, ThreadPool* pool,
+    const trade_dependencies_t* base_deps) {
+  INSTR_SCOPE("run_risk_plan");
+  std::vector<bool> used(plan.scenarios.size(), false);
+  for (const auto& r : plan.rows)
+    for (const auto& term : r.terms)
+      used[term.first] = true;
+  std::vector<size_t> todo;
+  for (size_t s = 1; s < plan.scenarios.size(); ++s)
+    if (used[s])
+      todo.push_back(s);
+
+  // the base prices and the risk factors each trade depends on, recorded
+  // by a base revaluation if not given
+  portfolio_values_t base;
+  trade_dependencies_t recorded;
+  if (!base_pv || !base_deps) {
+    Market m(mkt);
+    base = compute_prices(pricers, m, fds, base_pv, &recorded);
+    if (!base_pv)
+      base_pv = &base;
+    base_deps = &recorded;
+  }
+  MYASSERT(base_deps->size() == pricers.size(),
+      "Dependencies do not match the number of pricers");
+  std::map<std::string, std::vector<size_t>> index;
+  for (size_t t = 0; t < pricers.size(); ++t)
+    if (!std::isnan((*base_pv)[t].first))
+      for (const auto& rf : (*base_deps)[t])
+        index[rf].push_back(t);
+  std::vector<portfolio_values_t> values(plan.scenarios.size());
+  values[0] = *base_pv;
+
+  // revalues todo[begin, end) in batches of consecutive scenarios, each
+  // on one of the lane markets moved from the base, only the trades
+  // depending on the risk factors moved in the batch
+  const size_t lanes = std::max<size_t>(1,
+      std::min(plan.lanes, max_price_lanes));
+  auto run = [&](Market* const* m, size_t begin, size_t end) {
+    std::vector<const market_scenario_t *> current(lanes, &plan.scenarios[0]);
+    std::vector<size_t> trades;
+    std::vector<ppricer_t> dependent;
+    portfolio_values_t prices[max_price_lanes];
+    for (size_t b = begin; b < end; b += lanes) {
+      const size_t n = std::min(lanes, end - b);
+      trades.clear();
+      for (size_t k = 0; k < n; ++k) {
+        values[todo[b + k]] = *base_pv;
+        for (const auto& rf : plan.scenarios[todo[b + k]]) {
+          auto i = index.find(rf.first);
+          if (i != index.end())
+            trades.insert(trades.end(), i->second.begin(), i->second.end());
+        }
+      }
+      std::sort(trades.begin(), trades.end());
+      trades.erase(std::unique(trades.begin(), trades.end()), trades.end());
+      if (trades.empty())
+        continue;
+      for (size_t k = 0; k < n; ++k) {
+        const market_scenario_t& next = plan.scenarios[todo[b + k]];
+        auto moves = changes(plan, *current[k], next);
+        if (!moves.empty())
+          m[k]->update_risk_factors(moves);
+        current[k] = &next;
+      }
+      dependent.clear();
+      for (size_t t : trades)
+        dependent.push_back(pricers[t]);
+      compute_prices_batch(dependent, m, n, fds, prices);
+      for (size_t k = 0; k < n; ++k)
+        for (size_t i = 0; i < trades.size(); ++i)
+          values[todo[b + k]][trades[i]] = std::move(prices[k][i]);
+    }
+  };
+  // the runs start on a batch, the market copies are made here and each
+  // run only uses its own
+  const size_t batches = (todo.size() + lanes - 1) / lanes;
+  const size_t n_runs =
+    std::min(pool ? std::max<size_t>(pool->size(), 1) : 1, batches);
+  std::vector<std::unique_ptr<Market>> markets;
+  std::vector<Market *> lane_markets;
+  for (size_t i = 0; i < n_runs * lanes; ++i) {
+    markets.emplace_back(new Market(mkt));
+    lane_markets.push_back(markets.back().get());
+  }
+  if (n_runs <= 1) {
+    run(lane_markets.data(), 0, todo.size());
+  } else {
+    std::vector<std::future<bool>> tasks;
+    for (size_t r = 0; r < n_runs; ++r) {
+      Market* const* m = lane_markets.data() + r * lanes;
+      const size_t begin = batches * r / n_runs * lanes;
+      const size_t end =
+        std::min(todo.size(), batches * (r + 1) / n_runs * lanes);
+      tasks.push_back(pool->async([&run, m, begin, end] {
+          run(m, begin, end);
+          return true; }));
+    }
+    // all the runs finish before any error is rethrown
+    for (auto& t : tasks)
+      t.wait();
+    for (auto& t : tasks)
+      t.get();
+  }
+
+  const size_t n = pricers.size();
+  for (const auto& r : plan.rows) {
+    portfolio_values_t res(n);
+    for (size_t t = 0; t < n; ++t) {
+      double x = 0.0;
+      for (size_t i = 0; i < r.terms.size() && !std::isnan(res[t].first); ++i) {
+        const auto& vt = values[r.terms[i].first][t];
+        if (std::isnan(vt.first))
+          res[t] = vt;
+        else
+          x += r.terms[i].second * vt.first;
+      }
+      if (!std::isnan(res[t].first))
+        res[t].first = x / r.denom;
+    }
+    cube.add_scenario(r.info, res);
+  }
+}
+
+} // namespace minirisk
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "FixingDataServer.h"
+#include "IPricer.h"
+#include "Market.h"
+#include "PortfolioUtils.h"
+#include "RiskCube.h"
+
+namespace minirisk {
+
+struct ThreadPool;
+
+// A market scenario: the risk factors moved from the base market and their
+// values, sorted by name. The base market itself has no moves.
+typedef Market::vec_risk_factor_t market_scenario_t;
+
+// A row of results, sum of weight * PV(scenario) / denom
+struct plan_row_t {
+  scenario_info_t info;
+  std::vector<std::pair<size_t, double>> terms;  // scenario index, weight
+  double denom;
+};
+
+// Unique market scenarios, and the rows derived from their revaluations
+struct risk_plan_t {
+  risk_plan_t();
+
+  // index of the scenario with these moves (base value -> moved value of
+  // each risk factor), added if new. Moves to the base value are dropped,
+  // so that equal scenarios are only revalued once.
+  size_t add_scenario(const std::map<std::string, std::pair<double, double>>& moves);
+
+  std::vector<market_scenario_t> scenarios;   // scenarios[0] is the base
+  std::map<std::string, double> base;         // base value of moved factors
+  std::vector<plan_row_t> rows;
+  // scenarios revalued together, at most max_price_lanes (see
+  // compute_prices_batch)
+  size_t lanes;
+
+ private:
+  std::map<market_scenario_t, size_t> m_index;
+};
+
+// Revalues each scenario used by the rows once, then appends the rows to
+// the cube. Trades in error in any term of a row have the error of the
+// first one.
+//
+// A scenario only reprices the trades which depend on its moved risk
+// factors, the others keep their base prices. The base prices and the
+// dependencies recorded while computing them (see compute_prices) are
+// revalued first if either is not given.
+//
+// The scenarios are revalued in batches of plan.lanes consecutive ones,
+// each on its own copy of the market, so that a trade is read once per
+// batch. The batches are split in consecutive runs, one per thread of the
+// pool if given. Moving a market from a scenario to the next only updates
+// the risk factors which differ, and rebuilds the curves which depend on
+// them.
+void run_risk_plan(const std::vector<ppricer_t>& pricers, const Market& mkt,
+    std::shared_ptr<const FixingDataServer> fds, const risk_plan_t& plan,
+    RiskCube& cube, const portfolio_values_t* base_pv = nullptr,
+    ThreadPool* pool = nullptr,
+    const trade_dependencies_t* base_deps = nullptr);
+
+} // namespace minirisk
@@ -0,0 +1,235 @@
+#include "RiskSession.h"
+
+#include <cmath>
+
+#include "GreekEngine.h"
+#include "Instrumentation.h"
+#include "Macros.h"
+
+namespace minirisk {
+
+uint64_t trade_hash(const ITrade& trade, std::string *content) {
+  my_ofstream os;
+  trade.save(os);
+  const std::string s = os.str();
+  uint64_t h = 14695981039346656037ULL;
+  for (unsigned char c : s) {
+    h ^= c;
+    h *= 1099511628211ULL;
+  }
+  if (content)
+    *content = s;
+  return h;
+}
+
+RiskSession::RiskSession(std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds, const Date& today,
+    const std::string& base_ccy, const greek_config_t& greeks)
+  : m_today(today)
+  , m_base_ccy(base_ccy)
+  , m_greeks(greeks)
+  , m_version(0) {
+  set_market_data(mds, fds);
+}
+
+void RiskSession::add_trade(const std::string& id, const ptrade_t& trade) {
+  MYASSERT(m_book.find(id) == m_book.end(), "Trade already booked: " << id);
+  m_book[id].trade = trade;
+  m_pending.insert(id);
+}
+
+void RiskSession::amend_trade(const std::string& id, const ptrade_t& trade) {
+  auto iter = m_book.find(id);
+  MYASSERT(iter != m_book.end(), "Trade not found: " << id);
+  invalidate(id, iter->second);
+  iter->second.trade = trade;
+}
+
+void RiskSession::remove_trade(const std::string& id) {
+  auto iter = m_book.find(id);
+  MYASSERT(iter != m_book.end(), "Trade not found: " << id);
+  invalidate(id, iter->second);
+  m_pending.erase(id);
+  m_book.erase(iter);
+}
+
+void RiskSession::set_market_data(std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds) {
+  m_fds = fds;
+  m_mkt.reset(new Market(mds, m_today));
+  ++m_version;
+  m_cache.clear();
+
+  // the risk factors of the new market are only known after pricing
+  m_scenarios.clear();
+  m_scenario_index.clear();
+  m_totals.clear();
+  m_n_errors.clear();
+  scenario_index(
+      scenario_info_t{"PV", measure_t::pv, {}, bump_type_t::none, 0.0});
+
+  for (auto& b : m_book) {
+    b.second.result.reset();
+    m_pending.insert(b.first);
+  }
+}
+
+double RiskSession::cell(const result_t& r, size_t s) {
+  if (s < r.values.size())
+    return r.values[s];
+  return std::isnan(r.values[0]) ? r.values[0] : 0.0;
+}
+
+const std::string& RiskSession::cell_error(const result_t& r, size_t s) {
+  auto iter = r.errors.find(s < r.values.size() ? s : 0);
+  MYASSERT(iter != r.errors.end(), "No error in scenario " << s);
+  return iter->second;
+}
+
+void RiskSession::aggregate(const result_t& r, int sign) {
+  for (size_t s = 0, n = m_scenarios.size(); s < n; ++s) {
+    double v = cell(r, s);
+    if (std::isnan(v)) {
+      if (sign > 0)
+        ++m_n_errors[s];
+      else
+        --m_n_errors[s];
+    } else {
+      m_totals[s] += sign * v;
+    }
+  }
+}
+
+void RiskSession::invalidate(const std::string& id, booking_t& b) {
+  if (b.result) {
+    aggregate(*b.result, -1);
+    b.result.reset();
+  }
+  m_pending.insert(id);
+}
+
+size_t RiskSession::scenario_index(const scenario_info_t& info) {
+  auto ins = m_scenario_index.emplace(info.name, m_scenarios.size());
+  if (ins.second) {
+    m_scenarios.push_back(info);
+    m_totals.emplace_back();
+    // trades already aggregated are in error in the new scenario if their
+    // PV is in error, and have no sensitivity otherwise
+    m_n_errors.push_back(m_n_errors.empty() ? 0 : m_n_errors[0]);
+  }
+  return ins.first->second;
+}
+
+size_t RiskSession::refresh() {
+  INSTR_SCOPE("RiskSession::refresh");
+  // look up the cache, collecting the distinct trades to be priced. The
+  // results are only given to the trades once the whole batch is priced,
+  // so that the trades stay pending if it throws.
+  std::vector<std::pair<booking_t *, size_t>> todo;
+  std::vector<std::pair<booking_t *, presult_t>> cached;
+  std::map<std::string, size_t> batch_index;  // by content
+  std::vector<uint64_t> batch_hash;
+  std::vector<ppricer_t> pricers;
+  for (const auto& id : m_pending) {
+    booking_t& b = m_book.at(id);
+    std::string content;
+    uint64_t h = trade_hash(*b.trade, &content);
+    auto iter = m_cache.find(std::make_pair(m_version, h));
+    if (iter != m_cache.end() && iter->second->content == content) {
+      cached.push_back(std::make_pair(&b, iter->second));
+      continue;
+    }
+    auto ins = batch_index.emplace(content, pricers.size());
+    if (ins.second) {
+      batch_hash.push_back(h);
+      pricers.push_back(b.trade->pricer(m_base_ccy));
+    }
+    todo.push_back(std::make_pair(&b, ins.first->second));
+  }
+
+  std::vector<std::shared_ptr<result_t>> results(pricers.size());
+  if (!pricers.empty()) {
+    // price the batch, the rows of the cube are matched to the scenarios of
+    // the session by name
+    RiskCube cube(pricers.size());
+    trade_dependencies_t deps;
+    auto prices = compute_prices(pricers, *m_mkt, m_fds, nullptr, &deps);
+    cube.add_scenario(m_scenarios[0], prices);
+    compute_greeks(pricers, *m_mkt, m_fds, m_greeks, cube, &prices, nullptr,
+        &deps);
+
+    std::vector<size_t> index(cube.n_scenarios());
+    for (size_t s = 0; s < cube.n_scenarios(); ++s)
+      index[s] = scenario_index(cube.scenario(s));
+
+    for (size_t t = 0; t < pricers.size(); ++t) {
+      std::shared_ptr<result_t> r(new result_t);
+      r->values.assign(1, cube.row(0)[t]);
+      if (const std::string *err = cube.error(0, t))
+        r->errors[0] = *err;
+      // scenarios of the session the batch did not see (if any) get the
+      // default value
+      std::vector<double> values(m_scenarios.size());
+      for (size_t s = 0; s < values.size(); ++s)
+        values[s] = cell(*r, s);
+      for (size_t s = 1; s < values.size(); ++s)
+        if (std::isnan(values[s]))
+          r->errors[s] = r->errors[0];
+      for (size_t s = 1; s < cube.n_scenarios(); ++s) {
+        values[index[s]] = cube.row(s)[t];
+        if (const std::string *err = cube.error(s, t))
+          r->errors[index[s]] = *err;
+        else
+          r->errors.erase(index[s]);
+      }
+      r->values.swap(values);
+      results[t] = r;
+    }
+    for (auto& c : batch_index) {
+      results[c.second]->content = c.first;
+      m_cache[std::make_pair(m_version, batch_hash[c.second])] =
+        results[c.second];
+    }
+  }
+
+  for (auto& b : cached)
+    b.first->result = std::move(b.second);
+  for (const auto& b : todo)
+    b.first->result = results[b.second];
+  for (const auto& id : m_pending)
+    aggregate(*m_book.at(id).result, 1);
+  m_pending.clear();
+  return pricers.size();
+}
+
+void RiskSession::recompute_totals() {
+  std::fill(m_totals.begin(), m_totals.end(), ExactSum());
+  std::fill(m_n_errors.begin(), m_n_errors.end(), 0);
+  for (const auto& b : m_book)
+    if (b.second.result)
+      aggregate(*b.second.result, 1);
+}
+
+void RiskSession::trim_cache() {
+  std::set<const result_t *> used;
+  for (const auto& b : m_book)
+    used.insert(b.second.result.get());
+  for (auto iter = m_cache.begin(); iter != m_cache.end(); )
+    if (used.find(iter->second.get()) == used.end())
+      iter = m_cache.erase(iter);
+    else
+      ++iter;
+}
+
+trade_value_t RiskSession::value(const std::string& id, size_t s) const {
+  auto iter = m_book.find(id);
+  MYASSERT(iter != m_book.end(), "Trade not found: " << id);
+  MYASSERT(iter->second.result, "Trade not priced yet: " << id);
+  MYASSERT(s < m_scenarios.size(), "Scenario out of range: " << s);
+  const result_t& r = *iter->second.result;
+  double v = cell(r, s);
+  return std::isnan(v) ? std::make_pair(v, cell_error(r, s))
+    : std::make_pair(v, std::string());
+}
+
+} // namespace minirisk
@@ -0,0 +1,128 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "FixingDataServer.h"
+#include "GreekEngine.h"
+#include "Market.h"
+#include "MarketDataServer.h"
+#include "Reduction.h"
+#include "RiskCube.h"
+
+namespace minirisk {
+
+// hash of the serialized content of a trade (FNV-1a), the serialized content
+// is optionally returned
+uint64_t trade_hash(const ITrade& trade, std::string *content = nullptr);
+
+// Long-lived risk session for intraday use. Trades are booked under an
+// identifier chosen by the caller. add_trade, amend_trade and remove_trade
+// take the previous contribution of the trade out of the totals and mark it
+// as pending; refresh() prices all pending trades in one batch and adds their
+// contributions to the totals, so that the cost of a refresh is proportional
+// to the number of changes rather than to the size of the book.
+//
+// Results are cached by trade content hash and market version: amending a
+// trade back to a previous state, or booking a copy of an existing trade,
+// does not reprice anything. Replacing the market data starts a new version,
+// and the whole book is repriced at the next refresh.
+//
+// Scenarios are only ever added: a trade in a new currency brings in new risk
+// factors, hence new PV01 rows. Trades priced earlier did not look at those
+// risk factors, so their value in the new rows is 0 (or the error of their PV).
+struct RiskSession {
+ public:
+  // the greeks of each trade are the ones of the configuration
+  RiskSession(std::shared_ptr<const MarketDataServer> mds,
+      std::shared_ptr<const FixingDataServer> fds, const Date& today,
+      const std::string& base_ccy,
+      const greek_config_t& greeks = default_greek_config());
+
+  void add_trade(const std::string& id, const ptrade_t& trade);
+  void amend_trade(const std::string& id, const ptrade_t& trade);
+  void remove_trade(const std::string& id);
+
+  // replace the market data and fixings, all results are invalidated
+  void set_market_data(std::shared_ptr<const MarketDataServer> mds,
+      std::shared_ptr<const FixingDataServer> fds);
+
+  // Price the pending trades and update the totals, returns the number of
+  // trades actually priced (i.e. not found in the cache). If pricing
+  // throws, the trades stay pending and the totals are unchanged.
+  size_t refresh();
+
+  // totals recomputed from scratch, identical to the incremental ones as
+  // the totals are exact (see ExactSum)
+  void recompute_totals();
+
+  // drop cached results not referred to by any booked trade
+  void trim_cache();
+
+  uint64_t market_version() const { return m_version; }
+  size_t n_trades() const { return m_book.size(); }
+  size_t n_pending() const { return m_pending.size(); }
+  size_t n_cached() const { return m_cache.size(); }
+
+  // scenario 0 is the PV
+  size_t n_scenarios() const { return m_scenarios.size(); }
+  const scenario_info_t& scenario(size_t s) const { return m_scenarios[s]; }
+
+  // sum of scenario s over the priced trades, and number of trades in error
+  std::pair<double, size_t> total(size_t s) const {
+    return std::make_pair(m_totals[s].value(), m_n_errors[s]);
+  }
+
+  // value of a priced trade in scenario s
+  trade_value_t value(const std::string& id, size_t s) const;
+
+ private:
+  struct result_t {
+    std::string content;                   // guards against hash collisions
+    std::vector<double> values;            // by scenario, NaN in error
+    std::map<size_t, std::string> errors;  // by scenario
+  };
+  typedef std::shared_ptr<const result_t> presult_t;
+
+  struct booking_t {
+    ptrade_t trade;
+    presult_t result;  // null while pending
+  };
+
+  // value of a result in scenario s (see the class comment for the rows
+  // added after the result was computed)
+  static double cell(const result_t& r, size_t s);
+  static const std::string& cell_error(const result_t& r, size_t s);
+
+  // add (sign = 1) or subtract (sign = -1) a result from the totals
+  void aggregate(const result_t& r, int sign);
+
+  // take the booked trade out of the totals and mark it as pending
+  void invalidate(const std::string& id, booking_t& b);
+
+  size_t scenario_index(const scenario_info_t& info);
+
+  std::shared_ptr<const FixingDataServer> m_fds;
+  Date m_today;
+  std::string m_base_ccy;
+  greek_config_t m_greeks;
+  std::unique_ptr<Market> m_mkt;
+  uint64_t m_version;
+
+  std::map<std::string, booking_t> m_book;
+  std::set<std::string> m_pending;  // ids to be priced at the next refresh
+
+  // key is (market version, content hash)
+  std::map<std::pair<uint64_t, uint64_t>, presult_t> m_cache;
+
+  std::vector<scenario_info_t> m_scenarios;
+  std::unordered_map<std::string, size_t> m_scenario_index;
+  std::vector<ExactSum> m_totals;
+  std::vector<size_t> m_n_errors;
+};
+
+} // namespace minirisk
@@ -0,0 +1,248 @@
+#include "Sharding.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <queue>
+#include <sstream>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "GreekEngine.h"
+#include "Instrumentation.h"
+#include "Macros.h"
+#include "Market.h"
+#include "ResultWriter.h"
+#include "TradeFXForward.h"
+
+namespace minirisk {
+namespace {
+
+typedef std::vector<std::pair<std::string, portfolio_values_t>> results_t;
+
+// prices a shard and writes the results in binary layout to fd
+void run_shard(const shard_inputs_t& inputs,
+    const std::vector<size_t>& trades, int fd) {
+  portfolio_t portfolio = load_portfolio(inputs.portfolio_file, trades);
+  std::vector<ppricer_t> pricers(get_pricers(portfolio, inputs.base_ccy));
+  std::shared_ptr<const MarketDataServer> mds(
+      new MarketDataServer(inputs.risk_factors_file));
+  std::shared_ptr<const FixingDataServer> fds;
+  if (!inputs.fixing_path.empty())
+    fds.reset(new FixingDataServer(inputs.fixing_path));
+
+  Market mkt(mds, inputs.today);
+  mkt.prefetch(get_requirements(pricers, inputs.today, fds.get()), fds.get());
+  RiskCube cube(pricers.size());
+  trade_dependencies_t deps;
+  auto prices = compute_prices(pricers, mkt, fds, nullptr, &deps);
+  cube.add_scenario(
+      scenario_info_t{"PV", measure_t::pv, {}, bump_type_t::none, 0.0}, prices);
+  mkt.disconnect();
+  compute_greeks(pricers, mkt, fds, default_greek_config(), cube, &prices,
+      nullptr, &deps);
+
+  std::FILE *f = ::fdopen(fd, "wb");
+  MYASSERT(f, "Cannot open the result pipe");
+  {
+    ResultWriter out(f, result_format_t::binary);
+    for (size_t s = 0; s < cube.n_scenarios(); ++s)
+      out.write(cube, s);
+  }
+  std::fclose(f);
+}
+
+std::string exit_status_message(int status) {
+  std::ostringstream os;
+  if (WIFSIGNALED(status))
+    os << "killed by signal " << WTERMSIG(status);
+  else
+    os << "exit code " << WEXITSTATUS(status);
+  return os.str();
+}
+
+const std::string bucketed_prefix = "PV01 bucketed ";
+const std::string parallel_prefix = "PV01 parallel ";
+const std::string fx_delta_prefix = "FX delta ";
+
+bool starts_with(const std::string& s, const std::string& prefix) {
+  return s.compare(0, prefix.length(), prefix) == 0;
+}
+
+} // namespace
+
+double estimate_cost(const ITrade& trade, const Date& today) {
+  // expired trades fail before fetching any data; an FX forward needs a
+  // forward curve, built from two discount curves and a spot curve
+  if (trade.maturity() < today)
+    return 0.1;
+  return trade.id() == TradeFXForward::m_id ? 3.0 : 1.0;
+}
+
+std::vector<std::vector<size_t>> partition_by_cost(
+    const std::vector<double>& costs, size_t n_shards) {
+  MYASSERT(n_shards > 0, "The number of shards must be positive");
+  std::vector<size_t> order(costs.size());
+  for (size_t i = 0; i < order.size(); ++i)
+    order[i] = i;
+  std::stable_sort(order.begin(), order.end(),
+      [&costs](size_t a, size_t b) { return costs[a] > costs[b]; });
+
+  // min-heap of (load, shard)
+  typedef std::pair<double, size_t> load_t;
+  std::priority_queue<load_t, std::vector<load_t>, std::greater<load_t>> loads;
+  for (size_t k = 0; k < n_shards; ++k)
+    loads.push(std::make_pair(0.0, k));
+  std::vector<std::vector<size_t>> shards(n_shards);
+  for (size_t i : order) {
+    load_t l = loads.top();
+    loads.pop();
+    shards[l.second].push_back(i);
+    loads.push(std::make_pair(l.first + costs[i], l.second));
+  }
+  for (auto& s : shards)
+    std::sort(s.begin(), s.end());
+  return shards;
+}
+
+RiskCube run_sharded(const shard_inputs_t& inputs, size_t n_shards) {
+  INSTR_SCOPE("run_sharded");
+  std::vector<double> costs;
+  scan_portfolio(inputs.portfolio_file, [&](size_t, const ITrade& t) {
+      costs.push_back(estimate_cost(t, inputs.today)); });
+  const size_t n_trades = costs.size();
+  auto shards = partition_by_cost(costs, n_shards);
+
+  // fork the workers, each writing its results to a pipe
+  std::vector<pid_t> pids(n_shards, -1);
+  std::vector<int> pipes(n_shards, -1);
+  std::cout.flush();
+  std::fflush(nullptr);
+  for (size_t k = 0; k < n_shards; ++k) {
+    if (shards[k].empty())
+      continue;
+    int fds[2];
+    MYASSERT(::pipe(fds) == 0, "Cannot create pipe: " << std::strerror(errno));
+    pid_t pid = ::fork();
+    MYASSERT(pid >= 0, "Cannot fork: " << std::strerror(errno));
+    if (pid == 0) {
+      ::close(fds[0]);
+      for (size_t j = 0; j < k; ++j)
+        if (pipes[j] >= 0)
+          ::close(pipes[j]);
+      int rc = 0;
+      try {
+        run_shard(inputs, shards[k], fds[1]);
+      } catch (const std::exception& e) {
+        std::cerr << "Shard " << k << ": " << e.what() << "\n";
+        rc = 1;
+      }
+      ::_exit(rc);
+    }
+    ::close(fds[1]);
+    pids[k] = pid;
+    pipes[k] = fds[0];
+  }
+
+  // collect the results; a worker blocks on its pipe until it is read
+  std::vector<results_t> results(n_shards);
+  std::vector<std::string> failures(n_shards);
+  for (size_t k = 0; k < n_shards; ++k) {
+    if (pids[k] < 0)
+      continue;
+    std::FILE *f = ::fdopen(pipes[k], "rb");
+    try {
+      MYASSERT(f, "Cannot open the result pipe");
+      results[k] = read_binary_results(f, "shard " + std::to_string(k));
+    } catch (const std::exception& e) {
+      failures[k] = e.what();
+    }
+    if (f)
+      std::fclose(f);
+    else
+      ::close(pipes[k]);
+    int status;
+    ::waitpid(pids[k], &status, 0);
+    if (!(WIFEXITED(status) && WEXITSTATUS(status) == 0))
+      failures[k] = "Shard " + std::to_string(k) + " failed: "
+        + exit_status_message(status);
+    else if (results[k].empty() || results[k][0].first != "PV"
+        || results[k][0].second.size() != shards[k].size())
+      failures[k] = "Shard " + std::to_string(k) + " returned no results";
+  }
+
+  // PV of all trades, used as default value of the scenarios a shard did not
+  // produce
+  portfolio_values_t pv(n_trades);
+  for (size_t k = 0; k < n_shards; ++k)
+    for (size_t i = 0; i < shards[k].size(); ++i)
+      pv[shards[k][i]] = failures[k].empty() ? results[k][0].second[i]
+        : std::make_pair(nan<double>(), failures[k]);
+
+  // union of the scenarios, in the order of a single process run: bucketed
+  // PV01 and FX delta are sorted by risk factor, parallel PV01 by the first
+  // IR risk factor of the currency
+  std::map<std::string, portfolio_values_t> merged;
+  for (size_t k = 0; k < n_shards; ++k) {
+    if (!failures[k].empty())
+      continue;
+    for (size_t s = 1; s < results[k].size(); ++s) {
+      auto ins = merged.emplace(results[k][s].first, portfolio_values_t());
+      if (ins.second) {
+        ins.first->second.reserve(n_trades);
+        for (const auto& v : pv)
+          ins.first->second.push_back(std::isnan(v.first) ? v
+              : std::make_pair(0.0, std::string()));
+      }
+      for (size_t i = 0; i < shards[k].size(); ++i)
+        ins.first->second[shards[k][i]] = results[k][s].second[i];
+    }
+  }
+
+  std::vector<scenario_info_t> bucketed, parallel, fx_delta;
+  for (const auto& m : merged) {
+    const auto& name = m.first;
+    if (starts_with(name, bucketed_prefix)) {
+      std::string rf = name.substr(bucketed_prefix.length());
+      bucketed.push_back(scenario_info_t{name, measure_t::pv01_bucketed, {rf},
+          bump_type_t::absolute, 0.01 / 100});
+    } else if (starts_with(name, parallel_prefix)) {
+      parallel.push_back(scenario_info_t{name, measure_t::pv01_parallel, {},
+          bump_type_t::absolute, 0.01 / 100});
+    } else if (starts_with(name, fx_delta_prefix)) {
+      std::string rf = name.substr(fx_delta_prefix.length());
+      fx_delta.push_back(scenario_info_t{name, measure_t::fx_delta, {rf},
+          bump_type_t::relative, 0.1 / 100});
+    } else {
+      THROW("Unexpected scenario " << name);
+    }
+  }
+  // the risk factors of a parallel PV01 are the tenors of the currency, or
+  // the yield if the curve has no tenors
+  for (auto& p : parallel) {
+    std::string ccy = p.name.substr(p.name.length() - 3);
+    for (const auto& b : bucketed)
+      if (b.risk_factors[0].compare(b.risk_factors[0].length() - 3, 3, ccy) == 0)
+        p.risk_factors.push_back(b.risk_factors[0]);
+    if (p.risk_factors.empty())
+      p.risk_factors.push_back(ir_rate_prefix + ccy);
+  }
+  std::stable_sort(parallel.begin(), parallel.end(),
+      [](const scenario_info_t& a, const scenario_info_t& b) {
+        return a.risk_factors[0] < b.risk_factors[0]; });
+
+  RiskCube cube(n_trades);
+  cube.add_scenario(
+      scenario_info_t{"PV", measure_t::pv, {}, bump_type_t::none, 0.0}, pv);
+  for (const auto* group : {&bucketed, &parallel, &fx_delta})
+    for (const auto& info : *group)
+      cube.add_scenario(info, merged[info.name]);
+  return cube;
+}
+
+} // namespace minirisk
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "Date.h"
+#include "ITrade.h"
+#include "RiskCube.h"
+
+namespace minirisk {
+
+// inputs shared by all the worker processes
+struct shard_inputs_t {
+  std::string portfolio_file;
+  std::string risk_factors_file;
+  std::string fixing_path;  // optional
+  std::string base_ccy;
+  Date today;
+};
+
+// relative cost of pricing a trade, used to balance the shards
+double estimate_cost(const ITrade& trade, const Date& today);
+
+// Partition trades in n_shards groups of similar total cost, assigning the
+// most expensive trades first to the least loaded shard. The indices of
+// each shard are sorted.
+std::vector<std::vector<size_t>> partition_by_cost(
+    const std::vector<double>& costs, size_t n_shards);
+
+// Computes PV, bucketed and parallel PV01 and FX delta of a portfolio in
+// n_shards worker processes, each loading only its own trades and building
+// its own market from the same inputs. The results are merged in the
+// original trade order and in the same scenario order as a single process
+// run. A shard which only sees some currencies does not produce the PV01
+// rows of the others, where its trades have a zero sensitivity (or the
+// error of their PV).
+//
+// A worker which crashes or fails only affects its own trades, which are
+// reported in error.
+RiskCube run_sharded(const shard_inputs_t& inputs, size_t n_shards);
+
+} // namespace minirisk
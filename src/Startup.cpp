@@ -0,0 +1,97 @@
+#include "Startup.h"
+
+#include <future>
+
+#include "AsyncMarketData.h"
+#include "Instrumentation.h"
+#include "MarketSnapshot.h"
+#include "PortfolioUtils.h"
+#include "ThreadPool.h"
+
+namespace minirisk {
+
+startup_t start_up(const startup_inputs_t& inputs, ThreadPool& pool) {
+  INSTR_SCOPE("start_up");
+  MYASSERT(inputs.risk_factors_file.empty() != inputs.snapshot_file.empty(),
+      "Either a risk factors file or a market snapshot is needed");
+
+  // market data and fixings load in the background, the snapshot is mapped
+  // once for both
+  std::shared_ptr<const MarketSnapshot> snapshot;
+  if (!inputs.snapshot_file.empty())
+    snapshot.reset(new MarketSnapshot(inputs.snapshot_file));
+  auto mkt_future = pool.async([&inputs, snapshot] {
+      std::shared_ptr<const MarketDataServer> mds(snapshot
+          ? new MarketDataServer(snapshot)
+          : new MarketDataServer(inputs.risk_factors_file));
+      return std::make_pair(mds,
+          std::unique_ptr<Market>(new Market(mds, inputs.today))); });
+  auto fds_future = pool.async([&inputs, snapshot] {
+      std::shared_ptr<const FixingDataServer> fds;
+      if (snapshot)
+        fds.reset(new FixingDataServer(snapshot));
+      else if (!inputs.fixing_path.empty())
+        fds.reset(new FixingDataServer(inputs.fixing_path));
+      return fds; });
+
+  // meanwhile the trades are read here, and their pricers created in the
+  // background by chunks
+  startup_t res;
+  std::vector<std::future<std::vector<ppricer_t>>> pricer_futures;
+  try {
+    string file = inputs.portfolio_file;
+    if (!inputs.round_trip_file.empty()) {
+      save_portfolio(inputs.round_trip_file, load_portfolio(file));
+      file = inputs.round_trip_file;
+    }
+    load_portfolio_chunks(file, inputs.chunk_size,
+        [&](size_t, portfolio_t&& chunk) {
+          auto trades = std::make_shared<portfolio_t>(std::move(chunk));
+          res.portfolio.insert(res.portfolio.end(), trades->begin(), trades->end());
+          const string& base_ccy = inputs.base_ccy;
+          pricer_futures.push_back(pool.async([trades, &base_ccy] {
+              return get_pricers(*trades, base_ccy); }));
+        });
+  } catch (...) {
+    // the tasks refer to the inputs
+    for (auto& f : pricer_futures)
+      f.wait();
+    mkt_future.wait();
+    fds_future.wait();
+    throw;
+  }
+
+  // the futures are all waited for before the first error is rethrown
+  std::exception_ptr error;
+  auto collect = [&error](auto& f) {
+    decltype(f.get()) value;
+    try {
+      value = f.get();
+    } catch (...) {
+      if (!error)
+        error = std::current_exception();
+    }
+    return value;
+  };
+  res.pricers.reserve(res.portfolio.size());
+  for (auto& f : pricer_futures) {
+    auto chunk = collect(f);
+    res.pricers.insert(res.pricers.end(), chunk.begin(), chunk.end());
+  }
+  auto mkt = collect(mkt_future);
+  res.mds = mkt.first;
+  res.mkt = std::move(mkt.second);
+  res.fds = collect(fds_future);
+  if (error)
+    std::rethrow_exception(error);
+
+  auto requirements = get_requirements(res.pricers, inputs.today, res.fds.get());
+  std::unique_ptr<AsyncMarketData> async;
+  if (inputs.mds_latency.count() > 0)
+    async.reset(new AsyncMarketData(mkt.first, inputs.mds_latency));
+  res.missing = res.mkt->prefetch(requirements, res.fds.get(), async.get());
+  res.mkt->build_curves(requirements, pool);
+  return res;
+}
+
+} // namespace minirisk
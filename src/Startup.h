@@ -0,0 +1,53 @@
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Date.h"
+#include "FixingDataServer.h"
+#include "IPricer.h"
+#include "ITrade.h"
+#include "Market.h"
+
+namespace minirisk {
+
+struct ThreadPool;
+
+// inputs of a risk run
+struct startup_inputs_t {
+  std::string portfolio_file;
+  std::string risk_factors_file;  // or
+  std::string snapshot_file;      // published by DemoPublishSnapshot
+  std::string fixing_path;        // optional
+  std::string base_ccy;
+  Date today;
+  // if set, the portfolio is saved there and reloaded, to test round trip
+  // serialization
+  std::string round_trip_file;
+  size_t chunk_size = 1024;       // trades per pricer creation task
+  // if set, the market data is prefetched through an AsyncMarketData with
+  // this latency, to simulate a remote server
+  std::chrono::microseconds mds_latency{0};
+};
+
+// everything needed to price, ready
+struct startup_t {
+  portfolio_t portfolio;
+  std::vector<ppricer_t> pricers;
+  std::shared_ptr<const MarketDataServer> mds;
+  std::shared_ptr<const FixingDataServer> fds;
+  std::unique_ptr<Market> mkt;       // prefetched, curves built
+  std::vector<std::string> missing;  // market data, see Market::prefetch
+};
+
+// Loads the portfolio, the market data and the fixings concurrently on the
+// pool. Pricers are created in chunks as the trades are read, and the
+// market is built as soon as its data is loaded. The curves required by the
+// pricers are then built concurrently (see Market::build_curves), so that
+// the startup takes about as long as the slowest input. Errors loading any
+// input are thrown once all the tasks are finished.
+startup_t start_up(const startup_inputs_t& inputs, ThreadPool& pool);
+
+} // namespace minirisk
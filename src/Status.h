@@ -0,0 +1,57 @@
+#pragma once
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+
+#include "Macros.h"
+
+namespace minirisk {
+
+enum class status_code_t {
+  ok,
+  expired,              // date before the anchor date of a curve
+  beyond_last_tenor,    // date after the last node of a curve
+  missing_fixing,
+  missing_fx_rate,
+  missing_data
+};
+
+// Outcome of an operation which is expected to fail in the normal course of
+// pricing (expired trades, missing fixings or rates). Unlike MYASSERT it does
+// not throw, and the error message is only formatted if somebody asks for it.
+struct Status {
+  Status() : m_code(status_code_t::ok) {}
+
+  // fmt is a callable returning the error message
+  template <typename F>
+  Status(status_code_t code, F&& fmt)
+    : m_code(code), m_fmt(std::forward<F>(fmt)) {}
+
+  bool ok() const { return m_code == status_code_t::ok; }
+
+  status_code_t code() const { return m_code; }
+
+  std::string message() const { return ok() ? std::string() : m_fmt(); }
+
+  // throw the same exception MYASSERT would
+  void check() const {
+    if (!ok()) {
+      INSTR_COUNT(::minirisk::instr::exception_thrown);
+      throw std::invalid_argument(message());
+    }
+  }
+
+ private:
+  status_code_t m_code;
+  std::function<std::string()> m_fmt;
+};
+
+} // namespace minirisk
+
+// Returns an error status from the enclosing function. The message uses the
+// same stream syntax as MYASSERT, and is evaluated lazily, hence all
+// variables it refers to are captured by value. Data members should be bound
+// to local references first, so that they are copied rather than this.
+#define RETURN_ERROR(code, msg) \
+    return ::minirisk::Status(code, [=]() { BUILDMSG(msg); return str; })
@@ -24,12 +24,21 @@ const char separator = ';';
 struct my_ofstream
 {
     my_ofstream(const string& fn)
-        : m_of(fn)
+        : m_file(fn)
+        , m_of(m_file.rdbuf())
     {
     }
-    void endl() { m_of << std::endl; }
-    void close() { m_of.close(); }
-    std::ofstream m_of;
+    // write to memory, the content is returned by str()
+    my_ofstream()
+        : m_of(m_mem.rdbuf())
+    {
+    }
+    void endl() { m_of << '\n'; }  // no flush, files can be large
+    void close() { m_file.close(); }
+    string str() const { return m_mem.str(); }
+    std::ofstream m_file;
+    std::ostringstream m_mem;
+    std::ostream m_of;
 };
 
 struct my_ifstream
@@ -0,0 +1,90 @@
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Arena.h"
+#include "Macros.h"
+#include "Market.h"
+#include "PortfolioUtils.h"
+
+using namespace minirisk;
+
+struct counted_t {
+  explicit counted_t(int& n) : m_n(n) { ++m_n; }
+  ~counted_t() { --m_n; }
+  int& m_n;
+  std::string m_name = "a string longer than the small string buffer";
+};
+
+void test_allocate() {
+  Arena arena(64);
+  for (size_t align : {1, 2, 8, 16}) {
+    void *p = arena.allocate(3, align);
+    MYASSERT(reinterpret_cast<uintptr_t>(p) % align == 0,
+        "Misaligned allocation");
+  }
+  MYASSERT(arena.n_blocks() == 1, "Small allocations must share a block");
+  // larger than a block
+  char *big = static_cast<char *>(arena.allocate(1000, 8));
+  big[999] = 1;
+  MYASSERT(arena.n_blocks() == 2 && arena.bytes_reserved() >= 1064,
+      "Wrong blocks");
+  MYASSERT(arena.bytes_used() == 1012, "Wrong bytes used");
+
+  std::shared_ptr<Arena> shared(new Arena(16));
+  std::vector<double, ArenaAllocator<double>> v{ArenaAllocator<double>(shared)};
+  for (int i = 0; i < 1000; ++i)
+    v.push_back(i);
+  MYASSERT(v[999] == 999, "Wrong vector content");
+}
+
+// objects are destroyed normally, and the arena lives as long as them
+void test_shared() {
+  int n = 0;
+  std::shared_ptr<counted_t> a, b;
+  {
+    ScenarioArena arena;
+    a = make_in_arena<counted_t>(arena.get(), n);
+    b = make_in_arena<counted_t>(arena.get(), n);
+    ScenarioArena copy(arena);
+    MYASSERT(copy.get() != arena.get(), "A copy must start a new arena");
+    MYASSERT(arena.get().use_count() == 3, "Objects must share the arena");
+  }
+  MYASSERT(n == 2 && a->m_name == b->m_name, "Objects destroyed too early");
+  a.reset();
+  b.reset();
+  MYASSERT(n == 0, "Objects not destroyed");
+  MYASSERT(make_in_arena<counted_t>(nullptr, n)->m_n == 1, "Heap fallback");
+}
+
+// trades and pricers are allocated in one arena per load
+void test_portfolio() {
+  auto portfolio = load_portfolio("../data/portfolio_11.txt");
+  auto pricers = get_pricers(portfolio, "USD");
+  MYASSERT(!portfolio.empty() && pricers.size() == portfolio.size(),
+      "Wrong number of pricers");
+  // pricers copy what they need, the trades can be released before them
+  portfolio.clear();
+  std::shared_ptr<const MarketDataServer> mds(
+      new MarketDataServer("../data/risk_factors_5.txt"));
+  std::shared_ptr<const FixingDataServer> fds(
+      new FixingDataServer("../data/fixings.txt"));
+  Market mkt(mds, Date(2017,8,5));
+  auto prices = compute_prices(pricers, mkt, fds);
+  MYASSERT(prices.size() == pricers.size(), "Wrong number of prices");
+}
+
+int main() {
+  try {
+    test_allocate();
+    test_shared();
+    test_portfolio();
+    std::cout << "SUCCESS" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+}
@@ -0,0 +1,88 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+#include "AsyncMarketData.h"
+#include "Market.h"
+#include "PortfolioGenerator.h"
+#include "PortfolioUtils.h"
+
+using namespace minirisk;
+
+void test_queries() {
+  std::shared_ptr<const MarketDataServer> mds(
+      new MarketDataServer("../data/risk_factors_5.txt"));
+  AsyncMarketData async(mds, std::chrono::milliseconds(20), 32);
+  MYASSERT(async.lookup("IR.1Y.EUR").get() == mds->lookup("IR.1Y.EUR"),
+      "Wrong lookup");
+  MYASSERT(!async.lookup("IR.1Y.XXX").get().second, "Unexpected risk factor");
+  MYASSERT(async.match("IR\\..*").get() == mds->match("IR\\..*"), "Wrong match");
+  MYASSERT(async.fetch({"FX\\..*", "IR\\.1Y\\..*"}).get()
+      == mds->fetch({"FX\\..*", "IR\\.1Y\\..*"}), "Wrong fetch");
+
+  // the queries in flight overlap
+  auto names = mds->match(".+");
+  std::vector<std::future<std::pair<double, bool>>> queries;
+  for (size_t i = 0; i < 32; ++i)
+    queries.push_back(async.lookup(names[i % names.size()]));
+  for (size_t i = 0; i < queries.size(); ++i)
+    MYASSERT(queries[i].get() == mds->lookup(names[i % names.size()]),
+        "Wrong lookup " << i);
+  MYASSERT(async.max_concurrent() > 1 && async.max_concurrent() <= 32,
+      "Queries not concurrent: " << async.max_concurrent() << " in flight");
+  MYASSERT(async.n_requests() == 36, "Wrong number of requests");
+}
+
+// prefetching through the asynchronous access gives the same market, the
+// queries of the curves in flight together
+void test_prefetch() {
+  generator_config_t cfg;
+  cfg.n_trades = 500;
+  cfg.n_ccys = 30;
+  cfg.missing_data_fraction = 0.1;
+  PortfolioGenerator gen(cfg);
+  gen.write_risk_factors("async_rf.tmp");
+  gen.write_portfolio("async_ptf.tmp", "async_fix.tmp");
+  auto pricers = get_pricers(load_portfolio("async_ptf.tmp"), "USD");
+  std::shared_ptr<const MarketDataServer> mds(
+      new MarketDataServer("async_rf.tmp"));
+  std::shared_ptr<const FixingDataServer> fds(
+      new FixingDataServer("async_fix.tmp"));
+  for (const char *f : {"async_rf.tmp", "async_ptf.tmp", "async_fix.tmp"})
+    std::remove(f);
+  auto req = get_requirements(pricers, cfg.today, fds.get());
+
+  Market expected_mkt(mds, cfg.today);
+  auto expected_missing = expected_mkt.prefetch(req, fds.get());
+  expected_mkt.disconnect();
+  auto expected = compute_prices(pricers, expected_mkt, fds);
+
+  const size_t latency_ms = 10;
+  AsyncMarketData async(mds, std::chrono::milliseconds(latency_ms));
+  Market mkt(mds, cfg.today);
+  auto missing = mkt.prefetch(req, fds.get(), &async);
+  MYASSERT(missing == expected_missing, "Wrong missing data");
+  MYASSERT(async.n_requests() > 10 && async.max_concurrent() > 1,
+      "Queries not concurrent: " << async.max_concurrent() << " of "
+      << async.n_requests() << " in flight");
+  mkt.disconnect();
+  auto prices = compute_prices(pricers, mkt, fds);
+  for (size_t i = 0; i < prices.size(); ++i)
+    MYASSERT(std::isnan(expected[i].first)
+        ? prices[i].second == expected[i].second
+        : prices[i].first == expected[i].first, "Trade " << i << " differs");
+}
+
+int main() {
+  try {
+    test_queries();
+    test_prefetch();
+    std::cout << "SUCCESS" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+}
@@ -0,0 +1,130 @@
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+#include "Market.h"
+#include "MemoryReport.h"
+#include "PortfolioGenerator.h"
+#include "PortfolioUtils.h"
+
+using namespace minirisk;
+
+const Date today(2017,8,5);
+
+std::shared_ptr<const MarketDataServer> mds() {
+  static std::shared_ptr<const MarketDataServer> res(
+      new MarketDataServer("../data/risk_factors_5.txt"));
+  return res;
+}
+
+void test_lru() {
+  Market mkt(mds(), today);
+  auto eur = mkt.get_discount_curve(ir_curve_discount_name("EUR"));
+  auto gbp = mkt.get_discount_curve(ir_curve_discount_name("GBP"));
+  const size_t two = eur->memory_size() + gbp->memory_size();
+  MYASSERT(mkt.curve_bytes() == two, "Wrong curve bytes " << mkt.curve_bytes());
+
+  mkt.set_curve_budget(two);
+  MYASSERT(mkt.curve_bytes() == two, "Curves evicted within the budget");
+  // EUR used last, GBP is evicted
+  MYASSERT(mkt.get_discount_curve(ir_curve_discount_name("EUR")) == eur,
+      "Curve not cached");
+  auto usd = mkt.get_discount_curve(ir_curve_discount_name("USD"));
+  MYASSERT(mkt.curve_bytes() <= two, "Budget exceeded");
+  MYASSERT(mkt.get_discount_curve(ir_curve_discount_name("EUR")) == eur,
+      "Most recently used curve evicted");
+  auto gbp2 = mkt.get_discount_curve(ir_curve_discount_name("GBP"));
+  MYASSERT(gbp2 != gbp, "Least recently used curve not evicted");
+  double a, b;
+  MYASSERT(gbp->try_df(Date(2018,8,5), a).ok()
+      && gbp2->try_df(Date(2018,8,5), b).ok() && a == b, "Rebuilt curve differs");
+
+  // a curve larger than the budget is still cached alone
+  mkt.set_curve_budget(1);
+  MYASSERT(mkt.curve_bytes() == gbp2->memory_size(), "Wrong eviction");
+  mkt.clear();
+  MYASSERT(mkt.curve_bytes() == 0, "Curves not cleared");
+
+  // dependencies are recorded even if the curve is evicted at once
+  mkt.begin_recording();
+  mkt.get_discount_curve(ir_curve_discount_name("EUR"));
+  mkt.get_discount_curve(ir_curve_discount_name("GBP"));
+  auto deps = mkt.end_recording();
+  MYASSERT(deps.count("IR.1Y.EUR") && deps.count("IR.1Y.GBP"),
+      "Dependencies not recorded");
+}
+
+// a bounded cache prices like an unbounded one
+void test_budget() {
+  generator_config_t cfg;
+  cfg.n_trades = 1000;
+  cfg.n_ccys = 20;
+  PortfolioGenerator gen(cfg);
+  gen.write_risk_factors("cache_rf.tmp");
+  gen.write_portfolio("cache_ptf.tmp", "cache_fix.tmp");
+  auto portfolio = load_portfolio("cache_ptf.tmp");
+  auto pricers = get_pricers(portfolio, "USD");
+  std::shared_ptr<const MarketDataServer> mds(
+      new MarketDataServer("cache_rf.tmp"));
+  std::shared_ptr<const FixingDataServer> fds(
+      new FixingDataServer("cache_fix.tmp"));
+  for (const char *f : {"cache_rf.tmp", "cache_ptf.tmp", "cache_fix.tmp"})
+    std::remove(f);
+
+  Market unbounded(mds, cfg.today);
+  auto expected = compute_prices(pricers, unbounded, fds);
+  Market bounded(mds, cfg.today);
+  const size_t budget = unbounded.curve_bytes() / 10;
+  bounded.set_curve_budget(budget);
+  auto prices = compute_prices(pricers, bounded, fds);
+  for (size_t i = 0; i < prices.size(); ++i)
+    MYASSERT(std::isnan(expected[i].first)
+        ? prices[i].second == expected[i].second
+        : prices[i].first == expected[i].first, "Trade " << i << " differs");
+  MYASSERT(bounded.curve_bytes() <= budget, "Budget exceeded");
+
+  memory_report_t report;
+  memory_report(portfolio, pricers, report);
+  unbounded.memory_report(report);
+  MYASSERT(report.entries.size() == 6, "Wrong subsystems");
+  for (const auto& e : report.entries)
+    MYASSERT(e.second > 0, "No memory reported for " << e.first);
+  MYASSERT(report.entries[0].first == "trades"
+      && report.entries[0].second >= portfolio.size() * sizeof(double),
+      "Wrong trades memory");
+  MYASSERT(report.entries[2].first == "curves"
+      && report.entries[2].second == unbounded.curve_bytes(), "Wrong curves");
+}
+
+// curves rebuilt after updates do not grow the arena
+void test_updates() {
+  Market mkt(mds(), today);
+  auto pricers = get_pricers(load_portfolio("../data/portfolio_11.txt"), "USD");
+  compute_prices(pricers, mkt, nullptr);
+  const size_t arena = mkt.arena_bytes();
+  MYASSERT(arena > 0, "Curves not in the arena");
+  const double rate = mkt.get_risk_factors("IR.1Y.EUR")[0].second;
+  for (int i = 0; i < 10000; ++i) {
+    mkt.update_risk_factors({{"IR.1Y.EUR", rate + (i % 2) * 0.0001}});
+    compute_prices(pricers, mkt, nullptr);
+  }
+  MYASSERT(mkt.arena_bytes() == arena,
+      "Arena grew from " << arena << " to " << mkt.arena_bytes());
+  mkt.clear();
+  compute_prices(pricers, mkt, nullptr);
+  MYASSERT(mkt.arena_bytes() > 0, "Curves not in the arena after clear");
+}
+
+int main() {
+  try {
+    test_lru();
+    test_budget();
+    test_updates();
+    std::cout << "SUCCESS" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+}
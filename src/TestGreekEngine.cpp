@@ -0,0 +1,129 @@
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+#include "GreekEngine.h"
+#include "Macros.h"
+#include "Market.h"
+#include "PortfolioUtils.h"
+#include "TestUtils.h"
+
+using namespace minirisk;
+
+const Date today(2017,8,5);
+
+size_t find_row(const RiskCube& cube, const string& name) {
+  for (size_t s = 0; s < cube.n_scenarios(); ++s)
+    if (cube.scenario(s).name == name)
+      return s;
+  THROW("Row not found: " << name);
+}
+
+// the default configuration gives the greeks of DemoRisk
+void test_default(std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds) {
+  auto pricers = get_pricers(load_portfolio("../data/portfolio_11.txt"), "USD");
+  Market mkt(mds, today);
+  auto prices = compute_prices(pricers, mkt, fds);
+  RiskCube expected(pricers.size()), cube(pricers.size());
+  compute_pv01_bucketed(pricers, mkt, fds, expected, &prices);
+  compute_pv01_parallel(pricers, mkt, fds, expected, &prices);
+  compute_fx_delta(pricers, mkt, fds, expected, &prices);
+  compute_greeks(pricers, mkt, fds, default_greek_config(), cube, &prices);
+  MYASSERT(cube.n_scenarios() == expected.n_scenarios(), "Wrong rows");
+  for (size_t s = 0; s < cube.n_scenarios(); ++s) {
+    MYASSERT(cube.scenario(s).name == expected.scenario(s).name
+        && cube.scenario(s).risk_factors == expected.scenario(s).risk_factors
+        && same(cube, s, expected, s),
+        "Row " << expected.scenario(s).name << " differs");
+  }
+}
+
+// one-sided schemes, gammas and cross gammas of payments, whose PV is
+// amount * df(T) * spot
+void test_schemes(std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds) {
+  auto pricers = get_pricers(portfolio_t{
+      payment("EUR", 1000000.0, Date(2019,8,5)),
+      payment("USD", -500000.0, Date(2018,2,5)),
+      payment("JPY", 1000.0, Date(2017,8,4))}, "USD");
+  Market mkt(mds, today);
+  std::istringstream is(
+      "# class bump size scheme\n"
+      "ir_parallel absolute 0.0001 forward gamma\n"
+      "\n"
+      "fx_spot relative 0.001 backward gamma\n"
+      "cross IR.EUR FX.SPOT.EUR\n");
+  greek_config_t config = parse_greek_config(is);
+  MYASSERT(config.classes.size() == 2 && config.cross_gammas.size() == 1
+      && config.classes[1].scheme == bump_scheme_t::backward
+      && config.classes[1].gamma, "Wrong configuration");
+  RiskCube cube(pricers.size());
+  compute_greeks(pricers, mkt, fds, config, cube);
+
+  RiskCube central(pricers.size());
+  auto prices = compute_prices(pricers, mkt, fds);
+  compute_greeks(pricers, mkt, fds, default_greek_config(), central, &prices);
+  const size_t pv01 = find_row(cube, "PV01 parallel IR.EUR");
+  const size_t delta = find_row(cube, "FX delta FX.SPOT.EUR");
+  const double pv01_central =
+    central.row(find_row(central, "PV01 parallel IR.EUR"))[0];
+  const double delta_central =
+    central.row(find_row(central, "FX delta FX.SPOT.EUR"))[0];
+  // one-sided differences are first order accurate, exact for the spot
+  MYASSERT(std::fabs(cube.row(pv01)[0] / pv01_central - 1) < 1e-3,
+      "Wrong forward PV01 " << cube.row(pv01)[0] << " " << pv01_central);
+  MYASSERT(std::fabs(cube.row(delta)[0] / delta_central - 1) < 1e-9,
+      "Wrong backward fx delta " << cube.row(delta)[0] << " " << delta_central);
+  MYASSERT(cube.row(pv01)[1] == 0.0 && cube.row(delta)[1] == 0.0,
+      "USD payment sensitive to EUR");
+
+  // linear in the spot, convex in the rates
+  const size_t ir_gamma = find_row(cube, "Gamma IR.EUR");
+  const size_t fx_gamma = find_row(cube, "Gamma FX.SPOT.EUR");
+  MYASSERT(cube.scenario(ir_gamma).measure == measure_t::gamma
+      && cube.row(ir_gamma)[0] > 0.0, "Wrong IR gamma");
+  MYASSERT(std::fabs(cube.row(fx_gamma)[0]) < 1e-6 * delta_central,
+      "Wrong fx gamma " << cube.row(fx_gamma)[0]);
+  const size_t cross = find_row(cube, "Cross gamma IR.EUR FX.SPOT.EUR");
+  const double spot = mkt.get_risk_factors(fx_spot_prefix + "EUR")[0].second;
+  MYASSERT(std::fabs(cube.row(cross)[0] * spot / pv01_central - 1) < 1e-2,
+      "Wrong cross gamma " << cube.row(cross)[0] * spot << " " << pv01_central);
+
+  // expired: all the greeks report the error of the revaluations
+  MYASSERT(std::isnan(cube.row(cross)[2]) && cube.error(cross, 2)
+      && std::isnan(cube.row(pv01)[2]), "Expired payment has greeks");
+}
+
+void test_invalid() {
+  for (const char *text : {"ir_tenor absolute 0.0001\n",
+      "ir_curve absolute 0.0001 central\n",
+      "fx_spot relative 0.001 central gama\n", "cross IR.EUR\n"}) {
+    std::istringstream is(text);
+    bool thrown = false;
+    try {
+      parse_greek_config(is);
+    } catch (const std::exception&) {
+      thrown = true;
+    }
+    MYASSERT(thrown, "Invalid configuration accepted: " << text);
+  }
+}
+
+int main() {
+  try {
+    std::shared_ptr<const MarketDataServer> mds(
+        new MarketDataServer("../data/risk_factors_5.txt"));
+    std::shared_ptr<const FixingDataServer> fds(
+        new FixingDataServer("../data/fixings.txt"));
+    test_default(mds, fds);
+    test_schemes(mds, fds);
+    test_invalid();
+    std::cout << "SUCCESS" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+}
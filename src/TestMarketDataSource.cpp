@@ -0,0 +1,133 @@
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "MarketDataSource.h"
+#include "PricingServer.h"
+
+using namespace minirisk;
+
+const char *rf_file = "source_rf.tmp";
+const char *fixing_file = "source_fix.tmp";
+
+// the risk factors of the test data, with the EUR spot rate replaced
+void write_risk_factors(double eur) {
+  std::ifstream in("../data/risk_factors_5.txt");
+  std::ofstream out(rf_file);
+  for (string line; std::getline(in, line); ) {
+    if (line.compare(0, 12, "FX.SPOT.EUR ") == 0)
+      out << "FX.SPOT.EUR " << eur << "\n";
+    else
+      out << line << "\n";
+  }
+}
+
+void test_reload() {
+  write_risk_factors(1.1);
+  std::ofstream(fixing_file) << "FX.SPOT.EUR.USD 20170805 1.1\n";
+  MarketDataSource source(rf_file, fixing_file);
+  auto v1 = source.current();
+  MYASSERT(v1->version == 1 && v1->mds->get("FX.SPOT.EUR") == 1.1,
+      "Wrong initial version");
+  Market mkt(v1->mds, Date(2017,8,5));
+
+  write_risk_factors(1.2);
+  std::ofstream(fixing_file) << "FX.SPOT.EUR.USD 20170805 1.2\n";
+  MYASSERT(source.reload() == 2, "Wrong version");
+  auto v2 = source.current();
+  MYASSERT(v2->mds->get("FX.SPOT.EUR") == 1.2
+      && v2->fds->get("FX.SPOT.EUR.USD", Date(2017,8,5)) == 1.2,
+      "Reload not visible");
+  // the previous version is unchanged for its readers
+  MYASSERT(v1->mds->get("FX.SPOT.EUR") == 1.1
+      && v1->fds->get("FX.SPOT.EUR.USD", Date(2017,8,5)) == 1.1
+      && mkt.get_fx_spot("EUR", "USD") == 1.1, "Old version modified");
+
+  // a failed reload keeps the current version
+  std::remove(rf_file);
+  bool thrown = false;
+  try {
+    source.reload();
+  } catch (const std::exception&) {
+    thrown = true;
+  }
+  MYASSERT(thrown && source.current() == v2, "Failed reload published");
+
+  MarketDataSource fixed(v2->mds, v2->fds);
+  thrown = false;
+  try {
+    fixed.reload();
+  } catch (const std::exception&) {
+    thrown = true;
+  }
+  MYASSERT(thrown, "Fixed data reloaded");
+}
+
+// readers always see consistent versions while reloads go on
+void test_concurrent() {
+  write_risk_factors(1.0);
+  MarketDataSource source(rf_file, "");
+  std::atomic<bool> stop(false);
+  std::atomic<size_t> n_reads(0);
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 4; ++r) {
+    readers.emplace_back([&] {
+      uint64_t last = 0;
+      while (!stop) {
+        auto data = source.current();
+        MYASSERT(data->version >= last && data->mds->get("FX.SPOT.EUR") > 0,
+            "Inconsistent version");
+        last = data->version;
+        ++n_reads;
+      }
+    });
+  }
+  for (int i = 2; i <= 20; ++i) {
+    write_risk_factors(i);
+    MYASSERT(source.reload() == static_cast<uint64_t>(i), "Wrong version");
+  }
+  stop = true;
+  for (auto& t : readers)
+    t.join();
+  MYASSERT(n_reads > 0 && source.current()->mds->get("FX.SPOT.EUR") == 20,
+      "Wrong last version");
+}
+
+// the pricing server picks up the new market on request
+void test_server() {
+  write_risk_factors(1.1);
+  std::shared_ptr<MarketDataSource> source(
+      new MarketDataSource(rf_file, "../data/fixings.txt"));
+  PricingServer server(load_portfolio("../data/portfolio_11.txt"), "USD",
+      source, Date(2017,8,5));
+  pricing_request_t pv{request_type_t::pv, {}, {}};
+  auto before = server.process({pv});
+  write_risk_factors(1.3);
+  auto after = server.process({pv,
+      pricing_request_t{request_type_t::reload, {}, {}}, pv});
+  MYASSERT(after[1].first == response_status_t::ok
+      && server.market_version() == 2, "Market not reloaded");
+  MYASSERT(after[0].second == before[0].second
+      && after[2].second != before[0].second, "Wrong PV after reload");
+  std::remove(rf_file);
+}
+
+int main() {
+  try {
+    test_reload();
+    test_concurrent();
+    test_server();
+    std::remove(rf_file);
+    std::remove(fixing_file);
+    std::cout << "SUCCESS" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+}
@@ -0,0 +1,122 @@
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+#include "Market.h"
+#include "MarketSnapshot.h"
+#include "PortfolioUtils.h"
+#include "RiskCube.h"
+
+using namespace minirisk;
+
+const char *snapshot_file = "market.snapshot.tmp";
+
+RiskCube run_risk(std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds) {
+  auto pricers = get_pricers(load_portfolio("../data/portfolio_11.txt"), "GBP");
+  Market mkt(mds, Date(2017,8,5));
+  RiskCube cube(pricers.size());
+  auto prices = compute_prices(pricers, mkt, fds);
+  cube.add_scenario(
+      scenario_info_t{"PV", measure_t::pv, {}, bump_type_t::none, 0.0}, prices);
+  mkt.disconnect();
+  compute_pv01_bucketed(pricers, mkt, fds, cube, &prices);
+  compute_pv01_parallel(pricers, mkt, fds, cube, &prices);
+  compute_fx_delta(pricers, mkt, fds, cube, &prices);
+  return cube;
+}
+
+void test_lookup(const MarketSnapshot& snap, const MarketDataServer& mds,
+    const FixingDataServer& fds) {
+  auto names = mds.match(".*");
+  MYASSERT(snap.n_risk_factors() == names.size(), "Wrong number of risk factors");
+  MYASSERT(snap.match(".*") == names, "Wrong risk factor names");
+  for (const auto& name : names)
+    MYASSERT(snap.lookup(name).second && snap.lookup(name).first == mds.get(name),
+        "Wrong value of " << name);
+  MYASSERT(!snap.lookup("IR.1Y.XXX").second, "Unexpected risk factor");
+
+  MYASSERT(snap.lookup_fixing("FX.SPOT.EUR.USD", Date("20170805")).first
+      == 1.1213, "Wrong fixing");
+  MYASSERT(snap.lookup_fixing("FX.SPOT.EUR.GBP", Date("20170804")).first
+      == 0.74, "Wrong fixing");
+  MYASSERT(!snap.lookup_fixing("FX.SPOT.EUR.USD", Date("20170801")).second,
+      "Unexpected fixing");
+  size_t n = 0;
+  fds.for_each([&](const std::string& name, const Date& t, double value) {
+      MYASSERT(snap.lookup_fixing(name, t).first == value, "Wrong fixing");
+      ++n; });
+  MYASSERT(n > 0, "No fixings");
+
+  snapshot_curve_t curve;
+  MYASSERT(snap.find_curve(ir_curve_discount_name("EUR"), curve)
+      && curve.n_log_dfs > 1 && curve.log_dfs[0].first == 0.0,
+      "Curve EUR not found");
+  MYASSERT(!curve.risk_factors.empty()
+      && curve.risk_factors[0].compare(0, 3, "IR.") == 0,
+      "Wrong risk factors of curve EUR");
+  MYASSERT(!snap.find_curve(ir_curve_discount_name("XXX"), curve),
+      "Unexpected curve");
+  MYASSERT(snap.n_fx_ccys() > 1 && snap.fx_rates()[0] == 1.0,
+      "Wrong fx matrix");
+}
+
+// risk from the snapshot must be identical to risk from the files, the
+// bumped markets rebuilding their curves and fx matrix
+void test_risk(std::shared_ptr<const MarketSnapshot> snap,
+    std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds) {
+  RiskCube expected = run_risk(mds, fds);
+  RiskCube cube = run_risk(
+      std::make_shared<const MarketDataServer>(snap),
+      std::make_shared<const FixingDataServer>(snap));
+  MYASSERT(cube.n_scenarios() == expected.n_scenarios(), "Wrong shape");
+  for (size_t s = 0; s < cube.n_scenarios(); ++s) {
+    MYASSERT(cube.scenario(s).name == expected.scenario(s).name,
+        "Scenario " << s << " is " << cube.scenario(s).name);
+    for (size_t t = 0; t < cube.n_trades(); ++t) {
+      double a = cube.row(s)[t], b = expected.row(s)[t];
+      MYASSERT(std::isnan(b) ? *cube.error(s, t) == *expected.error(s, t)
+          : a == b, "Trade " << t << " differs in " << cube.scenario(s).name);
+    }
+  }
+}
+
+void test_invalid() {
+  std::FILE *f = std::fopen(snapshot_file, "wb");
+  std::fputs("not a market snapshot, but long enough to hold a header.......\n"
+      "................................................................\n"
+      "................................................................\n", f);
+  std::fclose(f);
+  bool thrown = false;
+  try {
+    MarketSnapshot snap(snapshot_file);
+  } catch (const std::exception&) {
+    thrown = true;
+  }
+  MYASSERT(thrown, "Invalid snapshot accepted");
+}
+
+int main() {
+  try {
+    std::shared_ptr<const MarketDataServer> mds(
+        new MarketDataServer("../data/risk_factors_5.txt"));
+    std::shared_ptr<const FixingDataServer> fds(
+        new FixingDataServer("../data/fixings.txt"));
+    publish_market_snapshot(snapshot_file, mds, fds.get());
+    std::shared_ptr<const MarketSnapshot> snap(
+        new MarketSnapshot(snapshot_file));
+    // the mapping outlives the file
+    std::remove(snapshot_file);
+    test_lookup(*snap, *mds, *fds);
+    test_risk(snap, mds, fds);
+    test_invalid();
+    std::remove(snapshot_file);
+    std::cout << "SUCCESS" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+}
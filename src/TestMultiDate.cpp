@@ -0,0 +1,109 @@
+#include <cmath>
+#include <iostream>
+
+#include "Macros.h"
+#include "Market.h"
+#include "MultiDate.h"
+#include "PortfolioUtils.h"
+#include "TestUtils.h"
+#include "ThreadPool.h"
+#include "TradeFXForward.h"
+
+using namespace minirisk;
+
+ptrade_t forward(const std::string& ccy1, const std::string& ccy2,
+    double strike, const Date& fixing_date, const Date& settle_date) {
+  std::shared_ptr<TradeFXForward> p(new TradeFXForward);
+  p->init(ccy1, ccy2, 1000000.0, strike, fixing_date, settle_date);
+  return p;
+}
+
+// the PV on each date is the one of a run on that date
+void test_portfolio(std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds) {
+  auto pricers = get_pricers(load_portfolio("../data/portfolio_11.txt"), "USD");
+  std::vector<Date> dates{Date(2017,8,5), Date(2017,8,4), Date(2017,9,1)};
+  ThreadPool one(1), four(4);
+  RiskCube cube = compute_pv_dates(pricers, mds, fds, dates, four);
+  RiskCube serial = compute_pv_dates(pricers, mds, fds, dates, one);
+  MYASSERT(cube.n_scenarios() == 2 * dates.size(), "Wrong number of rows");
+  MYASSERT(same(cube, serial), "Results depend on the threads");
+  for (size_t i = 0; i < dates.size(); ++i) {
+    MYASSERT(cube.scenario(i).name == "PV " + dates[i].to_string()
+        && cube.scenario(dates.size() + i).name
+          == "Theta " + dates[i].to_string()
+        && cube.scenario(dates.size() + i).measure == measure_t::theta,
+        "Wrong row " << cube.scenario(i).name);
+    Market mkt(mds, dates[i]);
+    auto prices = compute_prices(pricers, mkt, fds);
+    for (size_t t = 0; t < prices.size(); ++t) {
+      MYASSERT(std::isnan(prices[t].first)
+          ? prices[t].second == *cube.error(i, t)
+          : prices[t].first == cube.row(i)[t],
+          "Trade " << t << " differs on " << dates[i].to_string());
+    }
+  }
+}
+
+// a payment expiring, and forwards before, on and after their fixing date
+void test_transitions(std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds) {
+  portfolio_t portfolio{
+    payment("USD", 1000.0, Date(2017,8,5)),
+    payment("GBP", 1000.0, Date(2018,8,5)),
+    forward("EUR", "USD", 1.1, Date(2017,8,5), Date(2017,8,9)),
+    forward("USD", "JPY", 100.0, Date(2017,8,6), Date(2017,8,10))};
+  auto pricers = get_pricers(portfolio, "USD");
+  std::vector<Date> dates{Date(2017,8,4), Date(2017,8,5), Date(2017,8,6)};
+  ThreadPool pool(2);
+  RiskCube cube = compute_pv_dates(pricers, mds, fds, dates, pool);
+  const size_t n = dates.size();
+
+  // the payment settles on the 5th, and has no value after
+  MYASSERT(cube.row(1)[0] == 1000.0 && cube.row(n + 1)[0] == 0.0,
+      "Wrong expiring payment");
+  MYASSERT(cube.row(n)[0] == 1000.0 - cube.row(0)[0],
+      "Wrong theta before expiry");
+  MYASSERT(std::isnan(cube.row(2)[0]), "Expired payment priced");
+
+  // theta is the change of PV over one day
+  for (size_t t = 1; t < 3; ++t) {
+    for (size_t i = 0; i + 1 < n; ++i) {
+      double theta = cube.row(i + 1)[t] - cube.row(i)[t];
+      MYASSERT(std::fabs(cube.row(n + i)[t] - theta) <= 1e-9 * std::fabs(theta),
+          "Wrong theta of trade " << t << " on " << dates[i].to_string());
+    }
+  }
+  MYASSERT(cube.row(n)[1] != 0.0, "No theta of the payment");
+
+  // the EUR forward uses the forward curve, then the fixing of the 5th
+  double df = Market(mds, Date(2017,8,6))
+    .get_discount_curve(ir_curve_discount_name("USD"))->df(Date(2017,8,9));
+  MYASSERT(std::fabs(cube.row(2)[2] - 1000000.0 * df * (1.1213 - 1.1)) < 1e-6,
+      "Fixing not used after the fixing date");
+  MYASSERT(cube.row(0)[2] != cube.row(1)[2], "Fixing not used on its date");
+
+  // the USD/JPY fixing of the 6th is missing: priced from the forward curve
+  // on that day, in error on the next
+  MYASSERT(!std::isnan(cube.row(2)[3]), "Forward not priced on its fixing date");
+  MYASSERT(std::isnan(cube.row(n + 2)[3])
+      && cube.error(n + 2, 3)->find("FX.SPOT.USD.JPY") != string::npos,
+      "Missing fixing not reported");
+}
+
+int main() {
+  try {
+    std::shared_ptr<const MarketDataServer> mds(
+        new MarketDataServer("../data/risk_factors_5.txt"));
+    std::shared_ptr<const FixingDataServer> fds(
+        new FixingDataServer("../data/fixings.txt"));
+    test_portfolio(mds, fds);
+    test_transitions(mds, fds);
+    std::cout << "SUCCESS" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+}
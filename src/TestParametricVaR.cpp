@@ -0,0 +1,159 @@
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <random>
+
+#include "Macros.h"
+#include "Market.h"
+#include "ParametricVaR.h"
+#include "PortfolioUtils.h"
+#include "RiskCube.h"
+
+using namespace minirisk;
+
+const char *history_file = "history.tmp";
+
+bool close(double a, double b) {
+  return std::fabs(a - b) <= 1e-9 * (1 + std::fabs(b));
+}
+
+void test_kernels() {
+  MYASSERT(std::fabs(normal_quantile(0.99) - 2.3263478740408408) < 1e-12
+      && std::fabs(normal_quantile(0.5)) < 1e-12
+      && close(normal_quantile(0.05), -normal_quantile(0.95)),
+      "Wrong normal quantile");
+  // across several tiles, with rows left over
+  const size_t rows = 37, cols = 1030;
+  std::mt19937 gen(42);
+  std::uniform_real_distribution<double> u(-1.0, 1.0);
+  std::vector<double> a(rows * cols), x(cols), z(rows), y(rows), yt(cols);
+  for (auto& v : a) v = u(gen);
+  for (auto& v : x) v = u(gen);
+  for (auto& v : z) v = u(gen);
+  gemv(a.data(), rows, cols, x.data(), y.data());
+  gemv_t(a.data(), rows, cols, z.data(), yt.data());
+  for (size_t i = 0; i < rows; ++i) {
+    double e = 0;
+    for (size_t j = 0; j < cols; ++j)
+      e += a[i * cols + j] * x[j];
+    MYASSERT(close(y[i], e), "Wrong gemv");
+  }
+  for (size_t j = 0; j < cols; ++j) {
+    double e = 0;
+    for (size_t i = 0; i < rows; ++i)
+      e += a[i * cols + j] * z[i];
+    MYASSERT(close(yt[j], e), "Wrong gemv_t");
+  }
+}
+
+// changes of A: 1, 2, 3, of B: -1, -2, -3, the date without B is skipped
+void test_covariance() {
+  std::ofstream os(history_file);
+  os << "IR.EUR 20170801 1\nIR.EUR 20170802 2\nIR.EUR 20170803 4\n"
+     << "IR.EUR 20170804 7\nIR.EUR 20170730 100\n"
+     << "FX.SPOT.EUR 20170801 0\nFX.SPOT.EUR 20170802 -1\n"
+     << "FX.SPOT.EUR 20170803 -3\nFX.SPOT.EUR 20170804 -6\n"
+     << "IR.USD 20170801 5\n";
+  os.close();
+  FixingDataServer history(history_file);
+  std::remove(history_file);
+  auto cov = estimate_covariance(history, {"IR.EUR", "FX.SPOT.EUR"});
+  MYASSERT(cov.n_changes == 3 && cov.matrix.size() == 4, "Wrong shape");
+  MYASSERT(close(cov.matrix[0], 1.0) && close(cov.matrix[1], -1.0)
+      && close(cov.matrix[2], -1.0) && close(cov.matrix[3], 1.0),
+      "Wrong covariance");
+  bool thrown = false;
+  try {
+    estimate_covariance(history, {"IR.EUR", "IR.GBP"});
+  } catch (const std::exception&) {
+    thrown = true;
+  }
+  MYASSERT(thrown, "Risk factor without history accepted");
+}
+
+// the components add up to the VaR, trades in error are left out
+void test_var() {
+  covariance_t cov{{"IR.1Y.EUR", "FX.SPOT.EUR", "IR.1Y.USD"},
+    {4.0, 1.0, 0.5, 1.0, 9.0, 0.0, 0.5, 0.0, 1.0}, 10};
+  RiskCube cube(4);
+  cube.add_scenario(scenario_info_t{"PV", measure_t::pv, {},
+      bump_type_t::none, 0.0}, {{1, ""}, {2, ""}, {3, ""}, {4, ""}});
+  cube.add_scenario(scenario_info_t{"d1", measure_t::pv01_bucketed,
+      {"IR.1Y.EUR"}, bump_type_t::absolute, 0.0001},
+      {{1, ""}, {-2, ""}, {0.5, ""}, {9, ""}});
+  cube.add_scenario(scenario_info_t{"d2", measure_t::fx_delta,
+      {"FX.SPOT.EUR"}, bump_type_t::relative, 0.001},
+      {{3, ""}, {1, ""}, {-1, ""}, {nan<double>(), "failed"}});
+  cube.add_scenario(scenario_info_t{"d3", measure_t::pv01_bucketed,
+      {"IR.1Y.JPY"}, bump_type_t::absolute, 0.0001},
+      {{100, ""}, {100, ""}, {100, ""}, {100, ""}});
+  auto var = compute_parametric_var(cube, cov, 0.99, 4.0);
+
+  // p = (-0.5, 3, 0), C p = (1, 26.5, -0.25), p'Cp = 79
+  const double z = normal_quantile(0.99);
+  MYASSERT(close(var.var, z * 2.0 * std::sqrt(79.0)), "Wrong VaR " << var.var);
+  MYASSERT(close(var.marginal[1], z * 2.0 * 26.5 / std::sqrt(79.0)),
+      "Wrong marginal VaR");
+  MYASSERT(std::isnan(var.component[3].first)
+      && var.component[3].second == "failed", "Trade in error not reported");
+  double sum = 0;
+  for (size_t t = 0; t < 3; ++t)
+    sum += var.component[t].first;
+  MYASSERT(close(sum, var.var), "Components add up to " << sum);
+  MYASSERT(close(var.component[0].first,
+      (1 * var.marginal[0] + 3 * var.marginal[1])), "Wrong component");
+  MYASSERT(var.ccys == std::vector<std::string>({"EUR", "USD"})
+      && close(var.ccy_component[0] + var.ccy_component[1], var.var)
+      && close(var.ccy_standalone[0], z * 2.0 * std::sqrt(79.0))
+      && var.ccy_standalone[1] == 0.0, "Wrong VaR by currency");
+}
+
+// from the greeks of a portfolio and a history of its risk factors
+void test_portfolio() {
+  std::shared_ptr<const MarketDataServer> mds(
+      new MarketDataServer("../data/risk_factors_5.txt"));
+  std::shared_ptr<const FixingDataServer> fds(
+      new FixingDataServer("../data/fixings.txt"));
+  auto pricers = get_pricers(load_portfolio("../data/portfolio_11.txt"), "USD");
+  Market mkt(mds, Date(2017,8,5));
+  auto prices = compute_prices(pricers, mkt, fds);
+  RiskCube cube(pricers.size());
+  compute_pv01_bucketed(pricers, mkt, fds, cube, &prices);
+  compute_fx_delta(pricers, mkt, fds, cube, &prices);
+  auto names = sensitivity_risk_factors(cube);
+  MYASSERT(names.size() == cube.n_scenarios(), "Wrong risk factors");
+
+  auto cov = estimate_covariance(
+      FixingDataServer("../data/risk_factor_history_5.txt"), names);
+  auto var = compute_parametric_var(cube, cov);
+  MYASSERT(var.var > 0, "No VaR");
+  double sum = 0;
+  for (const auto& c : var.component)
+    if (!std::isnan(c.first))
+      sum += c.first;
+  MYASSERT(std::fabs(sum - var.var) <= 1e-9 * var.var, "Wrong components");
+  double sum_ccy = 0, max_standalone = 0;
+  for (size_t c = 0; c < var.ccys.size(); ++c) {
+    sum_ccy += var.ccy_component[c];
+    max_standalone = std::max(max_standalone, var.ccy_standalone[c]);
+  }
+  MYASSERT(std::fabs(sum_ccy - var.var) <= 1e-9 * var.var,
+      "Wrong components by currency");
+  MYASSERT(max_standalone > 0, "No VaR by currency");
+}
+
+int main() {
+  try {
+    test_kernels();
+    test_covariance();
+    test_var();
+    test_portfolio();
+    std::cout << "SUCCESS" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+}
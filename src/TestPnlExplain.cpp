@@ -0,0 +1,134 @@
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "Global.h"
+#include "Macros.h"
+#include "Market.h"
+#include "PnlExplain.h"
+#include "PortfolioUtils.h"
+#include "ThreadPool.h"
+#include "TradeFXForward.h"
+
+using namespace minirisk;
+
+const char *moved_file = "risk_factors.moved.tmp";
+
+// the risk factors of file, with the EUR rates up 1bp and the EUR spot
+// rate up 0.1%
+std::shared_ptr<const MarketDataServer> moved_market(const string& file) {
+  std::ifstream is(file);
+  std::ofstream os(moved_file);
+  string name;
+  double value;
+  while (is >> name >> value) {
+    if (name.compare(0, ir_rate_prefix.length(), ir_rate_prefix) == 0
+        && name.substr(name.length() - 3) == "EUR")
+      value += 0.0001;
+    else if (name == fx_spot_prefix + "EUR")
+      value *= 1.001;
+    os << name << " " << value << "\n";
+  }
+  os.close();
+  std::shared_ptr<const MarketDataServer> mds(new MarketDataServer(moved_file));
+  std::remove(moved_file);
+  return mds;
+}
+
+size_t find_row(const RiskCube& cube, const string& name) {
+  for (size_t s = 0; s < cube.n_scenarios(); ++s)
+    if (cube.scenario(s).name == name)
+      return s;
+  THROW("Row not found: " << name);
+}
+
+// the steps add up to the P&L, between the PVs in the two markets
+void test_explain(std::shared_ptr<const MarketDataServer> mds0,
+    std::shared_ptr<const FixingDataServer> fds) {
+  auto pricers = get_pricers(load_portfolio("../data/portfolio_11.txt"), "USD");
+  auto mds1 = moved_market("../data/risk_factors_5.txt");
+  const Date date0(2017,8,4), date1(2017,8,7);
+  ThreadPool pool(4);
+  RiskCube cube = explain_pnl(pricers, mds0, date0, mds1, date1, fds, pool);
+
+  Market mkt0(mds0, date0), mkt1(mds1, date1);
+  auto pv0 = compute_prices(pricers, mkt0,
+      std::make_shared<const FixingDataServer>(*fds, date0));
+  auto pv1 = compute_prices(pricers, mkt1, fds);
+  const size_t start = find_row(cube, "PV " + date0.to_string());
+  const size_t end = find_row(cube, "PV " + date1.to_string());
+  const size_t pnl = find_row(cube, "P&L");
+  const size_t ir_usd = find_row(cube, "IR USD");
+  const size_t ir_eur = find_row(cube, "IR EUR");
+  const size_t unexplained = find_row(cube, "Unexplained");
+  MYASSERT(start == 0 && end < pnl && pnl < unexplained, "Wrong rows");
+
+  size_t n_priced = 0;
+  for (size_t t = 0; t < cube.n_trades(); ++t) {
+    MYASSERT(std::isnan(pv0[t].first) ? *cube.error(start, t) == pv0[t].second
+        : cube.row(start)[t] == pv0[t].first, "Wrong start PV " << t);
+    MYASSERT(std::isnan(pv1[t].first) ? *cube.error(end, t) == pv1[t].second
+        : cube.row(end)[t] == pv1[t].first, "Wrong end PV " << t);
+    if (std::isnan(cube.row(pnl)[t])) {
+      for (size_t s = start + 1; s < cube.n_scenarios(); ++s)
+        MYASSERT(s == end || cube.error(s, t), "Trade " << t << " in error");
+      continue;
+    }
+    ++n_priced;
+    double sum = 0;
+    for (size_t s = start + 1; s < end; ++s)
+      sum += cube.row(s)[t];
+    double p = cube.row(pnl)[t];
+    MYASSERT(std::fabs(sum - p) <= 1e-9 * (1 + std::fabs(p)),
+        "The steps of trade " << t << " add up to " << sum << ", not " << p);
+    MYASSERT(cube.row(ir_usd)[t] == 0.0, "USD rates did not move");
+    // small moves: the sensitivities predict most of the P&L, unless the
+    // trade fixed in between
+    double moved = p - cube.row(1)[t] - cube.row(2)[t];
+    MYASSERT(cube.row(2)[t] != 0.0
+        || std::fabs(cube.row(unexplained)[t]) <= 0.01 * std::fabs(moved)
+        + 1e-6, "Trade " << t << " unexplained "
+        << cube.row(unexplained)[t] << " of " << moved);
+  }
+  MYASSERT(n_priced > 0, "No trades priced");
+  MYASSERT(cube.total(ir_eur).first != 0.0, "No EUR rates P&L");
+}
+
+// a forward fixing between the two dates can only be priced with the new
+// fixing, the time decay step is explained with it
+void test_fixing(std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds) {
+  std::shared_ptr<TradeFXForward> fwd(new TradeFXForward);
+  fwd->init("EUR", "USD", 1000000.0, 1.1, Date(2017,8,5), Date(2017,8,9));
+  auto pricers = get_pricers(portfolio_t{fwd}, "USD");
+  ThreadPool pool(2);
+  RiskCube cube = explain_pnl(
+      pricers, mds, Date(2017,8,4), mds, Date(2017,8,6), fds, pool);
+  const size_t pnl = find_row(cube, "P&L");
+  MYASSERT(!std::isnan(cube.row(pnl)[0]), "Forward not explained");
+  MYASSERT(cube.row(find_row(cube, "Time decay"))[0] == 0.0,
+      "Forward priced without its fixing");
+  MYASSERT(cube.row(find_row(cube, "New fixings"))[0] == cube.row(pnl)[0],
+      "Wrong fixing step");
+  MYASSERT(cube.row(find_row(cube, "FX spot"))[0] == 0.0
+      && cube.row(find_row(cube, "Predicted FX spot"))[0] == 0.0,
+      "The market did not move");
+}
+
+int main() {
+  try {
+    std::shared_ptr<const MarketDataServer> mds(
+        new MarketDataServer("../data/risk_factors_5.txt"));
+    std::shared_ptr<const FixingDataServer> fds(
+        new FixingDataServer("../data/fixings.txt"));
+    test_explain(mds, fds);
+    test_fixing(mds, fds);
+    std::cout << "SUCCESS" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+}
@@ -0,0 +1,90 @@
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+#include "Market.h"
+#include "PortfolioUtils.h"
+
+using namespace minirisk;
+
+// after prefetching, pricing needs no market data server and gives the same
+// prices and risk factors as fetching on demand
+void test_prefetch(std::shared_ptr<const MarketDataServer> mds) {
+  auto pricers = get_pricers(load_portfolio("../data/portfolio_11.txt"), "GBP");
+  std::shared_ptr<const FixingDataServer> fds(
+      new FixingDataServer("../data/fixings.txt"));
+  Date today(2017,8,5);
+
+  Market lazy(mds, today);
+  auto expected = compute_prices(pricers, lazy, fds);
+
+  Market mkt(mds, today);
+  auto req = get_requirements(pricers, today, fds.get());
+  MYASSERT(!req.discount_curves.empty() && !req.fx_spots.empty(),
+      "No requirements");
+  auto missing = mkt.prefetch(req, fds.get());
+  mkt.disconnect();
+  auto prices = compute_prices(pricers, mkt, fds);
+  for (size_t i = 0; i < prices.size(); ++i)
+    MYASSERT(std::isnan(expected[i].first) ? prices[i].second == expected[i].second
+        : prices[i].first == expected[i].first, "Trade " << i << " differs");
+  MYASSERT(mkt.get_risk_factors(".+") == lazy.get_risk_factors(".+"),
+      "Different risk factors");
+  // a second prefetch has nothing to fetch
+  MYASSERT(mkt.prefetch(req, fds.get()) == missing, "Different missing data");
+}
+
+// the yield of a curve with tenors is not fetched
+void test_yield() {
+  const char *file = "prefetch_rf.tmp";
+  {
+    std::ifstream is("../data/risk_factors_5.txt");
+    std::ofstream os(file);
+    os << is.rdbuf() << "IR.USD 0.03\n";
+  }
+  std::shared_ptr<const MarketDataServer> mds(new MarketDataServer(file));
+  std::remove(file);
+  test_prefetch(mds);
+  Market mkt(mds, Date(2017,8,5));
+  market_requirements_t req;
+  req.discount_curves.insert(ir_curve_discount_name("USD"));
+  mkt.prefetch(req, nullptr);
+  MYASSERT(mkt.has_risk_factor("IR.1Y.USD") && !mkt.has_risk_factor("IR.USD"),
+      "Yield fetched with the tenors");
+}
+
+void test_missing() {
+  std::shared_ptr<const MarketDataServer> mds(
+      new MarketDataServer("../data/risk_factors_5.txt"));
+  Market mkt(mds, Date(2017,8,5));
+  market_requirements_t req;
+  req.discount_curves.insert(ir_curve_discount_name("EUR"));
+  req.discount_curves.insert(ir_curve_discount_name("XXX"));
+  req.fx_fwd_curves.insert(fx_fwd_name("GBP", "YYY"));
+  req.fx_spots.insert(fx_spot_name("EUR", "USD"));
+  req.fx_spots.insert(fx_spot_name("XXX", "USD"));
+  req.fixings.insert(std::make_pair(fx_spot_name("EUR", "USD"), Date(2017,8,5)));
+  auto missing = mkt.prefetch(req, nullptr);
+  std::vector<string> expected = {"curve " + ir_curve_discount_name("XXX"),
+    "curve " + ir_curve_discount_name("YYY"), "fx rate FX.SPOT.XXX.USD",
+    "fixing FX.SPOT.EUR.USD 5-8-2017"};
+  MYASSERT(missing == expected, "Wrong missing data");
+  MYASSERT(mkt.has_risk_factor("IR.1Y.EUR") && mkt.has_risk_factor("IR.1Y.GBP"),
+      "Risk factors not fetched");
+}
+
+int main() {
+  try {
+    test_prefetch(std::shared_ptr<const MarketDataServer>(
+          new MarketDataServer("../data/risk_factors_5.txt")));
+    test_yield();
+    test_missing();
+    std::cout << "SUCCESS" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+}
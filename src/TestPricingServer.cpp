@@ -0,0 +1,194 @@
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+#include "PortfolioGenerator.h"
+#include "PricingServer.h"
+
+using namespace minirisk;
+
+const Date today(2017,8,5);
+
+void check_same(const portfolio_values_t& a, const portfolio_values_t& b) {
+  MYASSERT(a.size() == b.size(), "Wrong size");
+  for (size_t i = 0; i < a.size(); ++i)
+    MYASSERT(std::isnan(a[i].first) ? a[i].second == b[i].second
+        : a[i].first == b[i].first, "Value " << i << " differs");
+}
+
+int connect_when_started(const string& socket_path) {
+  for (int attempt = 0; ; ++attempt) {
+    try {
+      return connect_to_server(socket_path);
+    } catch (const std::exception&) {
+      MYASSERT(attempt < 100, "Server not started");
+      usleep(10000);
+    }
+  }
+}
+
+void test_protocol() {
+  pricing_request_t req{request_type_t::what_if, {1, 5},
+    {{"IR.1Y.EUR", 0.05}, {"FX.SPOT.GBP", 1.6}}};
+  auto res = decode_request(static_cast<uint32_t>(req.type),
+      encode_request(req));
+  MYASSERT(res.type == req.type && res.trades == req.trades
+      && res.overrides == req.overrides, "Request does not round trip");
+
+  // counts larger than the payload are rejected before allocating
+  for (std::string payload : {std::string("\xff\xff\xff\xff", 4),
+        std::string("\0\0\0\0\xff\xff\xff\x0f", 8)}) {
+    bool thrown = false;
+    try {
+      decode_request(static_cast<uint32_t>(request_type_t::pv), payload);
+    } catch (const std::exception&) {
+      thrown = true;
+    }
+    MYASSERT(thrown, "Truncated request accepted");
+  }
+
+  // messages are taken from the bytes received once complete
+  int sv[2];
+  MYASSERT(::socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0, "No socket pair");
+  send_message(sv[0], 7, "payload");
+  ::close(sv[0]);
+  std::string bytes;
+  char c;
+  while (::read(sv[1], &c, 1) == 1)
+    bytes += c;
+  ::close(sv[1]);
+  std::string buffer = bytes.substr(0, bytes.size() - 1);
+  uint32_t type;
+  std::string payload;
+  MYASSERT(!take_message(buffer, type, payload), "Partial message taken");
+  buffer += bytes.back() + bytes;
+  MYASSERT(take_message(buffer, type, payload) && type == 7
+      && payload == "payload" && buffer == bytes && has_message(buffer),
+      "Wrong message taken");
+
+  // lengths beyond the maximum are rejected
+  std::string huge = bytes.substr(0, 8) + std::string(8, '\xff');
+  bool thrown = false;
+  try {
+    has_message(huge);
+  } catch (const std::exception&) {
+    thrown = true;
+  }
+  MYASSERT(thrown, "Huge message accepted");
+}
+
+void test_server() {
+  std::shared_ptr<const MarketDataServer> mds(
+      new MarketDataServer("../data/risk_factors_5.txt"));
+  std::shared_ptr<const FixingDataServer> fds(
+      new FixingDataServer("../data/fixings.txt"));
+  portfolio_t portfolio = load_portfolio("../data/portfolio_11.txt");
+  auto pricers = get_pricers(portfolio, "USD");
+  Market mkt(mds, today);
+  auto expected = compute_prices(pricers, mkt, fds);
+
+  PricingServer server(portfolio, "USD", mds, fds, today);
+  MYASSERT(server.n_computed() == 1, "PV not computed at startup");
+
+  // identical requests in one batch are computed once
+  pricing_request_t what_if{request_type_t::what_if, {}, {{"IR.1Y.EUR", 0.05}}};
+  auto responses = server.process({what_if, what_if,
+      pricing_request_t{request_type_t::fx_delta, {}, {}},
+      pricing_request_t{request_type_t::fx_delta, {2}, {}},
+      pricing_request_t{request_type_t::what_if, {}, {{"NOT.FOUND", 1.0}}}});
+  MYASSERT(server.n_computed() == 4, "Requests not shared");
+  MYASSERT(responses[0].second == responses[1].second, "Different responses");
+  MYASSERT(responses[4].first == response_status_t::error,
+      "Missing risk factor not reported");
+
+  const string socket_path = "test_pricing_server.sock";
+  std::thread t([&]() { server.serve(socket_path); });
+  int fd = connect_when_started(socket_path);
+  // a client stopping in the middle of a message does not hold the others
+  int slow = connect_to_server(socket_path);
+  MYASSERT(::write(slow, "MRPC", 4) == 4, "Write failed");
+  // a request followed by an invalid header is not answered, the client
+  // gets an error and is closed, and its fd is not answered for later
+  int bad = connect_to_server(socket_path);
+  std::string bytes = encode_message(static_cast<uint32_t>(request_type_t::pv),
+      encode_request(pricing_request_t{request_type_t::pv, {}, {}}));
+  bytes += "XXXX" + std::string(12, '\0');
+  MYASSERT(::write(bad, bytes.data(), bytes.size())
+      == static_cast<ssize_t>(bytes.size()), "Write failed");
+  uint32_t status;
+  std::string payload;
+  MYASSERT(receive_message(bad, status, payload)
+      && status == static_cast<uint32_t>(response_status_t::error),
+      "Invalid header not reported");
+  MYASSERT(!receive_message(bad, status, payload), "Client not closed");
+  ::close(bad);
+  auto pv = send_request(fd, pricing_request_t{request_type_t::pv, {}, {}});
+  MYASSERT(pv.size() == 1 && pv[0].first == "PV", "Wrong PV response");
+  check_same(pv[0].second, expected);
+  auto sel = send_request(fd, pricing_request_t{request_type_t::pv, {3, 0}, {}});
+  check_same(sel[0].second, {expected[3], expected[0]});
+
+  bool failed = false;
+  try {
+    send_request(fd, pricing_request_t{request_type_t::pv, {100000}, {}});
+  } catch (const std::exception&) {
+    failed = true;
+  }
+  MYASSERT(failed, "Invalid trade index not reported");
+  ::close(slow);
+  send_request(fd, pricing_request_t{request_type_t::shutdown, {}, {}});
+  ::close(fd);
+  t.join();
+}
+
+// a client which stops reading a response larger than the socket buffers
+// does not hold the others
+void test_slow_reader() {
+  generator_config_t cfg;
+  cfg.n_trades = 100000;
+  PortfolioGenerator gen(cfg);
+  gen.write_risk_factors("server_rf.tmp");
+  gen.write_portfolio("server_ptf.tmp", "server_fix.tmp");
+  portfolio_t portfolio = load_portfolio("server_ptf.tmp");
+  std::shared_ptr<const MarketDataServer> mds(
+      new MarketDataServer("server_rf.tmp"));
+  std::shared_ptr<const FixingDataServer> fds(
+      new FixingDataServer("server_fix.tmp"));
+  for (const char *f : {"server_rf.tmp", "server_ptf.tmp", "server_fix.tmp"})
+    std::remove(f);
+  PricingServer server(portfolio, "USD", mds, fds, cfg.today);
+
+  const string socket_path = "test_pricing_server_slow.sock";
+  std::thread t([&]() { server.serve(socket_path); });
+  int fd = connect_when_started(socket_path);
+  int slow = connect_to_server(socket_path);
+  send_message(slow, static_cast<uint32_t>(request_type_t::pv),
+      encode_request(pricing_request_t{request_type_t::pv, {}, {}}));
+  usleep(100000);
+  auto pv = send_request(fd, pricing_request_t{request_type_t::pv, {}, {}});
+  MYASSERT(pv.size() == 1 && pv[0].second.size() == portfolio.size(),
+      "Wrong PV response");
+  auto sel = send_request(fd, pricing_request_t{request_type_t::pv, {7}, {}});
+  check_same(sel[0].second, {pv[0].second[7]});
+  send_request(fd, pricing_request_t{request_type_t::shutdown, {}, {}});
+  ::close(fd);
+  t.join();
+  ::close(slow);
+}
+
+int main() {
+  try {
+    test_protocol();
+    test_server();
+    test_slow_reader();
+    std::cout << "SUCCESS" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+}
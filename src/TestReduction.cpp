@@ -0,0 +1,89 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "Macros.h"
+#include "Reduction.h"
+#include "ThreadPool.h"
+
+using namespace minirisk;
+
+double exact_sum(const std::vector<double>& v) {
+  ExactSum s;
+  for (double x : v)
+    s += x;
+  return s.value();
+}
+
+void test_exact() {
+  MYASSERT(ExactSum().value() == 0.0, "Empty sum");
+  MYASSERT(exact_sum({1e16, 1.0, -1e16}) == 1.0, "Small term lost");
+  MYASSERT(exact_sum({1e100, 1.0, -1e100, 1e-100}) == 1.0, "Small term lost");
+  // correctly rounded, halfway cases round to even
+  MYASSERT(exact_sum({1.0, 1e-16, 1e-16}) == 1.0 + 2e-16, "Wrong rounding");
+  MYASSERT(exact_sum({1.0, std::ldexp(1.0, -53), std::ldexp(1.0, -105)})
+      == 1.0 + std::ldexp(1.0, -52), "Wrong rounding above halfway");
+  const double inf = std::numeric_limits<double>::infinity();
+  MYASSERT(exact_sum({1.0, inf}) == inf, "Infinity lost");
+  MYASSERT(std::isnan(exact_sum({inf, -inf})), "Wrong infinities");
+}
+
+// mixed signs and magnitudes, which a naive sum gets wrong
+std::vector<double> values(size_t n) {
+  std::mt19937_64 rng(42);
+  std::uniform_real_distribution<double> mantissa(-1.0, 1.0);
+  std::uniform_int_distribution<int> exponent(-20, 40);
+  std::vector<double> v(n);
+  for (auto& x : v)
+    x = std::ldexp(mantissa(rng), exponent(rng));
+  return v;
+}
+
+void test_order() {
+  auto v = values(20000);
+  const double expected = exact_sum(v);
+  std::mt19937 rng(7);
+  for (int i = 0; i < 5; ++i) {
+    std::shuffle(v.begin(), v.end(), rng);
+    MYASSERT(exact_sum(v) == expected, "The sum depends on the order");
+  }
+  // split and merged
+  ExactSum a, b;
+  for (size_t i = 0; i < v.size(); ++i)
+    (i % 3 ? a : b) += v[i];
+  a += b;
+  MYASSERT(a.value() == expected, "The sum depends on the split");
+  // every term taken out again
+  for (double x : v)
+    a += -x;
+  MYASSERT(a.value() == 0.0, "Terms do not cancel");
+}
+
+void test_parallel() {
+  auto v = values(100000);
+  v[10] = v[50000] = std::numeric_limits<double>::quiet_NaN();
+  const double expected = sum_valid(v.data(), v.size());
+  MYASSERT(!std::isnan(expected), "NaNs must be skipped");
+  for (size_t n_threads : {1, 3, 8}) {
+    ThreadPool pool(n_threads);
+    MYASSERT(sum_valid(v.data(), v.size(), &pool) == expected,
+        "The sum depends on the number of threads: " << n_threads);
+  }
+}
+
+int main() {
+  try {
+    test_exact();
+    test_order();
+    test_parallel();
+    std::cout << "SUCCESS" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+}
@@ -0,0 +1,148 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include "ResultWriter.h"
+
+using namespace minirisk;
+
+portfolio_values_t sample_values() {
+  portfolio_values_t values;
+  double x = 0.1;
+  for (int i = 0; i < 2000; ++i) {
+    x = x * 1.37 - std::floor(x * 1.37) + i;
+    values.push_back(std::make_pair(i % 2 ? -x : x / 3.0, ""));
+  }
+  values[7] = std::make_pair(nan<double>(), "Fixing not found: a,b");
+  values[11] = std::make_pair(nan<double>(), "Rate not \"available\"");
+  values.push_back(std::make_pair(0.0, ""));
+  values.push_back(std::make_pair(1e300, ""));
+  values.push_back(std::make_pair(-2.5e-300, ""));
+  return values;
+}
+
+std::string read_file(const std::string& filename) {
+  std::ifstream is(filename);
+  std::ostringstream os;
+  os << is.rdbuf();
+  return os.str();
+}
+
+// the text layout must be identical to the one produced with iostreams
+void test_text() {
+  const auto values = sample_values();
+  const auto& res = portfolio_total(values);
+  std::ostringstream expected;
+  expected
+      << "========================\n"
+      << "PV" << ":\n"
+      << "========================\n"
+      << "Total:  " << res.first << "\n"
+      << "Errors: " << res.second.size() << "\n"
+      << "\n========================\n";
+  for (size_t i = 0, n = values.size(); i < n; ++i)
+    if (std::isnan(values[i].first))
+      expected << std::setw(5) << i << ": " << values[i].second << "\n";
+    else
+      expected << std::setw(5) << i << ": " << values[i].first << "\n";
+  expected << "========================\n\n";
+
+  const string filename = "test_results_text.txt";
+  ResultWriter(filename, result_format_t::text).write("PV", values);
+  MYASSERT(read_file(filename) == expected.str(), "Text layout differs");
+  std::remove(filename.c_str());
+}
+
+// csv values must parse back to the same doubles
+void test_csv() {
+  const auto values = sample_values();
+  const string filename = "test_results_csv.txt";
+  ResultWriter(filename, result_format_t::csv).write("PV", values);
+  std::istringstream is(read_file(filename));
+  string line;
+  std::getline(is, line);
+  MYASSERT(line == "name,trade,value,error", "Wrong header " << line);
+  for (size_t i = 0; i < values.size(); ++i) {
+    std::getline(is, line);
+    std::string prefix = "PV," + std::to_string(i) + ",";
+    MYASSERT(line.compare(0, prefix.size(), prefix) == 0, "Wrong line " << line);
+    string rest = line.substr(prefix.size());
+    if (std::isnan(values[i].first)) {
+      MYASSERT(rest[0] == ',', "Missing error in line " << line);
+    } else {
+      MYASSERT(std::strtod(rest.c_str(), nullptr) == values[i].first,
+          "Value does not round trip: " << line);
+    }
+  }
+  MYASSERT(values[11].second.find('"') != string::npos
+      && read_file(filename).find("\"Rate not \"\"available\"\"\"")
+      != string::npos, "Error message not quoted");
+  std::remove(filename.c_str());
+
+  char buf[32];
+  MYASSERT(std::string(buf, format_shortest(0.1, buf)) == "0.1", "0.1");
+  MYASSERT(std::string(buf, format_shortest(1.0 / 3, buf))
+      == "0.3333333333333333", "1/3");
+}
+
+void test_binary() {
+  const auto values = sample_values();
+  const string filename = "test_results_bin.txt";
+  {
+    ResultWriter out(filename, result_format_t::binary);
+    out.write("PV", values);
+    out.write("PV01 bucketed IR.1W.EUR", portfolio_values_t());
+    out.write("FX delta", values);
+  }
+  const auto res = read_binary_results(filename);
+  MYASSERT(res.size() == 3, "Wrong number of vectors " << res.size());
+  MYASSERT(res[0].first == "PV" && res[1].first == "PV01 bucketed IR.1W.EUR"
+      && res[2].first == "FX delta", "Wrong names");
+  MYASSERT(res[1].second.empty(), "Vector should be empty");
+  for (size_t k : {0, 2}) {
+    MYASSERT(res[k].second.size() == values.size(), "Wrong size");
+    for (size_t i = 0; i < values.size(); ++i) {
+      const auto& v = res[k].second[i];
+      MYASSERT(std::isnan(v.first) ? std::isnan(values[i].first)
+          && v.second == values[i].second : v.first == values[i].first,
+          "Value " << i << " differs");
+    }
+  }
+  std::remove(filename.c_str());
+}
+
+// a failed write throws from flush and close, not from the destructor
+void test_errors() {
+  for (bool big : {false, true}) {
+    bool thrown = false;
+    try {
+      ResultWriter out("/dev/full", result_format_t::csv);
+      out.write("PV", big ? portfolio_values_t(100000) : sample_values());
+      out.close();
+    } catch (const std::exception&) {
+      thrown = true;
+    }
+    MYASSERT(thrown, "Write error not reported");
+  }
+  ResultWriter out("/dev/full", result_format_t::csv);
+  out.write("PV", sample_values());
+}
+
+int main() {
+  try {
+    test_text();
+    test_csv();
+    test_binary();
+    test_errors();
+    std::cout << "SUCCESS" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+}
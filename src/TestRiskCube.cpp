@@ -0,0 +1,57 @@
+#include <cmath>
+#include <iostream>
+
+#include "RiskCube.h"
+
+using namespace minirisk;
+
+void test_cube() {
+  const size_t n = 5;
+  RiskCube cube(n);
+  portfolio_values_t pv(n);
+  for (size_t t = 0; t < n; ++t)
+    pv[t] = std::make_pair(1.0 + t, "");
+  pv[3] = std::make_pair(nan<double>(), "Fixing not found");
+  portfolio_values_t delta(pv);
+  delta[1] = std::make_pair(nan<double>(), "Fixing not found");
+
+  MYASSERT(cube.add_scenario(scenario_info_t{"PV", measure_t::pv, {},
+      bump_type_t::none, 0.0}, pv) == 0, "Wrong row index");
+  MYASSERT(cube.add_scenario(scenario_info_t{"FX delta FX.SPOT.EUR",
+      measure_t::fx_delta, {"FX.SPOT.EUR"}, bump_type_t::relative, 0.001},
+      delta) == 1, "Wrong row index");
+  MYASSERT(cube.n_scenarios() == 2 && cube.n_trades() == n, "Wrong shape");
+  MYASSERT(cube.scenario(1).risk_factors[0] == "FX.SPOT.EUR", "Wrong metadata");
+
+  // error messages are interned
+  MYASSERT(cube.error(0, 0) == nullptr, "Unexpected error");
+  MYASSERT(cube.error(0, 3) == cube.error(1, 1)
+      && *cube.error(1, 3) == "Fixing not found", "Messages not interned");
+
+  // totals match portfolio_total
+  for (size_t s = 0; s < 2; ++s) {
+    auto expected = portfolio_total(cube.values(s));
+    auto res = cube.total(s);
+    MYASSERT(res.first == expected.first
+        && res.second == expected.second.size(), "Wrong total of row " << s);
+  }
+
+  trade_grouping_t g;
+  g.labels = {"EUR", "USD"};
+  g.group = {0, 1, 0, 0, 1};
+  auto agg = cube.aggregate(1, g);
+  MYASSERT(agg.size() == 2 && agg[0] == 4.0 && agg[1] == 5.0,
+      "Wrong aggregation " << agg[0] << " " << agg[1]);
+}
+
+int main() {
+  try {
+    test_cube();
+    std::cout << "SUCCESS" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+}
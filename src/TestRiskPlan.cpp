@@ -0,0 +1,211 @@
+#include <cmath>
+#include <iostream>
+#include <sstream>
+
+#include "Global.h"
+#include "GreekEngine.h"
+#include "Macros.h"
+#include "Market.h"
+#include "PortfolioUtils.h"
+#include "RiskPlan.h"
+#include "TestUtils.h"
+#include "ThreadPool.h"
+
+using namespace minirisk;
+
+const Date today(2017,8,5);
+
+// equal moves are one scenario, moves to the base value are dropped
+void test_scenarios() {
+  risk_plan_t plan;
+  MYASSERT(plan.scenarios.size() == 1 && plan.scenarios[0].empty(),
+      "No base scenario");
+  size_t a = plan.add_scenario({{"IR.1Y.EUR", {0.01, 0.0101}}});
+  size_t b = plan.add_scenario({{"IR.1Y.EUR", {0.01, 0.0101}},
+      {"FX.SPOT.EUR", {1.2, 1.2}}});
+  size_t c = plan.add_scenario({{"FX.SPOT.EUR", {1.2, 1.2}}});
+  size_t d = plan.add_scenario({{"IR.1Y.EUR", {0.01, 0.0099}}});
+  MYASSERT(a == 1 && b == 1 && c == 0 && d == 2
+      && plan.scenarios.size() == 3 && plan.base.size() == 1,
+      "Wrong scenarios " << a << " " << b << " " << c << " " << d);
+}
+
+// the planned greeks, run on a pool or not, are the ones of each class on
+// its own, and gammas and cross gammas share the delta scenarios
+void test_shared(std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds) {
+  auto pricers = get_pricers(load_portfolio("../data/portfolio_11.txt"), "USD");
+  Market mkt(mds, today);
+  auto prices = compute_prices(pricers, mkt, fds);
+  std::istringstream is(
+      "ir_tenor absolute 0.0001 central gamma\n"
+      "ir_parallel absolute 0.0001 central\n"
+      "fx_spot relative 0.001 central gamma\n"
+      "cross IR.1Y.EUR FX.SPOT.EUR\n");
+  greek_config_t config = parse_greek_config(is);
+
+  RiskCube separate(pricers.size());
+  for (const auto& c : config.classes) {
+    greek_config_t one;
+    one.classes.push_back(c);
+    compute_greeks(pricers, mkt, fds, one, separate, &prices);
+  }
+  RiskCube together(pricers.size()), pooled(pricers.size());
+  compute_greeks(pricers, mkt, fds, greek_config_t{config.classes, {}},
+      together, &prices);
+  MYASSERT(same(separate, together), "Planned greeks differ");
+  ThreadPool pool(3);
+  compute_greeks(pricers, mkt, fds, greek_config_t{config.classes, {}},
+      pooled, &prices, &pool);
+  MYASSERT(same(together, pooled), "Greeks on the pool differ");
+
+  // up and down per tenor and spot, per ccy for the parallel shifts, the
+  // base and one up-up per cross gamma
+  auto plan = plan_greeks(mkt, config);
+  const size_t tenors = mkt.get_risk_factors(ir_rate_prefix + ".+").size();
+  const size_t spots = mkt.get_risk_factors(fx_spot_prefix + ".+").size();
+  const size_t ccys = plan.rows.size() - 2 * tenors - 2 * spots - 1;
+  MYASSERT(plan.scenarios.size() == 1 + 2 * (tenors + ccys + spots) + 1,
+      "Scenarios not shared: " << plan.scenarios.size());
+}
+
+// parallel PV01 as the sum of the bucketed ones, and selected measures only
+void test_from_buckets(std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds) {
+  auto pricers = get_pricers(load_portfolio("../data/portfolio_11.txt"), "USD");
+  Market mkt(mds, today);
+  auto prices = compute_prices(pricers, mkt, fds);
+  greek_config_t config = default_greek_config();
+  RiskCube bumped(pricers.size()), derived(pricers.size());
+  compute_greeks(pricers, mkt, fds, config, bumped, &prices);
+  const size_t n_bumped = plan_greeks(mkt, config).scenarios.size();
+  config.parallel_from_buckets = true;
+  compute_greeks(pricers, mkt, fds, config, derived, &prices);
+  const size_t n_derived = plan_greeks(mkt, config).scenarios.size();
+  MYASSERT(n_derived < n_bumped, "No scenario saved");
+
+  MYASSERT(bumped.n_scenarios() == derived.n_scenarios(), "Wrong rows");
+  size_t n_parallel = 0;
+  for (size_t s = 0; s < bumped.n_scenarios(); ++s) {
+    if (bumped.scenario(s).measure != measure_t::pv01_parallel)
+      continue;
+    ++n_parallel;
+    for (size_t t = 0; t < pricers.size(); ++t) {
+      double x = bumped.row(s)[t], y = derived.row(s)[t];
+      MYASSERT(std::isnan(x) == std::isnan(y)
+          && (std::isnan(x) || std::fabs(x - y) <= 1e-6 * (1 + std::fabs(x))),
+          bumped.scenario(s).name << " differs: " << x << " " << y);
+    }
+  }
+  MYASSERT(n_parallel > 0 && n_derived + 2 * n_parallel == n_bumped,
+      "Wrong parallel scenarios");
+
+  RiskCube fx(pricers.size());
+  compute_greeks(pricers, mkt, fds, select_measures(default_greek_config(),
+        {parse_measure("pv"), parse_measure("fx_delta")}), fx, &prices);
+  for (size_t s = 0; s < fx.n_scenarios(); ++s)
+    MYASSERT(fx.scenario(s).measure == measure_t::fx_delta,
+        "Measure not selected: " << fx.scenario(s).name);
+  MYASSERT(fx.n_scenarios() > 0, "No fx delta");
+  bool thrown = false;
+  try {
+    parse_measure("pv01");
+  } catch (const std::exception&) {
+    thrown = true;
+  }
+  MYASSERT(thrown, "Unknown measure accepted");
+}
+
+// the trades only depend on the risk factors of their ccy, and repricing
+// only these gives the greeks of a full revaluation
+void test_sparse(std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds) {
+  auto pricers = get_pricers(portfolio_t{
+      payment("EUR", 1000000.0, Date(2019,8,5)),
+      payment("JPY", 1000000.0, Date(2018,2,5)),
+      payment("GBP", -500000.0, Date(2020,8,5)),
+      payment("USD", 1000.0, Date(2017,8,4))}, "USD");
+  Market mkt(mds, today);
+  trade_dependencies_t deps;
+  auto prices = compute_prices(pricers, mkt, fds, nullptr, &deps);
+  MYASSERT(deps.size() == pricers.size() && std::isnan(prices[3].first),
+      "Expired trade priced");
+  const char *ccys[] = {"EUR", "JPY", "GBP"};
+  for (size_t t = 0; t < 3; ++t) {
+    MYASSERT(deps[t].count(fx_spot_prefix + ccys[t]), "Missing fx spot");
+    for (const auto& rf : deps[t])
+      MYASSERT(rf.substr(rf.length() - 3) == ccys[t],
+          "Trade " << t << " depends on " << rf);
+  }
+
+  greek_config_t config = default_greek_config();
+  config.classes[2].gamma = true;
+  trade_dependencies_t all(pricers.size());
+  for (const auto& rf : mkt.get_risk_factors(".+"))
+    for (auto& d : all)
+      d.insert(rf.first);
+  RiskCube sparse(pricers.size()), dense(pricers.size()),
+           recorded(pricers.size());
+  compute_greeks(pricers, mkt, fds, config, sparse, &prices, nullptr, &deps);
+  compute_greeks(pricers, mkt, fds, config, dense, &prices, nullptr, &all);
+  compute_greeks(pricers, mkt, fds, config, recorded, &prices);
+  MYASSERT(same(sparse, dense) && same(sparse, recorded),
+      "Sparse greeks differ");
+}
+
+// batches of scenarios priced as lanes give the prices of each scenario
+void test_lanes(std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds) {
+  auto pricers = get_pricers(load_portfolio("../data/portfolio_11.txt"), "USD");
+  Market mkt(mds, today);
+  auto prices = compute_prices(pricers, mkt, fds);
+  std::vector<Market> lanes(5, mkt);
+  Market *m[5];
+  for (size_t k = 0; k < 5; ++k) {
+    m[k] = &lanes[k];
+    if (k < 3)
+      lanes[k].update_risk_factors({{"IR.1Y.EUR", 0.01 * k}});
+    else
+      lanes[k].update_risk_factors({{"FX.SPOT.GBP", 1.1 + 0.1 * k}});
+  }
+  portfolio_values_t batch[5];
+  compute_prices_batch(pricers, m, 5, fds, batch);
+  for (size_t k = 0; k < 5; ++k) {
+    auto expected = compute_prices(pricers, lanes[k], fds);
+    for (size_t t = 0; t < pricers.size(); ++t)
+      MYASSERT(batch[k][t] == expected[t] || (std::isnan(batch[k][t].first)
+            && batch[k][t].second == expected[t].second),
+          "Lane " << k << " trade " << t << " differs");
+  }
+
+  RiskCube one(pricers.size()), four(pricers.size()), eight(pricers.size());
+  auto plan = plan_greeks(mkt, default_greek_config());
+  plan.lanes = 1;
+  run_risk_plan(pricers, mkt, fds, plan, one, &prices);
+  plan.lanes = 4;
+  ThreadPool pool(3);
+  run_risk_plan(pricers, mkt, fds, plan, four, &prices, &pool);
+  plan.lanes = 8;
+  run_risk_plan(pricers, mkt, fds, plan, eight, &prices);
+  MYASSERT(same(one, four) && same(one, eight), "Greeks by lanes differ");
+}
+
+int main() {
+  try {
+    std::shared_ptr<const MarketDataServer> mds(
+        new MarketDataServer("../data/risk_factors_5.txt"));
+    std::shared_ptr<const FixingDataServer> fds(
+        new FixingDataServer("../data/fixings.txt"));
+    test_scenarios();
+    test_shared(mds, fds);
+    test_from_buckets(mds, fds);
+    test_sparse(mds, fds);
+    test_lanes(mds, fds);
+    std::cout << "SUCCESS" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+}
@@ -0,0 +1,157 @@
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <sstream>
+
+#include "PortfolioUtils.h"
+#include "RiskSession.h"
+#include "TestUtils.h"
+
+using namespace minirisk;
+
+const Date today(2017,8,5);
+
+// totals by scenario name of a full run on a fresh market
+std::map<std::string, std::pair<double, size_t>> full_run(
+    const portfolio_t& portfolio, std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds) {
+  auto pricers = get_pricers(portfolio, "USD");
+  Market mkt(mds, today);
+  RiskCube cube(pricers.size());
+  auto prices = compute_prices(pricers, mkt, fds);
+  cube.add_scenario(
+      scenario_info_t{"PV", measure_t::pv, {}, bump_type_t::none, 0.0}, prices);
+  compute_pv01_bucketed(pricers, mkt, fds, cube, &prices);
+  compute_pv01_parallel(pricers, mkt, fds, cube, &prices);
+  compute_fx_delta(pricers, mkt, fds, cube, &prices);
+  std::map<std::string, std::pair<double, size_t>> res;
+  for (size_t s = 0; s < cube.n_scenarios(); ++s)
+    res[cube.scenario(s).name] = cube.total(s);
+  return res;
+}
+
+// scenarios missing from the full run must be flat
+void check(const RiskSession& session, const portfolio_t& portfolio,
+    std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds) {
+  auto expected = full_run(portfolio, mds, fds);
+  for (size_t s = 0; s < session.n_scenarios(); ++s) {
+    const auto& name = session.scenario(s).name;
+    auto res = session.total(s);
+    auto iter = expected.find(name);
+    auto e = iter == expected.end()
+      ? std::make_pair(0.0, expected["PV"].second) : iter->second;
+    MYASSERT(std::fabs(res.first - e.first) <= 1e-9 * (1 + std::fabs(e.first))
+        && res.second == e.second, "Wrong total for " << name << ": "
+        << res.first << " (" << res.second << " errors), expected "
+        << e.first << " (" << e.second << " errors)");
+  }
+}
+
+void test_session() {
+  std::shared_ptr<const MarketDataServer> mds(
+      new MarketDataServer("../data/risk_factors_5.txt"));
+  std::shared_ptr<const FixingDataServer> fds(
+      new FixingDataServer("../data/fixings.txt"));
+
+  portfolio_t portfolio = load_portfolio("../data/portfolio_11.txt");
+  RiskSession session(mds, fds, today, "USD");
+  for (size_t i = 0; i < portfolio.size(); ++i)
+    session.add_trade(std::to_string(i), portfolio[i]);
+  MYASSERT(session.n_pending() == portfolio.size(), "Trades not pending");
+  session.refresh();
+  MYASSERT(session.n_pending() == 0, "Trades still pending");
+  check(session, portfolio, mds, fds);
+
+  // only the amended trade is repriced
+  portfolio[3] = payment("EUR", 1000, Date(2019,3,1));
+  session.amend_trade("3", portfolio[3]);
+  MYASSERT(session.refresh() == 1, "Wrong number of trades priced");
+  check(session, portfolio, mds, fds);
+
+  // amending back to an existing content hits the cache
+  portfolio[3] = portfolio[4];
+  session.amend_trade("3", portfolio[3]);
+  MYASSERT(session.refresh() == 0, "Cached result not used");
+  check(session, portfolio, mds, fds);
+
+  session.remove_trade("5");
+  portfolio.erase(portfolio.begin() + 5);
+  session.add_trade("new", payment("GBP", -250, Date(2018,1,15)));
+  portfolio.push_back(payment("GBP", -250, Date(2018,1,15)));
+  MYASSERT(session.refresh() == 1, "Wrong number of trades priced");
+  check(session, portfolio, mds, fds);
+  MYASSERT(session.n_trades() == portfolio.size(), "Wrong number of trades");
+
+  session.trim_cache();
+  session.recompute_totals();
+  check(session, portfolio, mds, fds);
+
+  // a new market reprices everything
+  uint64_t version = session.market_version();
+  session.set_market_data(mds, fds);
+  MYASSERT(session.market_version() == version + 1, "Version not updated");
+  MYASSERT(session.refresh() > 0 && session.n_pending() == 0, "Not repriced");
+  check(session, portfolio, mds, fds);
+}
+
+// a refresh which throws leaves the trades pending and the totals unchanged
+void test_failed_refresh() {
+  std::shared_ptr<const MarketDataServer> mds(
+      new MarketDataServer("../data/risk_factors_5.txt"));
+  std::shared_ptr<const FixingDataServer> fds(
+      new FixingDataServer("../data/fixings.txt"));
+  // the plan throws until the EUR risk factors are known
+  std::istringstream is(
+      "ir_tenor absolute 0.0001 central\n"
+      "fx_spot relative 0.001 central\n"
+      "cross IR.1Y.EUR FX.SPOT.EUR\n");
+  RiskSession session(mds, fds, today, "USD", parse_greek_config(is));
+  session.add_trade("gbp", payment("GBP", -250, Date(2018,1,15)));
+  bool thrown = false;
+  try {
+    session.refresh();
+  } catch (const std::exception&) {
+    thrown = true;
+  }
+  MYASSERT(thrown, "Unknown cross gamma item not reported");
+  MYASSERT(session.n_pending() == 1
+      && session.total(0) == std::make_pair(0.0, size_t(0)),
+      "Failed refresh not undone");
+
+  session.add_trade("eur", payment("EUR", 1000, Date(2019,3,1)));
+  MYASSERT(session.refresh() == 2 && session.n_pending() == 0,
+      "Pending trades not priced");
+  std::vector<std::pair<double, size_t>> totals;
+  for (size_t s = 0; s < session.n_scenarios(); ++s)
+    totals.push_back(session.total(s));
+  session.recompute_totals();
+  for (size_t s = 0; s < session.n_scenarios(); ++s)
+    MYASSERT(session.total(s) == totals[s],
+        "Wrong total for " << session.scenario(s).name);
+  MYASSERT(totals[0].first == session.value("gbp", 0).first
+      + session.value("eur", 0).first, "Wrong PV total");
+}
+
+void test_hash() {
+  std::string c1, c2;
+  auto h1 = trade_hash(*payment("EUR", 1000, Date(2019,3,1)), &c1);
+  auto h2 = trade_hash(*payment("EUR", 1000, Date(2019,3,2)), &c2);
+  MYASSERT(h1 != h2 && c1 != c2, "Different trades with the same hash");
+  MYASSERT(h1 == trade_hash(*payment("EUR", 1000, Date(2019,3,1))),
+      "Hash is not deterministic");
+}
+
+int main() {
+  try {
+    test_hash();
+    test_session();
+    test_failed_refresh();
+    std::cout << "SUCCESS" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+}
@@ -0,0 +1,72 @@
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "Market.h"
+#include "Sharding.h"
+
+using namespace minirisk;
+
+void test_partition() {
+  std::vector<double> costs = {3, 1, 1, 0.1, 3, 1, 3, 1, 0.1, 1};
+  auto shards = partition_by_cost(costs, 3);
+  MYASSERT(shards.size() == 3, "Wrong number of shards");
+  std::vector<bool> seen(costs.size(), false);
+  for (const auto& s : shards) {
+    double load = 0;
+    for (size_t i : s) {
+      MYASSERT(!seen[i], "Trade " << i << " in two shards");
+      seen[i] = true;
+      load += costs[i];
+    }
+    MYASSERT(std::fabs(load - 14.2 / 3) < 1.5, "Unbalanced shard " << load);
+    MYASSERT(std::is_sorted(s.begin(), s.end()), "Shard not sorted");
+  }
+  MYASSERT(std::find(seen.begin(), seen.end(), false) == seen.end(),
+      "Trade not assigned");
+}
+
+// the merged results must be identical to a single process run
+void test_run() {
+  shard_inputs_t inputs{"../data/portfolio_11.txt",
+    "../data/risk_factors_5.txt", "../data/fixings.txt", "GBP", Date(2017,8,5)};
+  auto pricers = get_pricers(load_portfolio(inputs.portfolio_file), "GBP");
+  std::shared_ptr<const MarketDataServer> mds(
+      new MarketDataServer(inputs.risk_factors_file));
+  std::shared_ptr<const FixingDataServer> fds(
+      new FixingDataServer(inputs.fixing_path));
+  Market mkt(mds, inputs.today);
+  RiskCube expected(pricers.size());
+  auto prices = compute_prices(pricers, mkt, fds);
+  expected.add_scenario(
+      scenario_info_t{"PV", measure_t::pv, {}, bump_type_t::none, 0.0}, prices);
+  compute_pv01_bucketed(pricers, mkt, fds, expected, &prices);
+  compute_pv01_parallel(pricers, mkt, fds, expected, &prices);
+  compute_fx_delta(pricers, mkt, fds, expected, &prices);
+
+  RiskCube cube = run_sharded(inputs, 4);
+  MYASSERT(cube.n_scenarios() == expected.n_scenarios()
+      && cube.n_trades() == expected.n_trades(), "Wrong shape");
+  for (size_t s = 0; s < cube.n_scenarios(); ++s) {
+    MYASSERT(cube.scenario(s).name == expected.scenario(s).name,
+        "Scenario " << s << " is " << cube.scenario(s).name);
+    for (size_t t = 0; t < cube.n_trades(); ++t) {
+      double a = cube.row(s)[t], b = expected.row(s)[t];
+      MYASSERT(std::isnan(b) ? *cube.error(s, t) == *expected.error(s, t)
+          : a == b, "Trade " << t << " differs in " << cube.scenario(s).name);
+    }
+  }
+}
+
+int main() {
+  try {
+    test_partition();
+    test_run();
+    std::cout << "SUCCESS" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+}
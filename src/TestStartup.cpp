@@ -0,0 +1,100 @@
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+#include "Market.h"
+#include "PortfolioUtils.h"
+#include "Startup.h"
+#include "ThreadPool.h"
+
+using namespace minirisk;
+
+void test_async() {
+  ThreadPool pool(2);
+  auto a = pool.async([] { return 42; });
+  auto b = pool.async([]() -> int { THROW("failed"); });
+  MYASSERT(a.get() == 42, "Wrong result");
+  bool thrown = false;
+  try {
+    b.get();
+  } catch (const std::exception&) {
+    thrown = true;
+  }
+  MYASSERT(thrown, "Exception not propagated");
+}
+
+void test_chunks() {
+  size_t n = 0, n_chunks = 0;
+  load_portfolio_chunks("../data/portfolio_11.txt", 3,
+      [&](size_t first, portfolio_t&& chunk) {
+        MYASSERT(first == n && !chunk.empty() && chunk.size() <= 3,
+            "Wrong chunk");
+        n += chunk.size();
+        ++n_chunks;
+      });
+  MYASSERT(n == load_portfolio("../data/portfolio_11.txt").size()
+      && n_chunks == (n + 2) / 3, "Wrong number of trades");
+}
+
+// the pipeline prices like the sequential loading, whatever the chunk size
+// and the number of threads
+void test_start_up() {
+  const Date today(2017,8,5);
+  auto pricers = get_pricers(load_portfolio("../data/portfolio_11.txt"), "GBP");
+  std::shared_ptr<const MarketDataServer> mds(
+      new MarketDataServer("../data/risk_factors_5.txt"));
+  std::shared_ptr<const FixingDataServer> fds(
+      new FixingDataServer("../data/fixings.txt"));
+  Market lazy(mds, today);
+  auto expected = compute_prices(pricers, lazy, fds);
+
+  startup_inputs_t inputs;
+  inputs.portfolio_file = "../data/portfolio_11.txt";
+  inputs.risk_factors_file = "../data/risk_factors_5.txt";
+  inputs.fixing_path = "../data/fixings.txt";
+  inputs.base_ccy = "GBP";
+  inputs.today = today;
+  for (size_t n_threads : {1, 4}) {
+    for (size_t chunk_size : {1, 5, 1000}) {
+      ThreadPool pool(n_threads);
+      inputs.chunk_size = chunk_size;
+      inputs.round_trip_file = chunk_size == 5 ? "startup_ptf.tmp" : "";
+      startup_t s = start_up(inputs, pool);
+      MYASSERT(s.pricers.size() == pricers.size()
+          && s.portfolio.size() == pricers.size(), "Wrong number of pricers");
+      MYASSERT(s.missing.size() == 1, "Wrong missing data");
+      auto prices = compute_prices(s.pricers, *s.mkt, s.fds);
+      for (size_t i = 0; i < prices.size(); ++i)
+        MYASSERT(std::isnan(expected[i].first)
+            ? prices[i].second == expected[i].second
+            : prices[i].first == expected[i].first,
+            "Trade " << i << " differs");
+    }
+  }
+  std::remove("startup_ptf.tmp");
+
+  // a missing input fails the startup
+  inputs.fixing_path = "no_such_file.txt";
+  bool thrown = false;
+  try {
+    ThreadPool pool(2);
+    start_up(inputs, pool);
+  } catch (const std::exception&) {
+    thrown = true;
+  }
+  MYASSERT(thrown, "Missing fixings not reported");
+}
+
+int main() {
+  try {
+    test_async();
+    test_chunks();
+    test_start_up();
+    std::cout << "SUCCESS" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+}
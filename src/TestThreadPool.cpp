@@ -0,0 +1,104 @@
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+
+#include "Market.h"
+#include "PortfolioGenerator.h"
+#include "PortfolioUtils.h"
+#include "ThreadPool.h"
+
+using namespace minirisk;
+
+void test_dag() {
+  ThreadPool pool(4);
+  // 0 -> 2, 1 -> 2, 2 -> 3, 4 fails -> 5 skipped
+  std::vector<std::vector<size_t>> deps = {{}, {}, {0, 1}, {2}, {}, {4}};
+  std::vector<std::atomic<int>> order(deps.size());
+  std::atomic<int> clock(0);
+  size_t n = run_dag(pool, deps, [&](size_t i) {
+      order[i] = ++clock;
+      return i != 4; });
+  MYASSERT(n == 4, "Wrong number of nodes succeeded: " << n);
+  MYASSERT(order[2] > order[0] && order[2] > order[1] && order[3] > order[2],
+      "Dependencies not respected");
+  MYASSERT(order[5] == 0, "Node depending on a failure was run");
+  MYASSERT(run_dag(pool, {}, [](size_t) { return true; }) == 0, "Empty DAG");
+
+  bool thrown = false;
+  try {
+    run_dag(pool, {{1}, {0}}, [](size_t) { return true; });
+  } catch (const std::exception&) {
+    thrown = true;
+  }
+  MYASSERT(thrown, "Cycle not detected");
+}
+
+// curves built in parallel price like curves built on demand, and record
+// their dependencies
+void test_build_curves() {
+  generator_config_t cfg;
+  cfg.n_trades = 2000;
+  cfg.n_ccys = 40;
+  cfg.missing_data_fraction = 0.05;
+  PortfolioGenerator gen(cfg);
+  gen.write_risk_factors("threadpool_rf.tmp");
+  gen.write_portfolio("threadpool_ptf.tmp", "threadpool_fix.tmp");
+  auto pricers = get_pricers(load_portfolio("threadpool_ptf.tmp"), "USD");
+  std::shared_ptr<const MarketDataServer> mds(
+      new MarketDataServer("threadpool_rf.tmp"));
+  std::shared_ptr<const FixingDataServer> fds(
+      new FixingDataServer("threadpool_fix.tmp"));
+  for (const char *f : {"threadpool_rf.tmp", "threadpool_ptf.tmp",
+      "threadpool_fix.tmp"})
+    std::remove(f);
+
+  Market lazy(mds, cfg.today);
+  auto expected = compute_prices(pricers, lazy, fds);
+
+  Market mkt(mds, cfg.today);
+  auto req = get_requirements(pricers, cfg.today, fds.get());
+  mkt.prefetch(req, fds.get());
+  ThreadPool pool(8);
+  size_t n = mkt.build_curves(req, pool);
+  MYASSERT(n > req.discount_curves.size(), "Too few curves built: " << n);
+  mkt.disconnect();
+  auto prices = compute_prices(pricers, mkt, fds);
+  // trades missing data fail either way, with a different message once
+  // disconnected
+  for (size_t i = 0; i < prices.size(); ++i)
+    MYASSERT(std::isnan(expected[i].first)
+        ? std::isnan(prices[i].first) && !prices[i].second.empty()
+        : prices[i].first == expected[i].first, "Trade " << i << " differs");
+
+  // the first forward curve built, some lack market data
+  for (const auto& fwd : req.fx_fwd_curves) {
+    const auto ccys = mkt.fx_fwd_name_to_ccy_pair(fwd);
+    mkt.begin_recording();
+    try {
+      mkt.get_fx_fwd_curve(fwd);
+    } catch (const std::exception&) {
+      mkt.end_recording();
+      continue;
+    }
+    auto deps = mkt.end_recording();
+    auto rates = mkt.get_risk_factors(ir_tenors_regex(ccys.first));
+    MYASSERT(!rates.empty() && deps.count(rates[0].first),
+        "Dependencies of " << fwd << " not recorded");
+    return;
+  }
+  MYASSERT(false, "No forward curve built");
+}
+
+int main() {
+  try {
+    test_dag();
+    test_build_curves();
+    std::cout << "SUCCESS" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+}
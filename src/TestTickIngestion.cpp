@@ -0,0 +1,97 @@
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+#include "PortfolioUtils.h"
+#include "TickIngestion.h"
+
+using namespace minirisk;
+
+const Date today(2017,8,5);
+
+void test_queue() {
+  TickQueue queue;
+  std::istringstream is(
+      "IR.1W.EUR 0.01\n# comment\nFX.SPOT.EUR 1.2\nIR.1W.EUR 0.03\n");
+  read_ticks(is, queue);
+  MYASSERT(queue.n_received() == 3, "Wrong number of updates received");
+  auto batch = queue.drain(std::chrono::milliseconds(0));
+  MYASSERT(batch.size() == 2 && batch[0].first == "FX.SPOT.EUR"
+      && batch[1].first == "IR.1W.EUR" && batch[1].second == 0.03,
+      "Updates not coalesced");
+  MYASSERT(queue.drain(std::chrono::milliseconds(0)).empty(),
+      "Closed queue not empty");
+}
+
+// revalued prices must be identical to a full repricing on a fresh market
+void check_prices(const TickRevaluation& reval,
+    const std::vector<ppricer_t>& pricers,
+    std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds,
+    const Market::vec_risk_factor_t& updates) {
+  Market mkt(mds, today);
+  compute_prices(pricers, mkt, fds);
+  mkt.set_risk_factors(updates);
+  auto expected = compute_prices(pricers, mkt, fds);
+  const auto& prices = reval.prices();
+  for (size_t t = 0; t < pricers.size(); ++t)
+    MYASSERT(std::isnan(expected[t].first)
+        ? std::isnan(prices[t].first) && prices[t].second == expected[t].second
+        : prices[t].first == expected[t].first, "Trade " << t << " differs: "
+        << prices[t].first << " instead of " << expected[t].first);
+}
+
+void test_revaluation() {
+  std::shared_ptr<const MarketDataServer> mds(
+      new MarketDataServer("../data/risk_factors_5.txt"));
+  std::shared_ptr<const FixingDataServer> fds(
+      new FixingDataServer("../data/fixings.txt"));
+  auto pricers = get_pricers(load_portfolio("../data/portfolio_11.txt"), "USD");
+  TickRevaluation reval(pricers, mds, fds, today);
+
+  Market::vec_risk_factor_t updates = {{"IR.1Y.EUR", 0.031}};
+  auto repriced = reval.apply(updates);
+  MYASSERT(!repriced.empty() && repriced.size() < pricers.size(),
+      "Wrong number of trades repriced " << repriced.size());
+  check_prices(reval, pricers, mds, fds, updates);
+
+  // a cross rate depends on the quoted rates of both currencies
+  updates.push_back({"FX.SPOT.GBP", 1.6});
+  updates.push_back({"NOT.A.RISK.FACTOR", 1.0});
+  repriced = reval.apply({updates[1], updates[2]});
+  MYASSERT(!repriced.empty() && repriced.size() < pricers.size(),
+      "Wrong number of trades repriced " << repriced.size());
+  updates.pop_back();
+  check_prices(reval, pricers, mds, fds, updates);
+
+  // updates fed through the queue
+  TickQueue queue;
+  std::thread feed([&]() {
+    std::istringstream is("IR.1Y.USD 0.093\nwait 5\nFX.SPOT.JPY 0.0099\n");
+    read_ticks(is, queue);
+  });
+  size_t n_updates = 0;
+  revalue_ticks(queue, reval, std::chrono::milliseconds(1),
+      [&](const std::vector<size_t>&, const tick_batch_stats_t& stats) {
+        n_updates += stats.n_updates;
+      });
+  feed.join();
+  MYASSERT(n_updates == 2, "Updates lost");
+  updates.push_back({"IR.1Y.USD", 0.093});
+  updates.push_back({"FX.SPOT.JPY", 0.0099});
+  check_prices(reval, pricers, mds, fds, updates);
+}
+
+int main() {
+  try {
+    test_queue();
+    test_revaluation();
+    std::cout << "SUCCESS" << std::endl;
+    return 0;
+  }
+  catch (const std::exception& e) {
+    std::cerr << e.what() << "\n";
+    return -1;
+  }
+}
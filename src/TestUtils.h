@@ -0,0 +1,43 @@
+#pragma once
+
+// Helpers shared by the tests
+
+#include <cmath>
+#include <memory>
+#include <string>
+
+#include "Date.h"
+#include "RiskCube.h"
+#include "TradePayment.h"
+
+namespace minirisk {
+
+inline ptrade_t payment(const std::string& ccy, double quantity,
+    const Date& date) {
+  std::shared_ptr<TradePayment> p(new TradePayment);
+  p->init(ccy, quantity, date);
+  return p;
+}
+
+// row sa of a and row sb of b hold the same values, or the same errors
+inline bool same(const RiskCube& a, size_t sa, const RiskCube& b, size_t sb) {
+  for (size_t t = 0; t < a.n_trades(); ++t) {
+    double x = a.row(sa)[t], y = b.row(sb)[t];
+    if (std::isnan(x) ? !std::isnan(y) || *a.error(sa, t) != *b.error(sb, t)
+        : x != y)
+      return false;
+  }
+  return true;
+}
+
+// same scenarios, with the same results
+inline bool same(const RiskCube& a, const RiskCube& b) {
+  if (a.n_scenarios() != b.n_scenarios())
+    return false;
+  for (size_t s = 0; s < a.n_scenarios(); ++s)
+    if (a.scenario(s).name != b.scenario(s).name || !same(a, s, b, s))
+      return false;
+  return true;
+}
+
+} // namespace minirisk
@@ -0,0 +1,132 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <memory>
+
+#include "Macros.h"
+
+namespace minirisk {
+
+ThreadPool::ThreadPool(size_t n_threads) : m_stop(false) {
+  if (n_threads == 0)
+    n_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (size_t i = 0; i < n_threads; ++i)
+    m_threads.emplace_back([this] { work(); });
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stop = true;
+  }
+  m_cv.notify_all();
+  for (auto& t : m_threads)
+    t.join();
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_tasks.push_back(std::move(task));
+  }
+  m_cv.notify_one();
+}
+
+void ThreadPool::work() {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+      if (m_tasks.empty())
+        return;
+      task = std::move(m_tasks.front());
+      m_tasks.pop_front();
+    }
+    task();
+  }
+}
+
+namespace {
+// progress of a run_dag call, shared by its tasks
+struct dag_state_t {
+  std::vector<std::vector<size_t>> dependents;
+  std::vector<size_t> n_pending;  // dependencies not run yet
+  std::vector<bool> failed;       // the node or one of its dependencies
+  size_t n_done = 0;
+  size_t n_succeeded = 0;
+  std::mutex mutex;
+  std::condition_variable done;
+};
+
+// the state is shared with the tasks, which may still hold the mutex when
+// run_dag returns
+void run_node(ThreadPool& pool, const std::shared_ptr<dag_state_t>& state,
+    const std::function<bool(size_t)>& task, size_t i, bool skip) {
+  dag_state_t& s = *state;
+  bool ok = false;
+  if (!skip) {
+    try {
+      ok = task(i);
+    } catch (...) {
+    }
+  }
+  std::vector<std::pair<size_t, bool>> ready;
+  {
+    std::lock_guard<std::mutex> lock(s.mutex);
+    ++s.n_done;
+    s.n_succeeded += ok;
+    for (size_t j : s.dependents[i]) {
+      if (!ok)
+        s.failed[j] = true;
+      if (--s.n_pending[j] == 0)
+        ready.push_back(std::make_pair(j, s.failed[j]));
+    }
+    if (s.n_done == s.n_pending.size())
+      s.done.notify_all();
+  }
+  for (const auto& r : ready)
+    pool.submit([&pool, state, &task, r] {
+        run_node(pool, state, task, r.first, r.second); });
+}
+} // namespace
+
+size_t run_dag(ThreadPool& pool, const std::vector<std::vector<size_t>>& deps,
+    const std::function<bool(size_t)>& task) {
+  const size_t n = deps.size();
+  auto state = std::make_shared<dag_state_t>();
+  dag_state_t& s = *state;
+  s.dependents.resize(n);
+  s.n_pending.resize(n);
+  s.failed.assign(n, false);
+  for (size_t i = 0; i < n; ++i) {
+    s.n_pending[i] = deps[i].size();
+    for (size_t d : deps[i]) {
+      MYASSERT(d < n && d != i, "Invalid dependency " << d << " of node " << i);
+      s.dependents[d].push_back(i);
+    }
+  }
+  // a cycle would never complete
+  std::vector<size_t> pending(s.n_pending), order;
+  for (size_t i = 0; i < n; ++i)
+    if (pending[i] == 0)
+      order.push_back(i);
+  for (size_t k = 0; k < order.size(); ++k)
+    for (size_t j : s.dependents[order[k]])
+      if (--pending[j] == 0)
+        order.push_back(j);
+  MYASSERT(order.size() == n, "The dependencies contain a cycle");
+
+  // the roots are the first nodes in order, collected before any of them
+  // runs and updates n_pending
+  for (size_t k = 0; k < order.size() && deps[order[k]].empty(); ++k) {
+    size_t i = order[k];
+    pool.submit([&pool, state, &task, i] {
+        run_node(pool, state, task, i, false); });
+  }
+  std::unique_lock<std::mutex> lock(s.mutex);
+  s.done.wait(lock, [&s, n] { return s.n_done == n; });
+  return s.n_succeeded;
+}
+
+} // namespace minirisk
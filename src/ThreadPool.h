@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace minirisk {
+
+// Fixed number of worker threads executing tasks in submission order.
+struct ThreadPool {
+ public:
+  // 0 threads means one per hardware thread
+  explicit ThreadPool(size_t n_threads = 0);
+
+  // waits for the queued tasks
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t size() const { return m_threads.size(); }
+
+  // tasks must not throw
+  void submit(std::function<void()> task);
+
+  // runs f() on the pool, the future holds its result or its exception
+  template <typename F>
+  std::future<typename std::result_of<F()>::type> async(F f) {
+    typedef typename std::result_of<F()>::type result_t;
+    auto task = std::make_shared<std::packaged_task<result_t()>>(std::move(f));
+    std::future<result_t> res = task->get_future();
+    submit([task] { (*task)(); });
+    return res;
+  }
+
+ private:
+  void work();
+
+  std::vector<std::thread> m_threads;
+  std::deque<std::function<void()>> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_stop;
+};
+
+// Runs task(i) for each node i of a DAG, where deps[i] are the nodes to run
+// before i. Independent nodes run concurrently on the pool, and each node
+// runs once. A task returns false if it failed, in which case the nodes
+// depending on it are skipped. Returns the number of nodes which succeeded.
+// Must not be called from a task of the same pool.
+size_t run_dag(ThreadPool& pool, const std::vector<std::vector<size_t>>& deps,
+    const std::function<bool(size_t)>& task);
+
+} // namespace minirisk
@@ -0,0 +1,146 @@
+#include "TickIngestion.h"
+
+#include <algorithm>
+#include <sstream>
+#include <thread>
+
+#include "Instrumentation.h"
+#include "Macros.h"
+
+namespace minirisk {
+
+void TickQueue::push(const std::string& name, double value) {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_pending.empty())
+      m_first = clock_t::now();
+    m_pending[name] = value;
+    ++m_received;
+  }
+  m_cv.notify_one();
+}
+
+void TickQueue::close() {
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_closed = true;
+  }
+  m_cv.notify_one();
+}
+
+Market::vec_risk_factor_t TickQueue::drain(
+    clock_t::duration window, clock_t::time_point *first) {
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_cv.wait(lock, [this]() { return !m_pending.empty() || m_closed; });
+  // let the burst complete, unless the feed is over
+  auto deadline = m_first + window;
+  m_cv.wait_until(lock, deadline, [this]() { return m_closed; });
+  if (first)
+    *first = m_first;
+  Market::vec_risk_factor_t batch(m_pending.begin(), m_pending.end());
+  m_pending.clear();
+  return batch;
+}
+
+size_t TickQueue::n_received() const {
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_received;
+}
+
+void read_ticks(std::istream& is, TickQueue& queue) {
+  string line;
+  while (std::getline(is, line)) {
+    std::istringstream ls(line);
+    string name;
+    double value;
+    if (!(ls >> name) || name[0] == '#')
+      continue;
+    MYASSERT(ls >> value, "Invalid market data update: " << line);
+    if (name == "wait")
+      std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(value));
+    else
+      queue.push(name, value);
+  }
+  queue.close();
+}
+
+TickRevaluation::TickRevaluation(const std::vector<ppricer_t>& pricers,
+    std::shared_ptr<const MarketDataServer> mds,
+    std::shared_ptr<const FixingDataServer> fds, const Date& today)
+  : m_pricers(pricers)
+  , m_fds(fds)
+  , m_mkt(mds, today)
+  , m_prices(pricers.size())
+  , m_deps(pricers.size()) {
+  for (size_t t = 0; t < m_pricers.size(); ++t)
+    price(t);
+}
+
+void TickRevaluation::price(size_t t) {
+  INSTR_COUNT(instr::pricer_call);
+  m_mkt.begin_recording();
+  try {
+    double price;
+    Status status = m_pricers[t]->try_price(m_mkt, m_fds.get(), price);
+    if (status.ok())
+      m_prices[t] = std::make_pair(price, "");
+    else
+      m_prices[t] = std::make_pair(nan<double>(), status.message());
+  } catch (std::exception& e) {
+    m_prices[t] = std::make_pair(nan<double>(), e.what());
+  }
+  std::set<std::string> deps = m_mkt.end_recording();
+  if (deps == m_deps[t])
+    return;
+  for (const auto& d : m_deps[t]) {
+    auto& trades = m_index[d];
+    trades.erase(std::remove(trades.begin(), trades.end(), t), trades.end());
+  }
+  for (const auto& d : deps)
+    m_index[d].push_back(t);
+  m_deps[t].swap(deps);
+}
+
+std::vector<size_t> TickRevaluation::apply(
+    const Market::vec_risk_factor_t& updates) {
+  INSTR_SCOPE("TickRevaluation::apply");
+  Market::vec_risk_factor_t known;
+  std::vector<size_t> repriced;
+  for (const auto& u : updates) {
+    if (!m_mkt.has_risk_factor(u.first))
+      continue;
+    known.push_back(u);
+    auto iter = m_index.find(u.first);
+    if (iter != m_index.end())
+      repriced.insert(repriced.end(), iter->second.begin(), iter->second.end());
+  }
+  std::sort(repriced.begin(), repriced.end());
+  repriced.erase(std::unique(repriced.begin(), repriced.end()), repriced.end());
+
+  m_mkt.update_risk_factors(known);
+  for (size_t t : repriced)
+    price(t);
+  return repriced;
+}
+
+void revalue_ticks(TickQueue& queue, TickRevaluation& reval,
+    TickQueue::clock_t::duration window,
+    const std::function<void(const std::vector<size_t>& repriced,
+      const tick_batch_stats_t& stats)>& publish) {
+  while (true) {
+    TickQueue::clock_t::time_point first;
+    auto batch = queue.drain(window, &first);
+    if (batch.empty())
+      break;
+    auto repriced = reval.apply(batch);
+    tick_batch_stats_t stats;
+    stats.n_received = queue.n_received();
+    stats.n_updates = batch.size();
+    stats.n_repriced = repriced.size();
+    stats.latency_ms = std::chrono::duration<double, std::milli>(
+        TickQueue::clock_t::now() - first).count();
+    publish(repriced, stats);
+  }
+}
+
+} // namespace minirisk
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <istream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "FixingDataServer.h"
+#include "Market.h"
+#include "PortfolioUtils.h"
+
+namespace minirisk {
+
+// Thread safe buffer of market data updates. Updates of the same risk factor
+// received before the buffer is drained are coalesced: only the last value is
+// kept.
+struct TickQueue {
+ public:
+  typedef std::chrono::steady_clock clock_t;
+
+  TickQueue() : m_closed(false), m_received(0) {}
+
+  void push(const std::string& name, double value);
+
+  // no more updates will be pushed
+  void close();
+
+  // Waits for at least one update, then keeps collecting updates for the
+  // coalescing window, and returns all of them as one batch. An empty batch
+  // means that the queue has been closed and drained. The arrival time of
+  // the oldest update of the batch is returned in first.
+  Market::vec_risk_factor_t drain(
+      clock_t::duration window, clock_t::time_point *first = nullptr);
+
+  // number of updates pushed so far, before coalescing
+  size_t n_received() const;
+
+ private:
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::map<std::string, double> m_pending;
+  clock_t::time_point m_first;  // arrival of the oldest pending update
+  bool m_closed;
+  size_t m_received;
+};
+
+// Reads updates from a stream (a replay file or a pipe) until its end, then
+// closes the queue. Each line is either "<risk factor> <value>", or
+// "wait <milliseconds>" to pace a replay.
+void read_ticks(std::istream& is, TickQueue& queue);
+
+// Keeps the PVs of a portfolio up to date with market data updates. The risk
+// factors each trade depends on, directly or through curves, are recorded
+// while pricing it and inverted into a risk factor -> trades index, so that a
+// batch of updates only reprices the trades depending on what moved, and only
+// rebuilds the curves depending on what moved.
+struct TickRevaluation {
+ public:
+  TickRevaluation(const std::vector<ppricer_t>& pricers,
+      std::shared_ptr<const MarketDataServer> mds,
+      std::shared_ptr<const FixingDataServer> fds, const Date& today);
+
+  // apply a batch of updates atomically and reprice the trades depending on
+  // them, returns the indices of the repriced trades; updates of risk factors
+  // unknown to the market are ignored
+  std::vector<size_t> apply(const Market::vec_risk_factor_t& updates);
+
+  const portfolio_values_t& prices() const { return m_prices; }
+
+ private:
+  // price a trade and update the index with its dependencies
+  void price(size_t t);
+
+  std::vector<ppricer_t> m_pricers;
+  std::shared_ptr<const FixingDataServer> m_fds;
+  Market m_mkt;
+  portfolio_values_t m_prices;
+  std::vector<std::set<std::string>> m_deps;  // by trade
+  std::unordered_map<std::string, std::vector<size_t>> m_index;
+};
+
+struct tick_batch_stats_t {
+  size_t n_received;  // updates received since the start, before coalescing
+  size_t n_updates;   // distinct risk factors updated in the batch
+  size_t n_repriced;
+  double latency_ms;  // from the arrival of the oldest update to publication
+};
+
+// Applies the updates of the queue batch by batch until the queue is closed,
+// and publishes the repriced trades after each batch. The latency of an
+// update is bounded by the coalescing window plus the time taken to apply
+// the previous and the current batch.
+void revalue_ticks(TickQueue& queue, TickRevaluation& reval,
+    TickQueue::clock_t::duration window,
+    const std::function<void(const std::vector<size_t>& repriced,
+      const tick_batch_stats_t& stats)>& publish);
+
+} // namespace minirisk
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "ITrade.h"
+#include "MemoryReport.h"
 #include "Streamer.h"
 
 namespace minirisk {
@@ -28,14 +29,19 @@ struct Trade : ITrade
         return T::m_name;
     }
 
+    virtual size_t memory_size() const
+    {
+        return sizeof(T) + static_cast<const T*>(this)->heap_size_details();
+    }
+
 protected:
     virtual void print(std::ostream& os) const
     {
-        os << format_label("Id") << id() << std::endl;
-        os << format_label("Name") << idname() << std::endl;
-        os << format_label("Quantity") << quantity() << std::endl;
+        os << format_label("Id") << id() << '\n';
+        os << format_label("Name") << idname() << '\n';
+        os << format_label("Quantity") << quantity() << '\n';
         static_cast<const T*>(this)->print_details(os);
-        os << std::endl;
+        os << '\n';
     }
 
     virtual void save(my_ofstream& os) const
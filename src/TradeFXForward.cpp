@@ -3,8 +3,9 @@
 
 namespace minirisk {
 
-ppricer_t TradeFXForward::pricer(const std::string& base_ccy) const {
-  return ppricer_t(new PricerForward(*this, base_ccy));
+ppricer_t TradeFXForward::pricer(const std::string& base_ccy,
+    const std::shared_ptr<Arena>& arena) const {
+  return make_in_arena<PricerForward>(arena, *this, base_ccy);
 }
 
 } // namespace minirisk
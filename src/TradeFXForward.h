@@ -24,7 +24,8 @@ struct TradeFXForward : Trade<TradeFXForward> {
     m_settle_date = settle_date;
   }
 
-  virtual ppricer_t pricer(const std::string& base_ccy) const;
+  virtual ppricer_t pricer(const std::string& base_ccy,
+      const std::shared_ptr<Arena>& arena) const;
 
   const string& ccy1() const { return m_ccy1; }
   const string& ccy2() const { return m_ccy2; }
@@ -32,6 +33,9 @@ struct TradeFXForward : Trade<TradeFXForward> {
   const Date& fixing_date() const { return m_fixing_date; }
   const Date& settle_date() const { return m_settle_date; }
 
+  virtual const string& ccy() const { return m_ccy2; }
+  virtual const Date& maturity() const { return m_settle_date; }
+
  private:
   void save_details(my_ofstream& os) const {
     os << m_ccy1 << m_ccy2 << m_strike << m_fixing_date << m_settle_date;
@@ -41,12 +45,16 @@ struct TradeFXForward : Trade<TradeFXForward> {
     is >> m_ccy1 >> m_ccy2 >> m_strike >> m_fixing_date >> m_settle_date;
   }
 
+  size_t heap_size_details() const {
+    return heap_size(m_ccy1) + heap_size(m_ccy2);
+  }
+
   void print_details(std::ostream& os) const {
-    os << format_label("Strike level") << m_strike << std::endl;
-    os << format_label("Base Currency") << m_ccy1 << std::endl;
-    os << format_label("Quote Currency") << m_ccy2 << std::endl;
-    os << format_label("Fixing Date") << m_fixing_date << std::endl;
-    os << format_label("Settlement Date") << m_settle_date << std::endl;
+    os << format_label("Strike level") << m_strike << '\n';
+    os << format_label("Base Currency") << m_ccy1 << '\n';
+    os << format_label("Quote Currency") << m_ccy2 << '\n';
+    os << format_label("Fixing Date") << m_fixing_date << '\n';
+    os << format_label("Settlement Date") << m_settle_date << '\n';
   }
 
 
@@ -3,8 +3,9 @@
 
 namespace minirisk {
 
-ppricer_t TradePayment::pricer(const std::string& base_ccy) const {
-    return ppricer_t(new PricerPayment(*this, base_ccy));
+ppricer_t TradePayment::pricer(const std::string& base_ccy,
+    const std::shared_ptr<Arena>& arena) const {
+    return make_in_arena<PricerPayment>(arena, *this, base_ccy);
 }
 
 } // namespace minirisk
@@ -20,13 +20,19 @@ struct TradePayment : Trade<TradePayment>
         m_delivery_date = delivery_date;
     }
 
-    virtual ppricer_t pricer(const std::string& base_ccy) const;
+    virtual ppricer_t pricer(const std::string& base_ccy,
+        const std::shared_ptr<Arena>& arena) const;
 
-    const string& ccy() const
+    virtual const string& ccy() const
     {
         return m_ccy;
     }
 
+    virtual const Date& maturity() const
+    {
+        return m_delivery_date;
+    }
+
     const Date& delivery_date() const
     {
         return m_delivery_date;
@@ -43,10 +49,15 @@ private:
         is >> m_ccy >> m_delivery_date;
     }
 
+    size_t heap_size_details() const
+    {
+        return heap_size(m_ccy);
+    }
+
     void print_details(std::ostream& os) const
     {
-        os << format_label("Currency") << m_ccy << std::endl;
-        os << format_label("Delivery Date") << m_delivery_date << std::endl;
+        os << format_label("Currency") << m_ccy << '\n';
+        os << format_label("Delivery Date") << m_delivery_date << '\n';
     }
 
 private: